@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <sys/time.h>
+#include <uvchan/chan.h>
+
+#define TOTAL_CHANNELS 5000000
+#define LIVE_CHANNELS 16
+#define CHANNEL_CAPACITY 4
+
+// measures cost of creating and destroying short lived reply channels,
+// a few of them alive at a time, either through malloc or carved out
+// of a _uvchan_pool_t.
+
+static uvchan_t* _bench_new(int pooled, uvchan_pool_t* pool) {
+  if (pooled) {
+    return uvchan_new_pooled(pool, CHANNEL_CAPACITY, sizeof(void*));
+  }
+
+  return uvchan_new(CHANNEL_CAPACITY, sizeof(void*));
+}
+
+static double _bench_run(int pooled) {
+  uvchan_pool_t* pool;
+  uvchan_t* live[LIVE_CHANNELS];
+  struct timeval start;
+  struct timeval end;
+  int i;
+  int j;
+
+  pool = uvchan_pool_new();
+
+  gettimeofday(&start, NULL);
+
+  for (i = 0; i < TOTAL_CHANNELS; i += LIVE_CHANNELS) {
+    for (j = 0; j < LIVE_CHANNELS; j++) {
+      live[j] = _bench_new(pooled, pool);
+    }
+    for (j = 0; j < LIVE_CHANNELS; j++) {
+      uvchan_unref(live[j]);
+    }
+  }
+
+  gettimeofday(&end, NULL);
+
+  uvchan_pool_delete(pool);
+
+  return ((end.tv_sec - start.tv_sec) * 1000000000.0 +
+          (end.tv_usec - start.tv_usec) * 1000.0) /
+         TOTAL_CHANNELS;
+}
+
+int main(int argc, char* argv[]) {
+  printf("%15s %20s\n", "allocation", "new+unref (ns/op)");
+  printf("%15s %20.2f\n", "malloc", _bench_run(0));
+  printf("%15s %20.2f\n", "pooled", _bench_run(1));
+
+  return 0;
+}
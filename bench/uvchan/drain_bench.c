@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <sys/time.h>
+#include <uvchan/chan.h>
+
+#define BACKLOG 1000000
+
+// measures cost of collecting a channel's backlog on shutdown, either
+// with one pop per item or with a single drain.
+
+typedef struct _bench_data_t {
+  size_t received;
+} bench_data_t;
+
+static void _bench_pop_cb(uvchan_handle_t* handle, void* buffer,
+                          uvchan_error_t err) {
+  if (err == UVCHAN_ERR_SUCCESS) {
+    ((bench_data_t*)handle->data)->received++;
+    uvchan_start_pop(handle, buffer, _bench_pop_cb);
+  }
+}
+
+static void _bench_drain_cb(uvchan_handle_t* handle, void* buffer,
+                            size_t count, uvchan_error_t err) {
+  ((bench_data_t*)handle->data)->received += count;
+}
+
+static double _bench_run(int drain) {
+  uv_loop_t loop;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+  bench_data_t data;
+  struct timeval start;
+  struct timeval end;
+  size_t i;
+  size_t value;
+
+  uv_loop_init(&loop);
+  chan = uvchan_new_ex(0, sizeof(size_t), UVCHAN_FLAG_UNBOUNDED);
+  for (i = 0; i < BACKLOG; i++) {
+    _uvchan_try_push(chan, &i);
+  }
+  uvchan_close(chan);
+
+  data.received = 0;
+  uvchan_handle_init(&loop, &handle, chan);
+  handle.data = &data;
+
+  gettimeofday(&start, NULL);
+
+  if (drain) {
+    uvchan_start_drain(&handle, _bench_drain_cb);
+  } else {
+    uvchan_start_pop(&handle, &value, _bench_pop_cb);
+  }
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  gettimeofday(&end, NULL);
+
+  if (data.received != BACKLOG) {
+    fprintf(stderr, "received %lu items\n", (unsigned long)data.received);
+  }
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+  uvchan_unref(chan);
+
+  return ((end.tv_sec - start.tv_sec) * 1000000000.0 +
+          (end.tv_usec - start.tv_usec) * 1000.0) /
+         BACKLOG;
+}
+
+int main(int argc, char* argv[]) {
+  printf("%15s %20s\n", "collected by", "ns/item");
+  printf("%15s %20.2f\n", "pop", _bench_run(0));
+  printf("%15s %20.2f\n", "drain", _bench_run(1));
+
+  return 0;
+}
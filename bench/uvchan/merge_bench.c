@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <uvchan/merge.h>
+
+#define ITEMS 1000000
+
+// measures cost of forwarding items of a single busy input, while a
+// growing number of idle inputs are merged along with it.
+
+typedef struct _bench_data_t {
+  size_t received;
+} bench_data_t;
+
+static void _bench_done_cb(uvchan_merge_t* merge, uvchan_error_t err) {}
+
+static void _bench_read_cb(uvchan_handle_t* handle, void* buffer,
+                           uvchan_error_t err) {
+  if (err == UVCHAN_ERR_SUCCESS) {
+    ((bench_data_t*)handle->data)->received++;
+  }
+}
+
+static double _bench_run(size_t idle_inputs) {
+  uv_loop_t loop;
+  uvchan_t* busy;
+  uvchan_t** idle;
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  uvchan_handle_t handle;
+  bench_data_t data;
+  struct timeval start;
+  struct timeval end;
+  size_t i;
+  size_t value;
+
+  uv_loop_init(&loop);
+  busy = uvchan_new_ex(0, sizeof(size_t), UVCHAN_FLAG_UNBOUNDED);
+  for (i = 0; i < ITEMS; i++) {
+    _uvchan_try_push(busy, &i);
+  }
+  uvchan_close(busy);
+  output = uvchan_new(256, sizeof(size_t));
+
+  uvchan_merge_init(&loop, &merge, output);
+  uvchan_merge_start(&merge, _bench_done_cb);
+  idle = (uvchan_t**)malloc((idle_inputs + 1) * sizeof(uvchan_t*));
+  for (i = 0; i < idle_inputs; i++) {
+    idle[i] = uvchan_new(1, sizeof(size_t));
+    uvchan_merge_add(&merge, idle[i]);
+  }
+
+  data.received = 0;
+  uvchan_handle_init(&loop, &handle, output);
+  handle.data = &data;
+  uvchan_read_start(&handle, &value, _bench_read_cb);
+
+  gettimeofday(&start, NULL);
+
+  uvchan_merge_add(&merge, busy);
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  gettimeofday(&end, NULL);
+
+  if (data.received != ITEMS) {
+    fprintf(stderr, "received %lu items\n", (unsigned long)data.received);
+  }
+
+  for (i = 0; i < idle_inputs; i++) {
+    uvchan_close(idle[i]);
+  }
+  uvchan_merge_close(&merge);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_close((uv_handle_t*)&handle, NULL);
+  uv_run(&loop, UV_RUN_DEFAULT);
+  uv_loop_close(&loop);
+
+  for (i = 0; i < idle_inputs; i++) {
+    uvchan_unref(idle[i]);
+  }
+  free(idle);
+  uvchan_unref(busy);
+  uvchan_unref(output);
+
+  return ((end.tv_sec - start.tv_sec) * 1000000000.0 +
+          (end.tv_usec - start.tv_usec) * 1000.0) /
+         ITEMS;
+}
+
+int main(int argc, char* argv[]) {
+  printf("%15s %20s\n", "idle inputs", "ns/item");
+  printf("%15d %20.2f\n", 0, _bench_run(0));
+  printf("%15d %20.2f\n", 100, _bench_run(100));
+  printf("%15d %20.2f\n", 10000, _bench_run(10000));
+
+  return 0;
+}
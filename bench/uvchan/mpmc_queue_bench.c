@@ -0,0 +1,126 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <uvchan/mpmc_queue.h>
+#include <uvchan/queue.h>
+
+#define TOTAL_ITEMS 4000000
+#define QUEUE_CAPACITY 1024
+
+// compares _uvchan_mpmc_queue against _uvchan_queue guarded by a
+// single mutex, which is what callers had to do before, with a
+// single consumer draining items from a growing number of producers.
+
+typedef struct _bench_t {
+  uvchan_mpmc_queue mpmc;
+  uvchan_queue locked;
+  pthread_mutex_t lock;
+  int use_lock;
+  int items_per_producer;
+} bench_t;
+
+static uvchan_error_t _bench_push(bench_t* bench, const int* value) {
+  uvchan_error_t err;
+
+  if (!bench->use_lock) {
+    return uvchan_mpmc_queue_push(&bench->mpmc, value);
+  }
+
+  pthread_mutex_lock(&bench->lock);
+  err = uvchan_queue_push(&bench->locked, value);
+  pthread_mutex_unlock(&bench->lock);
+
+  return err;
+}
+
+static uvchan_error_t _bench_pop(bench_t* bench, int* value) {
+  uvchan_error_t err;
+
+  if (!bench->use_lock) {
+    return uvchan_mpmc_queue_pop(&bench->mpmc, value);
+  }
+
+  pthread_mutex_lock(&bench->lock);
+  err = uvchan_queue_pop(&bench->locked, value);
+  pthread_mutex_unlock(&bench->lock);
+
+  return err;
+}
+
+static void* _bench_producer(void* data) {
+  bench_t* bench;
+  int i;
+
+  bench = (bench_t*)data;
+  i = 0;
+
+  while (i < bench->items_per_producer) {
+    if (_bench_push(bench, &i) == UVCHAN_ERR_SUCCESS) {
+      i++;
+    } else {
+      sched_yield();
+    }
+  }
+
+  return 0L;
+}
+
+static double _bench_run(int producers, int use_lock) {
+  pthread_t threads[16];
+  bench_t bench;
+  struct timeval start;
+  struct timeval end;
+  int total;
+  int received;
+  int value;
+  int i;
+
+  uvchan_mpmc_queue_init(&bench.mpmc, QUEUE_CAPACITY, sizeof(int));
+  uvchan_queue_init(&bench.locked, QUEUE_CAPACITY, sizeof(int));
+  pthread_mutex_init(&bench.lock, NULL);
+  bench.use_lock = use_lock;
+  bench.items_per_producer = TOTAL_ITEMS / producers;
+  total = bench.items_per_producer * producers;
+
+  gettimeofday(&start, NULL);
+
+  for (i = 0; i < producers; i++) {
+    pthread_create(&threads[i], NULL, _bench_producer, &bench);
+  }
+
+  received = 0;
+  while (received < total) {
+    if (_bench_pop(&bench, &value) == UVCHAN_ERR_SUCCESS) {
+      received++;
+    } else {
+      sched_yield();
+    }
+  }
+
+  for (i = 0; i < producers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  gettimeofday(&end, NULL);
+
+  pthread_mutex_destroy(&bench.lock);
+  uvchan_queue_destroy(&bench.locked);
+  uvchan_mpmc_queue_destroy(&bench.mpmc);
+
+  return total / ((end.tv_sec - start.tv_sec) +
+                  (end.tv_usec - start.tv_usec) / 1000000.0);
+}
+
+int main(int argc, char* argv[]) {
+  int producers;
+
+  printf("%10s %20s %20s\n", "producers", "mutex (ops/s)", "mpmc (ops/s)");
+
+  for (producers = 1; producers <= 16; producers *= 2) {
+    printf("%10d %20.0f %20.0f\n", producers, _bench_run(producers, 1),
+           _bench_run(producers, 0));
+  }
+
+  return 0;
+}
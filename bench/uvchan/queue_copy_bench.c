@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <uvchan/queue.h>
+
+#define TOTAL_ITEMS 20000000
+#define QUEUE_CAPACITY 1024
+#define BATCH_SIZE 64
+
+// measures single threaded push/pop cost of _uvchan_queue for small
+// element sizes. this file is built twice, once against the library
+// and once with UVCHAN_GENERIC_COPY so that queue.c falls back to
+// calling memcpy with a variable size, which makes the gain of size
+// specialized copy paths visible.
+
+#ifdef UVCHAN_GENERIC_COPY
+#define COPY_PATH "generic"
+#else
+#define COPY_PATH "specialized"
+#endif
+
+static double _bench_run(size_t element_size) {
+  uvchan_queue queue;
+  struct timeval start;
+  struct timeval end;
+  unsigned char element[32];
+  unsigned long checksum;
+  int i;
+  int j;
+
+  memset(element, 0, sizeof(element));
+  uvchan_queue_init(&queue, QUEUE_CAPACITY, element_size);
+  checksum = 0;
+
+  gettimeofday(&start, NULL);
+
+  for (i = 0; i < TOTAL_ITEMS; i += BATCH_SIZE) {
+    for (j = 0; j < BATCH_SIZE; j++) {
+      element[0] = (unsigned char)j;
+      uvchan_queue_push(&queue, element);
+    }
+    for (j = 0; j < BATCH_SIZE; j++) {
+      uvchan_queue_pop(&queue, element);
+      checksum += element[0];
+    }
+  }
+
+  gettimeofday(&end, NULL);
+
+  uvchan_queue_destroy(&queue);
+
+  // keeps the loop from being optimized away
+  if (checksum == 0) {
+    printf("unexpected checksum\n");
+  }
+
+  return ((end.tv_sec - start.tv_sec) * 1000000000.0 +
+          (end.tv_usec - start.tv_usec) * 1000.0) /
+         TOTAL_ITEMS;
+}
+
+int main(int argc, char* argv[]) {
+  size_t element_size;
+
+  printf("%15s %15s %20s\n", "copy path", "element size",
+         "push+pop (ns/op)");
+
+  for (element_size = 1; element_size <= 32; element_size *= 2) {
+    printf("%15s %15lu %20.2f\n", COPY_PATH, (unsigned long)element_size,
+           _bench_run(element_size));
+  }
+
+  return 0;
+}
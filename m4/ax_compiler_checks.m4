@@ -20,4 +20,17 @@ AC_DEFUN([AX_COMPILER_CHECKS],
             AC_MSG_ERROR([sane __FILE__ macro is required])
         ])
 
+    AC_MSG_CHECKING([for __atomic builtins])
+    AC_LINK_IFELSE([AC_LANG_PROGRAM([[unsigned long x;]], [[
+        __atomic_store_n(&x, __atomic_load_n(&x, __ATOMIC_ACQUIRE) + 1, __ATOMIC_RELEASE);
+        return (int)__atomic_fetch_add(&x, 1, __ATOMIC_ACQ_REL);
+    ]])],
+        [
+            AC_MSG_RESULT([ok])
+        ],
+        [
+            AC_MSG_RESULT([no])
+            AC_MSG_ERROR([compiler support for __atomic builtins is required])
+        ])
+
 ])
\ No newline at end of file
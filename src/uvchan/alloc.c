@@ -0,0 +1,41 @@
+#include <uvchan/alloc.h>
+
+typedef struct _uvchan_allocator_t {
+  uvchan_malloc_func malloc_func;
+  uvchan_realloc_func realloc_func;
+  uvchan_calloc_func calloc_func;
+  uvchan_free_func free_func;
+} uvchan_allocator_t;
+
+static uvchan_allocator_t _uvchan_allocator = {malloc, realloc, calloc, free};
+
+uvchan_error_t uvchan_replace_allocator(uvchan_malloc_func malloc_func,
+                                        uvchan_realloc_func realloc_func,
+                                        uvchan_calloc_func calloc_func,
+                                        uvchan_free_func free_func) {
+  if (malloc_func == 0L || realloc_func == 0L || calloc_func == 0L ||
+      free_func == 0L) {
+    return UVCHAN_ERR_INVALID_ARGUMENT;
+  }
+
+  _uvchan_allocator.malloc_func = malloc_func;
+  _uvchan_allocator.realloc_func = realloc_func;
+  _uvchan_allocator.calloc_func = calloc_func;
+  _uvchan_allocator.free_func = free_func;
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void* _uvchan_malloc(size_t size) {
+  return _uvchan_allocator.malloc_func(size);
+}
+
+void* _uvchan_realloc(void* ptr, size_t size) {
+  return _uvchan_allocator.realloc_func(ptr, size);
+}
+
+void* _uvchan_calloc(size_t count, size_t size) {
+  return _uvchan_allocator.calloc_func(count, size);
+}
+
+void _uvchan_free(void* ptr) { _uvchan_allocator.free_func(ptr); }
@@ -0,0 +1,33 @@
+#ifndef UVCHAN_ALLOC_H__
+#define UVCHAN_ALLOC_H__
+
+#include <stdlib.h>
+#include <uvchan/error.h>
+
+typedef void* (*uvchan_malloc_func)(size_t size);
+typedef void* (*uvchan_realloc_func)(void* ptr, size_t size);
+typedef void* (*uvchan_calloc_func)(size_t count, size_t size);
+typedef void (*uvchan_free_func)(void* ptr);
+
+/**
+ * @brief route every allocation of library through given functions
+ *
+ * Same as libuv's uv_replace_allocator. Has to be called before any
+ * other function of library, since memory allocated by previous
+ * functions would be released through new ones. Functions have to be
+ * threadsafe if channels are used from several threads.
+ *
+ * @return #UVCHAN_ERR_INVALID_ARGUMENT if any of functions is NULL,
+ * in which case allocator is left unchanged.
+ */
+uvchan_error_t uvchan_replace_allocator(uvchan_malloc_func malloc_func,
+                                        uvchan_realloc_func realloc_func,
+                                        uvchan_calloc_func calloc_func,
+                                        uvchan_free_func free_func);
+
+void* _uvchan_malloc(size_t size);
+void* _uvchan_realloc(void* ptr, size_t size);
+void* _uvchan_calloc(size_t count, size_t size);
+void _uvchan_free(void* ptr);
+
+#endif  // UVCHAN_ALLOC_H__
@@ -0,0 +1,77 @@
+#include <uvchan/alloc.h>
+#include <uvchan/arena.h>
+
+#define ALIGN(size) \
+  (((size) + kUvChanArenaAlignment - 1) & ~((size_t)kUvChanArenaAlignment - 1))
+
+typedef struct _uvchan_arena_chunk {
+  struct _uvchan_arena_chunk* next;
+} uvchan_arena_chunk;
+
+#define CHUNK_DATA(chunk) (((char*)(chunk)) + ALIGN(sizeof(uvchan_arena_chunk)))
+
+uvchan_arena_t* uvchan_arena_new(size_t chunk_size) {
+  uvchan_arena_t* arena;
+
+  if (chunk_size < 1) {
+    chunk_size = kUvChanArenaChunkSize;
+  }
+
+  arena = (uvchan_arena_t*)_uvchan_malloc(sizeof(uvchan_arena_t));
+  arena->_chunks = 0L;
+  arena->_cursor = 0L;
+  arena->_left = 0;
+  arena->chunk_size = ALIGN(chunk_size);
+  arena->allocated = 0;
+
+  return arena;
+}
+
+void uvchan_arena_delete(uvchan_arena_t* arena) {
+  uvchan_arena_chunk* chunk;
+
+  while (arena->_chunks) {
+    chunk = (uvchan_arena_chunk*)arena->_chunks;
+    arena->_chunks = chunk->next;
+    _uvchan_free(chunk);
+  }
+
+  _uvchan_free(arena);
+}
+
+void* uvchan_arena_alloc(uvchan_arena_t* arena, size_t size) {
+  uvchan_arena_chunk* chunk;
+  size_t chunk_size;
+  void* block;
+
+  size = ALIGN(size);
+
+  if (size > arena->_left) {
+    chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+    chunk = (uvchan_arena_chunk*)_uvchan_malloc(
+        ALIGN(sizeof(uvchan_arena_chunk)) + chunk_size);
+    if (!chunk) {
+      return 0L;
+    }
+
+    chunk->next = (uvchan_arena_chunk*)arena->_chunks;
+    arena->_chunks = chunk;
+
+    // an oversized block takes its own chunk, keep bumping the current
+    // one for blocks to come
+    if (chunk_size > arena->chunk_size && arena->_left > 0) {
+      arena->allocated += size;
+      return CHUNK_DATA(chunk);
+    }
+
+    arena->_cursor = CHUNK_DATA(chunk);
+    arena->_left = chunk_size;
+  }
+
+  block = arena->_cursor;
+  arena->_cursor += size;
+  arena->_left -= size;
+  arena->allocated += size;
+
+  return block;
+}
@@ -0,0 +1,55 @@
+#ifndef UVCHAN_ARENA_H__
+#define UVCHAN_ARENA_H__
+
+#include <stdlib.h>
+
+/**
+ * @brief chunk size used when caller does not specify one
+ */
+#define kUvChanArenaChunkSize (64 * 1024)
+
+/**
+ * @brief alignment of every block handed out by a _uvchan_arena_t
+ */
+#define kUvChanArenaAlignment 16
+
+/**
+ * @brief Models a bump allocator released in one shot
+ *
+ * uvchan_arena_t hands out blocks by bumping a cursor through chunks
+ * of memory. Blocks are never freed one by one, instead all of them
+ * are released together by #uvchan_arena_delete. This suits a graph
+ * of short lived channels built for a single request: channels are
+ * created out of an arena with #uvchan_new_arena, and once the
+ * request is done the whole graph goes away with its arena.
+ *
+ * An arena is not threadsafe.
+ *
+ * @see uvchan_arena_new
+ * @see uvchan_arena_alloc
+ * @see uvchan_arena_delete
+ */
+typedef struct _uvchan_arena_t {
+  void* _chunks;     /**< @private */
+  char* _cursor;     /**< @private */
+  size_t _left;      /**< @private */
+  size_t chunk_size; /**< bytes allocated at once */
+  size_t allocated;  /**< bytes handed out so far */
+} uvchan_arena_t;
+
+/**
+ * @brief create an arena allocating @p chunk_size bytes at once
+ *
+ * Zero selects #kUvChanArenaChunkSize. Blocks larger than a chunk get
+ * a chunk of their own.
+ */
+uvchan_arena_t* uvchan_arena_new(size_t chunk_size);
+
+/**
+ * @brief release every block of @p arena along with it
+ */
+void uvchan_arena_delete(uvchan_arena_t* arena);
+
+void* uvchan_arena_alloc(uvchan_arena_t* arena, size_t size);
+
+#endif  // UVCHAN_ARENA_H__
@@ -0,0 +1,26 @@
+#ifndef UVCHAN_ATOMIC_H__
+#define UVCHAN_ATOMIC_H__
+
+// thin wrappers around compiler atomic builtins. these follow the C11
+// memory model while keeping the library buildable as gnu89.
+#define _UVCHAN_LOAD_RELAXED(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#define _UVCHAN_LOAD_ACQUIRE(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define _UVCHAN_STORE_RELAXED(ptr, value)            \
+  __atomic_store_n((ptr), (value), __ATOMIC_RELAXED)
+#define _UVCHAN_STORE_RELEASE(ptr, value)            \
+  __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+
+// on failure @p expected is updated with current value of @p ptr
+#define _UVCHAN_CAS_WEAK(ptr, expected, desired)                  \
+  __atomic_compare_exchange_n((ptr), (expected), (desired), 1,    \
+                              __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+#define _UVCHAN_ADD_FETCH(ptr, value)                   \
+  __atomic_add_fetch((ptr), (value), __ATOMIC_SEQ_CST)
+
+// full barrier, orders a store before a later load of another location
+#define _UVCHAN_FENCE_SEQ_CST() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define _UVCHAN_EXCHANGE(ptr, value)                   \
+  __atomic_exchange_n((ptr), (value), __ATOMIC_SEQ_CST)
+
+#endif  // UVCHAN_ATOMIC_H__
@@ -0,0 +1,365 @@
+#include <uvchan/alloc.h>
+#include <uvchan/broadcast.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include "./config.h"
+
+// ring starts on its own cache line, right after channel
+#define _UVCHAN_BROADCAST_RING_OFFSET                        \
+  ((sizeof(uvchan_broadcast_t) + kUvChanCacheLineSize - 1) & \
+   ~((size_t)kUvChanCacheLineSize - 1))
+
+#ifdef LIBUV_0X
+static void _uvchan_broadcast_read_idle_cb(uv_idle_t* handle, int status);
+#elif LIBUV_1X
+static void _uvchan_broadcast_read_idle_cb(uv_idle_t* handle);
+#else
+#error callback not defined for unknown version of libuv
+#endif
+
+uvchan_broadcast_t* uvchan_broadcast_new(size_t num_elements,
+                                         size_t element_size) {
+  uvchan_broadcast_t* bc;
+
+  assert(num_elements > 0 && "broadcast needs a ring");
+
+  bc = (uvchan_broadcast_t*)_uvchan_malloc(_UVCHAN_BROADCAST_RING_OFFSET +
+                                           num_elements * element_size);
+  bc->ring = (char*)bc + _UVCHAN_BROADCAST_RING_OFFSET;
+  bc->num_elements = num_elements;
+  bc->element_size = element_size;
+  bc->head = 0;
+  bc->tail = 0;
+  bc->overflow = UVCHAN_BROADCAST_WAIT;
+  bc->closed = 0;
+  bc->reference_count = 1;
+  bc->_subscribers = 0L;
+  _uvchan_waiter_init(&bc->push_waiters, 0L, 0L);
+  _uvchan_waiter_init(&bc->read_waiters, 0L, 0L);
+
+  return bc;
+}
+
+void uvchan_broadcast_ref(uvchan_broadcast_t* bc) { bc->reference_count++; }
+
+void uvchan_broadcast_unref(uvchan_broadcast_t* bc) {
+  if (--bc->reference_count < 1) {
+    assert(bc->_subscribers == 0L && "broadcast still has subscribers");
+    _uvchan_free(bc);
+  }
+}
+
+void uvchan_broadcast_close(uvchan_broadcast_t* bc) {
+  bc->closed = 1;
+
+  _uvchan_waiter_wake_all(&bc->push_waiters);
+  _uvchan_waiter_wake_all(&bc->read_waiters);
+}
+
+static char* _uvchan_broadcast_slot(uvchan_broadcast_t* bc, size_t sequence) {
+  return bc->ring + (sequence % bc->num_elements) * bc->element_size;
+}
+
+// cursors only move forward, so tail is only rescanned once ring looks
+// full as of last scan
+static int _uvchan_broadcast_has_room(uvchan_broadcast_t* bc) {
+  uvchan_broadcast_handle_t* subscriber;
+
+  if (bc->head - bc->tail < bc->num_elements) {
+    return 1;
+  }
+
+  bc->tail = bc->head;
+  for (subscriber = bc->_subscribers; subscriber != 0L;
+       subscriber = subscriber->_next) {
+    if (bc->head - subscriber->cursor > bc->head - bc->tail) {
+      bc->tail = subscriber->cursor;
+    }
+  }
+
+  return bc->head - bc->tail < bc->num_elements;
+}
+
+// a subscriber moved on or went away, which may be what a parked
+// publisher waits for
+static void _uvchan_broadcast_released(uvchan_broadcast_t* bc) {
+  if (bc->push_waiters.next != &bc->push_waiters &&
+      _uvchan_broadcast_has_room(bc)) {
+    _uvchan_waiter_wake_one(&bc->push_waiters);
+  }
+}
+
+static void _uvchan_broadcast_unlink(uvchan_broadcast_handle_t* handle) {
+  if (handle->_prev != 0L) {
+    handle->_prev->_next = handle->_next;
+  } else {
+    handle->bc->_subscribers = handle->_next;
+  }
+  if (handle->_next != 0L) {
+    handle->_next->_prev = handle->_prev;
+  }
+
+  handle->_next = 0L;
+  handle->_prev = 0L;
+  handle->subscribed = 0;
+}
+
+static void _uvchan_broadcast_detach(uvchan_broadcast_handle_t* handle) {
+  _uvchan_broadcast_unlink(handle);
+  handle->lagged = 1;
+
+  // a lagging subscriber has items left, so it is not parked
+  if (handle->reading) {
+    uv_idle_start((uv_idle_t*)handle, _uvchan_broadcast_read_idle_cb);
+  }
+
+  uvchan_broadcast_unref(handle->bc);
+}
+
+// frees slot of oldest item by moving subscribers still on it
+static void _uvchan_broadcast_overflow(uvchan_broadcast_t* bc) {
+  uvchan_broadcast_handle_t* subscriber;
+  uvchan_broadcast_handle_t* next;
+  size_t oldest;
+
+  oldest = bc->head - bc->num_elements;
+  for (subscriber = bc->_subscribers; subscriber != 0L; subscriber = next) {
+    next = subscriber->_next;
+    if (subscriber->cursor != oldest) {
+      continue;
+    }
+
+    if (bc->overflow == UVCHAN_BROADCAST_DROP) {
+      subscriber->cursor++;
+      subscriber->dropped++;
+    } else {
+      _uvchan_broadcast_detach(subscriber);
+    }
+  }
+
+  bc->tail = oldest + 1;
+}
+
+static uvchan_error_t _uvchan_broadcast_publish(uvchan_broadcast_t* bc,
+                                                const void* element) {
+  if (!_uvchan_broadcast_has_room(bc)) {
+    if (bc->overflow == UVCHAN_BROADCAST_WAIT) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+    _uvchan_broadcast_overflow(bc);
+  }
+
+  memcpy(_uvchan_broadcast_slot(bc, bc->head), element, bc->element_size);
+  bc->head++;
+
+  _uvchan_waiter_wake_all(&bc->read_waiters);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_broadcast_handle_init(uv_loop_t* loop,
+                                  uvchan_broadcast_handle_t* handle,
+                                  uvchan_broadcast_t* bc) {
+  uv_idle_init(loop, (uv_idle_t*)handle);
+  handle->bc = bc;
+  handle->element = 0L;
+  handle->callback = 0L;
+  handle->data = 0L;
+  handle->cursor = 0;
+  handle->dropped = 0;
+  handle->subscribed = 0;
+  handle->reading = 0;
+  handle->lagged = 0;
+  handle->_next = 0L;
+  handle->_prev = 0L;
+  _uvchan_waiter_init(&handle->waiter, (uv_idle_t*)handle, 0L);
+}
+
+void uvchan_broadcast_subscribe(uvchan_broadcast_handle_t* handle) {
+  uvchan_broadcast_t* bc;
+
+  assert(!handle->subscribed && "handle is already subscribed");
+
+  bc = handle->bc;
+  handle->cursor = bc->head;
+  handle->dropped = 0;
+  handle->lagged = 0;
+  handle->subscribed = 1;
+  handle->_prev = 0L;
+  handle->_next = bc->_subscribers;
+  if (bc->_subscribers != 0L) {
+    bc->_subscribers->_prev = handle;
+  }
+  bc->_subscribers = handle;
+
+  uvchan_broadcast_ref(bc);
+}
+
+void uvchan_broadcast_unsubscribe(uvchan_broadcast_handle_t* handle) {
+  uvchan_broadcast_t* bc;
+
+  if (!handle->subscribed) {
+    return;
+  }
+
+  bc = handle->bc;
+  uvchan_broadcast_read_stop(handle);
+  _uvchan_broadcast_unlink(handle);
+  _uvchan_broadcast_released(bc);
+
+  uvchan_broadcast_unref(bc);
+}
+
+static void _uvchan_broadcast_push_done(uvchan_broadcast_handle_t* handle,
+                                        uvchan_error_t err) {
+  uvchan_broadcast_t* bc;
+
+  bc = handle->bc;
+  if (handle->callback != 0L) {
+    ((uvchan_broadcast_push_cb)(handle->callback))(handle, err);
+  }
+
+  uvchan_broadcast_unref(bc);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_broadcast_push_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_broadcast_push_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_broadcast_handle_t* bc_handle;
+  uvchan_broadcast_t* bc;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  bc_handle = (uvchan_broadcast_handle_t*)handle;
+  bc = bc_handle->bc;
+  woken = _uvchan_waiter_claim(&bc_handle->waiter);
+  uv_idle_stop(handle);
+
+  if (bc->closed) {
+    _uvchan_broadcast_push_done(bc_handle, UVCHAN_ERR_CHANNEL_CLOSED);
+  } else if ((woken || _uvchan_waiter_idle(&bc->push_waiters)) &&
+             _uvchan_broadcast_publish(bc, bc_handle->element) ==
+                 UVCHAN_ERR_SUCCESS) {
+    // room left is for the next publisher in line
+    if (woken) {
+      _uvchan_broadcast_released(bc);
+    }
+    _uvchan_broadcast_push_done(bc_handle, UVCHAN_ERR_SUCCESS);
+  } else {
+    _uvchan_waiter_park(&bc->push_waiters, &bc_handle->waiter, woken);
+  }
+}
+
+void uvchan_broadcast_start_push(uvchan_broadcast_handle_t* handle,
+                                 const void* buffer,
+                                 uvchan_broadcast_push_cb cb) {
+  handle->element = buffer;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_broadcast_push_idle_cb;
+  uvchan_broadcast_ref(handle->bc);
+
+  uv_idle_start((uv_idle_t*)handle, _uvchan_broadcast_push_idle_cb);
+}
+
+static void _uvchan_broadcast_read_done(uvchan_broadcast_handle_t* handle,
+                                        uvchan_error_t err) {
+  uvchan_broadcast_t* bc;
+
+  bc = handle->bc;
+  handle->reading = 0;
+  ((uvchan_broadcast_read_cb)(handle->callback))(handle, 0L, err);
+
+  uvchan_broadcast_unref(bc);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_broadcast_read_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_broadcast_read_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_broadcast_handle_t* bc_handle;
+  uvchan_broadcast_t* bc;
+  const void* item;
+  int moved;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  bc_handle = (uvchan_broadcast_handle_t*)handle;
+  bc = bc_handle->bc;
+  _uvchan_waiter_claim(&bc_handle->waiter);
+  uv_idle_stop(handle);
+
+  if (bc_handle->lagged) {
+    _uvchan_broadcast_read_done(bc_handle, UVCHAN_ERR_LAGGED);
+    return;
+  }
+
+  // publishers only run from their own idle callbacks, so slots read
+  // here are not reused before callback returns. channel is held in
+  // case callback unsubscribes.
+  uvchan_broadcast_ref(bc);
+  moved = 0;
+  while (bc_handle->reading && bc_handle->cursor != bc->head) {
+    item = _uvchan_broadcast_slot(bc, bc_handle->cursor);
+    bc_handle->cursor++;
+    moved = 1;
+
+    ((uvchan_broadcast_read_cb)(bc_handle->callback))(bc_handle, item,
+                                                      UVCHAN_ERR_SUCCESS);
+  }
+
+  if (moved) {
+    _uvchan_broadcast_released(bc);
+  }
+  uvchan_broadcast_unref(bc);
+
+  if (!bc_handle->reading) {
+    // stopped from within callback
+    return;
+  }
+
+  if (bc->closed) {
+    _uvchan_broadcast_read_done(bc_handle, UVCHAN_ERR_CHANNEL_CLOSED);
+    return;
+  }
+
+  _uvchan_waiter_park(&bc->read_waiters, &bc_handle->waiter, 0);
+}
+
+void uvchan_broadcast_read_start(uvchan_broadcast_handle_t* handle,
+                                 uvchan_broadcast_read_cb cb) {
+  assert(!handle->reading && "handle is already reading");
+  assert((handle->subscribed || handle->lagged) && "handle is not subscribed");
+
+  handle->callback = (void*)cb;
+  handle->reading = 1;
+  handle->waiter.idle_cb = _uvchan_broadcast_read_idle_cb;
+  uvchan_broadcast_ref(handle->bc);
+
+  uv_idle_start((uv_idle_t*)handle, _uvchan_broadcast_read_idle_cb);
+}
+
+void uvchan_broadcast_read_stop(uvchan_broadcast_handle_t* handle) {
+  if (!handle->reading) {
+    return;
+  }
+
+  handle->reading = 0;
+  uv_idle_stop((uv_idle_t*)handle);
+  _uvchan_waiter_unpark(&handle->waiter);
+
+  uvchan_broadcast_unref(handle->bc);
+}
@@ -0,0 +1,170 @@
+#ifndef UVCHAN_BROADCAST_H__
+#define UVCHAN_BROADCAST_H__
+
+#include <uv.h>
+#include <uvchan/chan.h>
+#include <uvchan/error.h>
+
+/**
+ * @brief publishers wait for the slowest subscriber
+ */
+#define UVCHAN_BROADCAST_WAIT 0
+
+/**
+ * @brief publishers overwrite oldest item, skipping it for subscribers
+ * still behind
+ *
+ * Skipped items are counted in #_uvchan_broadcast_handle_t#dropped.
+ */
+#define UVCHAN_BROADCAST_DROP 1
+
+/**
+ * @brief publishers detach subscribers which fell a whole ring behind
+ *
+ * Reading a detached subscriber completes with #UVCHAN_ERR_LAGGED.
+ */
+#define UVCHAN_BROADCAST_DETACH 2
+
+struct _uvchan_broadcast_handle_t;
+
+/**
+ * @brief Models a channel whose every item reaches every subscriber
+ *
+ * uvchan_broadcast_t keeps a single ring of items, and each subscriber
+ * a cursor into it: the sequence number of the next item it reads.
+ * Publishing copies an item into the ring once, however many
+ * subscribers there are, and subscribers read it in place, so fan-out
+ * costs a single copy and a single ring of memory.
+ *
+ * Slot of an item is reused once every subscriber moved past it, so
+ * the slowest subscriber sets the pace of publishers. What happens
+ * when it falls a whole ring behind is selected by
+ * _uvchan_broadcast_t#overflow, see #UVCHAN_BROADCAST_WAIT,
+ * #UVCHAN_BROADCAST_DROP and #UVCHAN_BROADCAST_DETACH. Items published
+ * while there are no subscribers are discarded.
+ *
+ * A broadcast channel is not threadsafe, all of its handles have to
+ * run on the same loop.
+ *
+ * @see uvchan_broadcast_new
+ * @see uvchan_broadcast_subscribe
+ * @see uvchan_broadcast_start_push
+ * @see uvchan_broadcast_read_start
+ */
+typedef struct _uvchan_broadcast_t {
+  char* ring;          /**< @private */
+  size_t num_elements; /**< number of items ring holds */
+  size_t element_size;
+  size_t head;  /**< sequence number of the next published item */
+  size_t tail;  /**< @private cursor of slowest subscriber, as last seen */
+  int overflow; /**< policy once slowest subscriber is a ring behind */
+  int closed;
+  int reference_count;
+
+  struct _uvchan_broadcast_handle_t* _subscribers; /**< @private */
+  uvchan_waiter_t push_waiters;                    /**< @private */
+  uvchan_waiter_t read_waiters;                    /**< @private */
+} uvchan_broadcast_t;
+
+typedef struct _uvchan_broadcast_handle_t {
+  uv_idle_t idle_handle;
+
+  uvchan_broadcast_t* bc;
+  const void* element;
+  void* callback;
+  void* data;
+
+  size_t cursor;  /**< sequence number of the next item read */
+  size_t dropped; /**< items skipped by #UVCHAN_BROADCAST_DROP */
+
+  uvchan_waiter_t waiter;                   /**< @private */
+  int subscribed;                           /**< @private */
+  int reading;                              /**< @private */
+  int lagged;                               /**< @private */
+  struct _uvchan_broadcast_handle_t* _next; /**< @private */
+  struct _uvchan_broadcast_handle_t* _prev; /**< @private */
+} uvchan_broadcast_handle_t;
+
+typedef void (*uvchan_broadcast_push_cb)(uvchan_broadcast_handle_t* handle,
+                                         uvchan_error_t err);
+
+/**
+ * @brief receives an item of a broadcast channel
+ *
+ * @p item points into ring of channel and is only valid until callback
+ * returns.
+ */
+typedef void (*uvchan_broadcast_read_cb)(uvchan_broadcast_handle_t* handle,
+                                         const void* item,
+                                         uvchan_error_t err);
+
+/**
+ * @brief create a broadcast channel of @p num_elements items
+ *
+ * Unlike #uvchan_new, @p num_elements has to be positive: published
+ * items always go through the ring.
+ */
+uvchan_broadcast_t* uvchan_broadcast_new(size_t num_elements,
+                                         size_t element_size);
+void uvchan_broadcast_ref(uvchan_broadcast_t* bc);
+void uvchan_broadcast_unref(uvchan_broadcast_t* bc);
+
+/**
+ * @brief close broadcast channel
+ *
+ * Pending pushes complete with #UVCHAN_ERR_CHANNEL_CLOSED, subscribers
+ * still read items published before.
+ */
+void uvchan_broadcast_close(uvchan_broadcast_t* bc);
+
+void uvchan_broadcast_handle_init(uv_loop_t* loop,
+                                  uvchan_broadcast_handle_t* handle,
+                                  uvchan_broadcast_t* bc);
+
+/**
+ * @brief register @p handle as a subscriber
+ *
+ * Subscriber reads every item published from now on, and holds a
+ * reference to channel until #uvchan_broadcast_unsubscribe. Items are
+ * held in ring for subscriber even while it is not reading.
+ */
+void uvchan_broadcast_subscribe(uvchan_broadcast_handle_t* handle);
+
+/**
+ * @brief undo #uvchan_broadcast_subscribe
+ *
+ * Stops reading and lets publishers reuse items subscriber did not
+ * read yet. Does nothing if handle is not subscribed.
+ */
+void uvchan_broadcast_unsubscribe(uvchan_broadcast_handle_t* handle);
+
+/**
+ * @brief publish an item to every subscriber
+ *
+ * Item is copied once into ring of channel, and @p cb is called once
+ * it is published.
+ */
+void uvchan_broadcast_start_push(uvchan_broadcast_handle_t* handle,
+                                 const void* buffer,
+                                 uvchan_broadcast_push_cb cb);
+
+/**
+ * @brief read every item of a subscribed handle until channel closes
+ *
+ * @p cb is called once for every item, and a last time with
+ * #UVCHAN_ERR_CHANNEL_CLOSED once channel is closed and subscriber has
+ * read all of it, or with #UVCHAN_ERR_LAGGED once subscriber was
+ * detached, after which reading stops by itself.
+ */
+void uvchan_broadcast_read_start(uvchan_broadcast_handle_t* handle,
+                                 uvchan_broadcast_read_cb cb);
+
+/**
+ * @brief stop reading started by #uvchan_broadcast_read_start
+ *
+ * May be called from within the read callback. Subscriber stays
+ * subscribed, keeping its unread items in ring.
+ */
+void uvchan_broadcast_read_stop(uvchan_broadcast_handle_t* handle);
+
+#endif  // UVCHAN_BROADCAST_H__
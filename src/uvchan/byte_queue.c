@@ -0,0 +1,145 @@
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
+#include <uvchan/byte_queue.h>
+
+#include <assert.h>
+#include <string.h>
+
+// length prefix marking rest of the ring up to it's end as unused
+#define kUvChanByteQueueSkip ((size_t)-1)
+
+#define kUvChanByteQueueMinCapacity (4 * kUvChanCacheLineSize)
+
+#define RECORD_SIZE(length)                                  \
+  ((sizeof(size_t) + (length) + kUvChanByteQueueAlignment - 1) & \
+   ~(kUvChanByteQueueAlignment - 1))
+
+#define MEM_LOCATION(queue, position) \
+  ((queue)->_buffer + ((position) & (queue)->_mask))
+
+void uvchan_byte_queue_init(uvchan_byte_queue* queue, size_t capacity_bytes) {
+  size_t capacity;
+
+  capacity = kUvChanByteQueueMinCapacity;
+  while (capacity < capacity_bytes) {
+    capacity <<= 1;
+  }
+
+  queue->_buffer = (char*)_uvchan_malloc(capacity);
+  queue->capacity_bytes = capacity;
+  queue->max_message_size = capacity / 2 - sizeof(size_t);
+  queue->_mask = capacity - 1;
+  queue->_head = 0;
+  queue->_cached_tail = 0;
+  queue->_tail = 0;
+  queue->_cached_head = 0;
+}
+
+void uvchan_byte_queue_destroy(uvchan_byte_queue* queue) {
+  assert(_UVCHAN_LOAD_ACQUIRE(&queue->_head) ==
+         _UVCHAN_LOAD_ACQUIRE(&queue->_tail));
+
+  _uvchan_free(queue->_buffer);
+  queue->_buffer = 0L;
+}
+
+uvchan_error_t uvchan_byte_queue_push(uvchan_byte_queue* queue,
+                                      const void* buffer, size_t length) {
+  size_t head;
+  size_t record;
+  size_t skip;
+  char* location;
+
+  if (length > queue->max_message_size) {
+    return UVCHAN_ERR_MESSAGE_TOO_LARGE;
+  }
+
+  head = _UVCHAN_LOAD_RELAXED(&queue->_head);
+  record = RECORD_SIZE(length);
+
+  // records are aligned, so whenever skipping is needed there is
+  // at least room for a length prefix before end of the ring
+  skip = queue->capacity_bytes - (head & queue->_mask);
+  if (skip >= record) {
+    skip = 0;
+  }
+
+  if (head + skip + record - queue->_cached_tail > queue->capacity_bytes) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_tail);
+    if (head + skip + record - queue->_cached_tail > queue->capacity_bytes) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+  }
+
+  if (skip) {
+    *((size_t*)MEM_LOCATION(queue, head)) = kUvChanByteQueueSkip;
+    head += skip;
+  }
+
+  location = MEM_LOCATION(queue, head);
+  *((size_t*)location) = length;
+  memcpy(location + sizeof(size_t), buffer, length);
+
+  _UVCHAN_STORE_RELEASE(&queue->_head, head + record);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_byte_queue_peek(uvchan_byte_queue* queue,
+                                      const void** data, size_t* length) {
+  size_t tail;
+  char* location;
+
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
+
+  if (tail == queue->_cached_head) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_head);
+    if (tail == queue->_cached_head) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    }
+  }
+
+  location = MEM_LOCATION(queue, tail);
+  if (*((size_t*)location) == kUvChanByteQueueSkip) {
+    // producer publishes skipped space together with the message
+    // following it, so there is a message at start of the ring.
+    tail += queue->capacity_bytes - (tail & queue->_mask);
+    _UVCHAN_STORE_RELEASE(&queue->_tail, tail);
+    location = MEM_LOCATION(queue, tail);
+  }
+
+  *length = *((size_t*)location);
+  *data = location + sizeof(size_t);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_byte_queue_release(uvchan_byte_queue* queue) {
+  size_t tail;
+
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
+
+  _UVCHAN_STORE_RELEASE(
+      &queue->_tail,
+      tail + RECORD_SIZE(*((size_t*)MEM_LOCATION(queue, tail))));
+}
+
+uvchan_error_t uvchan_byte_queue_pop(uvchan_byte_queue* queue, void* buffer,
+                                     size_t capacity, size_t* length) {
+  uvchan_error_t err;
+  const void* data;
+
+  err = uvchan_byte_queue_peek(queue, &data, length);
+  if (err != UVCHAN_ERR_SUCCESS) {
+    return err;
+  }
+
+  if (*length > capacity) {
+    return UVCHAN_ERR_MESSAGE_TOO_LARGE;
+  }
+
+  memcpy(buffer, data, *length);
+  uvchan_byte_queue_release(queue);
+
+  return UVCHAN_ERR_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#ifndef UVCHAN_BYTE_QUEUE_H__
+#define UVCHAN_BYTE_QUEUE_H__
+
+#include <stdlib.h>
+#include <uvchan/error.h>
+#include <uvchan/queue.h>
+
+/**
+ * @brief alignment of records within _uvchan_byte_queue
+ *
+ * Every record starts at a multiple of this many bytes, so that it's
+ * length prefix, and payloads of typical structs, are aligned.
+ */
+#define kUvChanByteQueueAlignment sizeof(size_t)
+
+/**
+ * @brief Models a FIFO queue of variable length messages
+ *
+ * uvchan_byte_queue stores messages of any size back to back in one
+ * contiguous ring of bytes, each one prefixed by it's length and
+ * padded to #kUvChanByteQueueAlignment. So mixed size messages are
+ * packed densely instead of being padded to the largest one or
+ * allocated one by one.
+ *
+ * A message never wraps around end of the ring. When it does not fit
+ * in what is left up to the end, that space is skipped and the message
+ * is written at start of the ring, so that #uvchan_byte_queue_peek can
+ * always expose it as one contiguous block. To guarantee that any
+ * accepted message eventually fits, messages are limited to
+ * #_uvchan_byte_queue#max_message_size, about half of the ring.
+ *
+ * Same as _uvchan_queue, it is safe for a single producer and a single
+ * consumer thread.
+ *
+ * @code{.c}
+ * uvchan_byte_queue q;
+ * const void* data;
+ * size_t length;
+ *
+ * uvchan_byte_queue_init(&q, 4096);
+ *
+ * uvchan_byte_queue_push(&q, "hello", 5);
+ *
+ * uvchan_byte_queue_peek(&q, &data, &length);
+ * uvchan_byte_queue_release(&q);
+ *
+ * uvchan_byte_queue_destroy(&q);
+ * @endcode
+ *
+ * @see uvchan_byte_queue_init
+ * @see uvchan_byte_queue_push
+ * @see uvchan_byte_queue_pop
+ * @see uvchan_byte_queue_peek
+ * @see uvchan_byte_queue_destroy
+ */
+typedef struct _uvchan_byte_queue {
+  char* _buffer;           /**< @private */
+  size_t capacity_bytes;   /**< size of ring in bytes */
+  size_t max_message_size; /**< largest accepted message in bytes */
+  size_t _mask;            /**< @private */
+  char _pad0[kUvChanCacheLineSize - sizeof(char*) -
+             3 * sizeof(size_t)]; /**< @private */
+
+  size_t _head;        /**< @private written by producer */
+  size_t _cached_tail; /**< @private */
+  char _pad1[kUvChanCacheLineSize - 2 * sizeof(size_t)]; /**< @private */
+
+  size_t _tail;        /**< @private written by consumer */
+  size_t _cached_head; /**< @private */
+  char _pad2[kUvChanCacheLineSize - 2 * sizeof(size_t)]; /**< @private */
+} uvchan_byte_queue;
+
+/**
+ * @brief initialize a new queue of messages
+ *
+ * @param queue location of _uvchan_byte_queue instance to initialize.
+ * @param capacity_bytes shows desired size of ring in bytes, which is
+ * rounded up to a power of two. It includes length prefixes and
+ * padding of messages.
+ *
+ * @see uvchan_byte_queue_destroy
+ */
+void uvchan_byte_queue_init(uvchan_byte_queue* queue, size_t capacity_bytes);
+
+/**
+ * @brief destroy resources allocated to queue
+ *
+ * @warning same as #uvchan_queue_destroy, queue is asserted to be empty.
+ */
+void uvchan_byte_queue_destroy(uvchan_byte_queue* queue);
+
+/**
+ * @brief copy a message of @p length bytes to back of queue
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_FULL if
+ * there is not enough room right now, #UVCHAN_ERR_MESSAGE_TOO_LARGE
+ * if @p length exceeds #_uvchan_byte_queue#max_message_size.
+ */
+uvchan_error_t uvchan_byte_queue_push(uvchan_byte_queue* queue,
+                                      const void* buffer, size_t length);
+
+/**
+ * @brief copy message at front of queue out and remove it
+ *
+ * @param buffer receives message, at most @p capacity bytes.
+ * @param length receives length of message.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_EMPTY if queue
+ * is empty. #UVCHAN_ERR_MESSAGE_TOO_LARGE if message is longer than
+ * @p capacity, in which case @p length receives it's length and the
+ * message is left in queue.
+ */
+uvchan_error_t uvchan_byte_queue_pop(uvchan_byte_queue* queue, void* buffer,
+                                     size_t capacity, size_t* length);
+
+/**
+ * @brief expose message at front of queue for in-place reading
+ *
+ * @p data points into the ring and stays valid until
+ * #uvchan_byte_queue_release is called.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_EMPTY if
+ * queue is empty.
+ */
+uvchan_error_t uvchan_byte_queue_peek(uvchan_byte_queue* queue,
+                                      const void** data, size_t* length);
+
+/**
+ * @brief remove message previously exposed by #uvchan_byte_queue_peek
+ */
+void uvchan_byte_queue_release(uvchan_byte_queue* queue);
+
+#endif  // UVCHAN_BYTE_QUEUE_H__
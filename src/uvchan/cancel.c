@@ -0,0 +1,66 @@
+#include <uvchan/cancel.h>
+
+void uvchan_cancel_init(uvchan_cancel_t* cancel) {
+  cancel->links.next = &cancel->links;
+  cancel->links.prev = &cancel->links;
+  cancel->count = 0;
+  cancel->cancelled = 0;
+}
+
+static void _uvchan_cancel_unlink(uvchan_cancel_link_t* link) {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->next = 0L;
+  link->prev = 0L;
+  link->cancel->count--;
+}
+
+void uvchan_cancel(uvchan_cancel_t* cancel) {
+  uvchan_cancel_link_t* link;
+
+  cancel->cancelled = 1;
+
+  // links attaching from callbacks are not linked anymore, see
+  // uvchan_cancel_attach, so this ends
+  while (cancel->links.next != &cancel->links) {
+    link = cancel->links.next;
+    _uvchan_cancel_unlink(link);
+    link->cancelled = 1;
+    link->cancel_cb(link);
+  }
+}
+
+void uvchan_cancel_link_init(uvchan_cancel_link_t* link,
+                             uvchan_cancel_cb cancel_cb) {
+  link->next = 0L;
+  link->prev = 0L;
+  link->cancel = 0L;
+  link->cancelled = 0;
+  link->cancel_cb = cancel_cb;
+}
+
+void uvchan_cancel_attach(uvchan_cancel_link_t* link) {
+  uvchan_cancel_t* cancel;
+
+  cancel = link->cancel;
+  if (cancel == 0L || link->next != 0L) {
+    return;
+  } else if (cancel->cancelled) {
+    link->cancelled = 1;
+    return;
+  }
+
+  link->next = &cancel->links;
+  link->prev = cancel->links.prev;
+  cancel->links.prev->next = link;
+  cancel->links.prev = link;
+  cancel->count++;
+}
+
+void uvchan_cancel_detach(uvchan_cancel_link_t* link) {
+  if (link->next == 0L) {
+    return;
+  }
+
+  _uvchan_cancel_unlink(link);
+}
@@ -0,0 +1,79 @@
+#ifndef UVCHAN_CANCEL_H__
+#define UVCHAN_CANCEL_H__
+
+#include <stdlib.h>
+
+struct _uvchan_cancel_t;
+struct _uvchan_cancel_link_t;
+
+typedef void (*uvchan_cancel_cb)(struct _uvchan_cancel_link_t* link);
+
+/**
+ * @brief a pending operation attached to a _uvchan_cancel_t
+ */
+typedef struct _uvchan_cancel_link_t {
+  struct _uvchan_cancel_link_t* next; /**< @private */
+  struct _uvchan_cancel_link_t* prev; /**< @private */
+  struct _uvchan_cancel_t* cancel;    /**< token link attaches to */
+  int cancelled;                      /**< set once token was cancelled */
+  uvchan_cancel_cb cancel_cb;         /**< @private */
+} uvchan_cancel_link_t;
+
+/**
+ * @brief Models a cancellation token
+ *
+ * uvchan_cancel_t groups pending operations working for the same
+ * purpose, like every operation started for a single client, so that
+ * they are aborted together by one #uvchan_cancel call instead of
+ * being tracked down one by one.
+ *
+ * Operations attach a uvchan_cancel_link_t while they wait, and detach
+ * it once they run, so cancelling costs O(number of waiting
+ * operations) and completed operations cost nothing. Token has to
+ * outlive operations attached to it, and is not threadsafe.
+ *
+ * @see uvchan_cancel_init
+ * @see uvchan_cancel
+ * @see uvchan_handle_set_cancel
+ * @see uvchan_select_handle_add_cancel
+ */
+typedef struct _uvchan_cancel_t {
+  uvchan_cancel_link_t links; /**< @private */
+  size_t count;               /**< number of attached links */
+  int cancelled;              /**< set by #uvchan_cancel */
+} uvchan_cancel_t;
+
+/**
+ * @brief initialize a token, or reuse one nothing is attached to
+ */
+void uvchan_cancel_init(uvchan_cancel_t* cancel);
+
+/**
+ * @brief cancel every operation attached to @p cancel
+ *
+ * Attached operations are detached and complete with
+ * #UVCHAN_ERR_CANCELLED on next loop iteration, unless they find
+ * channel ready first. Operations attached later are cancelled right
+ * away.
+ */
+void uvchan_cancel(uvchan_cancel_t* cancel);
+
+void uvchan_cancel_link_init(uvchan_cancel_link_t* link,
+                             uvchan_cancel_cb cancel_cb);
+
+/**
+ * @brief attach @p link to its token
+ *
+ * Marks link cancelled instead if token already was. Does nothing if
+ * link has no token or is attached already.
+ */
+void uvchan_cancel_attach(uvchan_cancel_link_t* link);
+
+/**
+ * @brief detach @p link from its token
+ *
+ * Does nothing if link is not attached.
+ */
+void uvchan_cancel_detach(uvchan_cancel_link_t* link);
+
+#endif  // UVCHAN_CANCEL_H__
@@ -1,140 +1,1792 @@
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
 #include <uvchan/chan.h>
 #include <uvchan/error.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
 #include "./config.h"
 
-static void _uvchan_default_push_cb(uvchan_handle_t* handle,
-                                    uvchan_error_t err);
-static void _uvchan_default_pop_cb(uvchan_handle_t* handle, void* buffer,
-                                   uvchan_error_t err);
+#define _UVCHAN_PUSH_SIDE 0
+#define _UVCHAN_POP_SIDE 1
+
+// a loop attached to a threadsafe channel. waiters of this loop are
+// only ever touched by it's own thread, other threads ask it to wake
+// them through async handle.
+typedef struct _uvchan_endpoint_t {
+  uv_async_t async;
+  uv_loop_t* loop;
+#ifdef LIBUV_1X
+  uv_thread_t thread;
+#endif
+  uvchan_t* chan;
+  uvchan_waiter_t waiters[2];
+  int armed[2];
+  int pending;
+  struct _uvchan_endpoint_t* next;
+} uvchan_endpoint_t;
+
+static void _uvchan_default_push_cb(uvchan_handle_t* handle,
+                                    uvchan_error_t err);
+static void _uvchan_default_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                   uvchan_error_t err);
+static void _uvchan_dealloc_items(uvchan_t* chan);
+static void _uvchan_shm_close_poll(uv_poll_t* poll);
+static void _uvchan_endpoints_wake(uvchan_t* chan, int side);
+#ifdef LIBUV_0X
+static void _uvchan_start_pop_idle_cb(uv_idle_t* handle, int status);
+#elif LIBUV_1X
+static void _uvchan_start_pop_idle_cb(uv_idle_t* handle);
+#else
+#error callback not defined for unknown version of libuv
+#endif
+
+uvchan_t* uvchan_new(size_t num_elements, size_t element_size) {
+  return uvchan_new_ex(num_elements, element_size, 0);
+}
+
+static void _uvchan_init_state(uvchan_t* chan) {
+  chan->closed = 0;
+  chan->polling = 0;
+  chan->reference_count = 1;
+  chan->reserving = 0;
+  chan->peeking = 0;
+  chan->dealloc = 0L;
+  chan->_data_poll = 0L;
+  chan->_space_poll = 0L;
+  chan->_endpoints = 0L;
+  chan->_armed[_UVCHAN_PUSH_SIDE] = 0;
+  chan->_armed[_UVCHAN_POP_SIDE] = 0;
+
+  if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    uv_mutex_init(&chan->_lock);
+  }
+  _uvchan_waiter_init(&chan->push_waiters, 0L, 0L);
+  _uvchan_waiter_init(&chan->pop_waiters, 0L, 0L);
+}
+
+// ring of an inline channel starts on its own cache line
+#define _UVCHAN_INLINE_OFFSET                                    \
+  ((sizeof(uvchan_t) + kUvChanCacheLineSize - 1) &               \
+   ~((size_t)kUvChanCacheLineSize - 1))
+
+static uvchan_t* _uvchan_chan_alloc(uvchan_pool_t* pool,
+                                    uvchan_arena_t* arena, size_t size) {
+  uvchan_t* chan;
+
+  if (arena != 0L) {
+    chan = (uvchan_t*)uvchan_arena_alloc(arena, size);
+  } else if (pool != 0L) {
+    chan = (uvchan_t*)uvchan_pool_alloc(pool, size);
+  } else {
+    chan = (uvchan_t*)_uvchan_malloc(size);
+  }
+
+  if (chan == 0L) {
+    return 0L;
+  }
+
+  chan->_pool = pool;
+  chan->_arena = arena;
+  chan->_block_size = size;
+
+  return chan;
+}
+
+static void _uvchan_chan_free(uvchan_t* chan) {
+  if (chan->_arena != 0L) {
+    // released along with arena
+    return;
+  } else if (chan->_pool != 0L) {
+    uvchan_pool_free(chan->_pool, chan, chan->_block_size);
+  } else {
+    _uvchan_free(chan);
+  }
+}
+
+// plain buffered channel with its ring in the same block
+static uvchan_t* _uvchan_new_inline(uvchan_pool_t* pool,
+                                    uvchan_arena_t* arena,
+                                    size_t num_elements, size_t element_size,
+                                    int poll_required) {
+  uvchan_t* chan;
+
+  chan = _uvchan_chan_alloc(
+      pool, arena,
+      _UVCHAN_INLINE_OFFSET +
+          uvchan_queue_buffer_size(num_elements, element_size));
+  if (chan == 0L) {
+    return 0L;
+  }
+
+  chan->flags = 0;
+  chan->poll_required = poll_required;
+  uvchan_queue_init_buffer(&chan->queue, num_elements, element_size,
+                           (char*)chan + _UVCHAN_INLINE_OFFSET);
+  _uvchan_init_state(chan);
+
+  return chan;
+}
+
+uvchan_t* uvchan_new_pooled(uvchan_pool_t* pool, size_t num_elements,
+                            size_t element_size) {
+  if (num_elements < 1) {
+    return _uvchan_new_inline(pool, 0L, 1, element_size, 1);
+  }
+
+  return _uvchan_new_inline(pool, 0L, num_elements, element_size, 0);
+}
+
+uvchan_t* uvchan_new_arena(uvchan_arena_t* arena, size_t num_elements,
+                           size_t element_size) {
+  if (num_elements < 1) {
+    return _uvchan_new_inline(0L, arena, 1, element_size, 1);
+  }
+
+  return _uvchan_new_inline(0L, arena, num_elements, element_size, 0);
+}
+
+uvchan_t* uvchan_new_ex(size_t num_elements, size_t element_size,
+                        unsigned int flags) {
+  uvchan_t* chan;
+  int poll_required;
+  int failed;
+
+  // loops of different threads may push and pop concurrently
+  if (flags & UVCHAN_FLAG_THREADSAFE) {
+    flags = UVCHAN_FLAG_THREADSAFE | UVCHAN_FLAG_MPMC;
+  }
+
+  if (flags & UVCHAN_FLAG_SHM) {
+    // waiting for a poller can not be observed across processes, so
+    // shared memory channels are always buffered.
+    if (num_elements < 1) {
+      num_elements = 1;
+    }
+    poll_required = 0;
+  } else if (num_elements < 1 && !(flags & UVCHAN_FLAG_UNBOUNDED)) {
+    num_elements = 1;
+    poll_required = 1;
+  } else {
+    poll_required = 0;
+  }
+
+  if (flags == 0 && uvchan_queue_buffer_size(num_elements, element_size) <=
+                        kUvChanInlineRingSize) {
+    return _uvchan_new_inline(0L, 0L, num_elements, element_size,
+                              poll_required);
+  }
+
+  chan = _uvchan_chan_alloc(0L, 0L, sizeof(uvchan_t));
+  if (chan == 0L) {
+    return 0L;
+  }
+
+  chan->flags = flags;
+  chan->poll_required = poll_required;
+
+  if (flags & UVCHAN_FLAG_SHM) {
+    failed = uvchan_shm_queue_init(&chan->shm_queue, num_elements,
+                                   element_size) != UVCHAN_ERR_SUCCESS;
+  } else if (flags & UVCHAN_FLAG_MPMC) {
+    uvchan_mpmc_queue_init(&chan->mpmc_queue, num_elements, element_size);
+    failed = chan->mpmc_queue._buffer == 0L;
+  } else if (flags & UVCHAN_FLAG_UNBOUNDED) {
+    uvchan_segment_queue_init(&chan->segment_queue, num_elements,
+                              element_size);
+    failed = chan->segment_queue._read_segment == 0L;
+  } else {
+    if (!(flags & UVCHAN_FLAG_MIRRORED) ||
+        uvchan_queue_init_ex(&chan->queue, num_elements, element_size,
+                             UVCHAN_QUEUE_MIRRORED) != UVCHAN_ERR_SUCCESS) {
+      uvchan_queue_init(&chan->queue, num_elements, element_size);
+    }
+    failed = chan->queue._buffer == 0L;
+  }
+
+  // ring could not be set up, and holds nothing to release
+  if (failed) {
+    _uvchan_chan_free(chan);
+    return 0L;
+  }
+
+  _uvchan_init_state(chan);
+
+  return chan;
+}
+
+uvchan_t* uvchan_new_bytes(size_t capacity_bytes) {
+  uvchan_t* chan;
+
+  chan = _uvchan_chan_alloc(0L, 0L, sizeof(uvchan_t));
+  if (chan == 0L) {
+    return 0L;
+  }
+
+  chan->flags = UVCHAN_FLAG_BYTES;
+  chan->poll_required = 0;
+  uvchan_byte_queue_init(&chan->byte_queue, capacity_bytes);
+  if (chan->byte_queue._buffer == 0L) {
+    _uvchan_chan_free(chan);
+    return 0L;
+  }
+
+  _uvchan_init_state(chan);
+
+  return chan;
+}
+
+uvchan_t* uvchan_open_shm(int mem_fd, int data_fd, int space_fd,
+                          size_t element_size) {
+  uvchan_t* chan;
+
+  chan = _uvchan_chan_alloc(0L, 0L, sizeof(uvchan_t));
+  if (chan == 0L) {
+    return 0L;
+  }
+
+  chan->flags = UVCHAN_FLAG_SHM;
+  chan->poll_required = 0;
+
+  if (uvchan_shm_queue_open(&chan->shm_queue, mem_fd, data_fd, space_fd,
+                            element_size) != UVCHAN_ERR_SUCCESS) {
+    _uvchan_chan_free(chan);
+    return 0L;
+  }
+
+  _uvchan_init_state(chan);
+
+  return chan;
+}
+
+uvchan_t* uvchan_new_owned(size_t num_elements, unsigned int flags,
+                           uvchan_dealloc_cb dealloc) {
+  uvchan_t* chan;
+
+  chan = uvchan_new_ex(num_elements, sizeof(void*), flags);
+  if (chan == 0L) {
+    return 0L;
+  }
+  chan->dealloc = dealloc;
+
+  return chan;
+}
+
+// state of a threadsafe channel is shared by loops of several threads
+static int _uvchan_add(uvchan_t* chan, int* counter, int value) {
+  if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    return _UVCHAN_ADD_FETCH(counter, value);
+  }
+
+  return (*counter += value);
+}
+
+void uvchan_unref(uvchan_t* chan) {
+  if (_uvchan_add(chan, &chan->reference_count, -1) < 1) {
+    if (chan->dealloc != 0L) {
+      _uvchan_dealloc_items(chan);
+    }
+
+    if (chan->flags & UVCHAN_FLAG_SHM) {
+      _uvchan_shm_close_poll(chan->_data_poll);
+      _uvchan_shm_close_poll(chan->_space_poll);
+      uvchan_shm_queue_destroy(&chan->shm_queue);
+    } else if (chan->flags & UVCHAN_FLAG_MPMC) {
+      uvchan_mpmc_queue_destroy(&chan->mpmc_queue);
+    } else if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+      uvchan_segment_queue_destroy(&chan->segment_queue);
+    } else if (chan->flags & UVCHAN_FLAG_BYTES) {
+      uvchan_byte_queue_destroy(&chan->byte_queue);
+    } else {
+      uvchan_queue_destroy(&chan->queue);
+    }
+    if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+      uv_mutex_destroy(&chan->_lock);
+    }
+    _uvchan_chan_free(chan);
+  }
+}
+
+void uvchan_ref(uvchan_t* chan) {
+  _uvchan_add(chan, &chan->reference_count, 1);
+}
+
+void uvchan_close(uvchan_t* chan) {
+  _UVCHAN_STORE_RELEASE(&chan->closed, 1);
+
+  if (chan->flags & UVCHAN_FLAG_SHM) {
+    uvchan_shm_queue_close(&chan->shm_queue);
+  } else if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    _uvchan_endpoints_wake(chan, -1);
+    return;
+  }
+
+  _uvchan_waiter_wake_all(&chan->push_waiters);
+  _uvchan_waiter_wake_all(&chan->pop_waiters);
+}
+
+void _uvchan_waiter_init(uvchan_waiter_t* waiter, uv_idle_t* idle_handle,
+                         uv_idle_cb idle_cb) {
+  waiter->next = waiter;
+  waiter->prev = waiter;
+  waiter->idle_handle = idle_handle;
+  waiter->idle_cb = idle_cb;
+  waiter->queue = 0L;
+  waiter->woken = 0;
+}
+
+void _uvchan_waiter_park(uvchan_waiter_t* waiters, uvchan_waiter_t* waiter,
+                         int front) {
+  if (front) {
+    waiters = waiters->next;
+  }
+
+  waiter->prev = waiters->prev;
+  waiter->next = waiters;
+  waiters->prev->next = waiter;
+  waiters->prev = waiter;
+}
+
+static void _uvchan_waiter_unlink(uvchan_waiter_t* waiter) {
+  waiter->prev->next = waiter->next;
+  waiter->next->prev = waiter->prev;
+  waiter->next = waiter;
+  waiter->prev = waiter;
+}
+
+void _uvchan_waiter_unpark(uvchan_waiter_t* waiter) {
+  uvchan_waiter_t* waiters;
+
+  // a woken waiter giving up passes its turn to the next one in line,
+  // otherwise progress it was woken for would go unnoticed
+  waiters = waiter->queue;
+  if (_uvchan_waiter_claim(waiter)) {
+    _uvchan_waiter_wake_one(waiters);
+  } else {
+    _uvchan_waiter_unlink(waiter);
+  }
+}
+
+int _uvchan_waiter_claim(uvchan_waiter_t* waiter) {
+  if (waiter->queue == 0L) {
+    return 0;
+  }
+
+  waiter->queue->woken--;
+  waiter->queue = 0L;
+
+  return 1;
+}
+
+int _uvchan_waiter_idle(uvchan_waiter_t* waiters) {
+  return waiters->next == waiters && waiters->woken == 0;
+}
+
+void _uvchan_waiter_wake_one(uvchan_waiter_t* waiters) {
+  uvchan_waiter_t* waiter;
+
+  waiter = waiters->next;
+  if (waiter == waiters) {
+    return;
+  }
+
+  _uvchan_waiter_unlink(waiter);
+  waiter->queue = waiters;
+  waiters->woken++;
+
+  uv_idle_start(waiter->idle_handle, waiter->idle_cb);
+}
+
+void _uvchan_waiter_wake_all(uvchan_waiter_t* waiters) {
+  while (waiters->next != waiters) {
+    _uvchan_waiter_wake_one(waiters);
+  }
+}
+
+static void _uvchan_shm_poll_close_cb(uv_handle_t* handle) {
+  _uvchan_free(handle);
+}
+
+static void _uvchan_shm_close_poll(uv_poll_t* poll) {
+  if (poll != 0L) {
+    uv_close((uv_handle_t*)poll, _uvchan_shm_poll_close_cb);
+  }
+}
+
+static void _uvchan_shm_wake_closed(uvchan_t* chan) {
+  chan->closed = 1;
+  _uvchan_waiter_wake_all(&chan->push_waiters);
+  _uvchan_waiter_wake_all(&chan->pop_waiters);
+}
+
+static void _uvchan_shm_poll_cb(uv_poll_t* poll, int status, int events) {
+  uvchan_t* chan;
+
+  chan = (uvchan_t*)poll->data;
+
+  uv_poll_stop(poll);
+
+  if (poll == chan->_data_poll) {
+    uvchan_shm_queue_ack(chan->shm_queue.data_fd);
+  } else {
+    uvchan_shm_queue_ack(chan->shm_queue.space_fd);
+  }
+
+  if (uvchan_shm_queue_closed(&chan->shm_queue)) {
+    _uvchan_shm_wake_closed(chan);
+  } else if (poll == chan->_data_poll) {
+    _uvchan_waiter_wake_all(&chan->pop_waiters);
+  } else {
+    _uvchan_waiter_wake_all(&chan->push_waiters);
+  }
+}
+
+static void _uvchan_shm_watch(uvchan_t* chan, uv_loop_t* loop,
+                              uvchan_waiter_t* waiters) {
+  uvchan_error_t err;
+  uv_poll_t** poll;
+  int fd;
+
+  if (waiters == &chan->pop_waiters) {
+    err = uvchan_shm_queue_arm_pop(&chan->shm_queue);
+    poll = &chan->_data_poll;
+    fd = chan->shm_queue.data_fd;
+  } else {
+    err = uvchan_shm_queue_arm_push(&chan->shm_queue);
+    poll = &chan->_space_poll;
+    fd = chan->shm_queue.space_fd;
+  }
+
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    _uvchan_shm_wake_closed(chan);
+    return;
+  } else if (err == UVCHAN_ERR_SUCCESS) {
+    // other process made progress while we were parking
+    _uvchan_waiter_wake_all(waiters);
+    return;
+  }
+
+  if (*poll == 0L) {
+    *poll = (uv_poll_t*)_uvchan_malloc(sizeof(uv_poll_t));
+    if (*poll == 0L) {
+      // without a watcher nobody would wake waiters, let them retry on
+      // next iteration instead
+      _uvchan_waiter_wake_all(waiters);
+      return;
+    }
+    uv_poll_init(loop, *poll, fd);
+    (*poll)->data = chan;
+  }
+
+  uv_poll_start(*poll, UV_READABLE, _uvchan_shm_poll_cb);
+}
+
+static int _uvchan_endpoint_is_current(uvchan_endpoint_t* endpoint) {
+#ifdef LIBUV_1X
+  uv_thread_t self;
+
+  self = uv_thread_self();
+  return uv_thread_equal(&endpoint->thread, &self);
+#else
+  ((void)endpoint);
+  return 0;
+#endif
+}
+
+static void _uvchan_endpoint_wake_all(uvchan_endpoint_t* endpoint) {
+  _uvchan_waiter_wake_all(&endpoint->waiters[_UVCHAN_PUSH_SIDE]);
+  _uvchan_waiter_wake_all(&endpoint->waiters[_UVCHAN_POP_SIDE]);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_endpoint_async_cb(uv_async_t* async, int status) {
+#elif LIBUV_1X
+static void _uvchan_endpoint_async_cb(uv_async_t* async) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_endpoint_t* endpoint;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  endpoint = (uvchan_endpoint_t*)async;
+
+  // cleared before waking, so that a wake racing with us is not lost
+  _UVCHAN_EXCHANGE(&endpoint->pending, 0);
+  _uvchan_endpoint_wake_all(endpoint);
+}
+
+static void _uvchan_endpoint_close_cb(uv_handle_t* handle) {
+  uvchan_endpoint_t* endpoint;
+
+  endpoint = (uvchan_endpoint_t*)handle;
+
+  uvchan_unref(endpoint->chan);
+  _uvchan_free(endpoint);
+}
+
+// wakes loops which have waiters on one @p side of channel, or every
+// loop if @p side is negative. waiters of current loop are woken in
+// place, other loops get at most one pending uv_async_send each.
+static void _uvchan_endpoints_wake(uvchan_t* chan, int side) {
+  uvchan_endpoint_t* endpoint;
+
+  if (side >= 0) {
+    // pairs with fence in _uvchan_park
+    _UVCHAN_FENCE_SEQ_CST();
+    if (!_UVCHAN_LOAD_RELAXED(&chan->_armed[side]) ||
+        !_UVCHAN_EXCHANGE(&chan->_armed[side], 0)) {
+      return;
+    }
+  }
+
+  uv_mutex_lock(&chan->_lock);
+
+  for (endpoint = chan->_endpoints; endpoint != 0L;
+       endpoint = endpoint->next) {
+    if (side >= 0 && (!_UVCHAN_LOAD_RELAXED(&endpoint->armed[side]) ||
+                      !_UVCHAN_EXCHANGE(&endpoint->armed[side], 0))) {
+      continue;
+    }
+
+    if (_uvchan_endpoint_is_current(endpoint)) {
+      _uvchan_endpoint_wake_all(endpoint);
+    } else if (!_UVCHAN_EXCHANGE(&endpoint->pending, 1)) {
+      uv_async_send(&endpoint->async);
+    }
+  }
+
+  uv_mutex_unlock(&chan->_lock);
+}
+
+static uvchan_endpoint_t* _uvchan_find_endpoint(uvchan_t* chan,
+                                                uv_loop_t* loop) {
+  uvchan_endpoint_t* endpoint;
+
+  uv_mutex_lock(&chan->_lock);
+  for (endpoint = chan->_endpoints;
+       endpoint != 0L && endpoint->loop != loop;
+       endpoint = endpoint->next) {
+  }
+  uv_mutex_unlock(&chan->_lock);
+
+  return endpoint;
+}
+
+// tells whether an operation on @p side might succeed now
+static int _uvchan_threadsafe_ready(uvchan_t* chan, int side) {
+  if (_UVCHAN_LOAD_ACQUIRE(&chan->closed)) {
+    return 1;
+  } else if (side == _UVCHAN_POP_SIDE) {
+    return _uvchan_mpmc_queue_can_pop(&chan->mpmc_queue);
+  }
+
+  return (!chan->poll_required || _UVCHAN_LOAD_RELAXED(&chan->polling)) &&
+         _uvchan_mpmc_queue_can_push(&chan->mpmc_queue);
+}
+
+static void _uvchan_threadsafe_park(uvchan_t* chan, uv_loop_t* loop,
+                                    int side, uvchan_waiter_t* waiter,
+                                    int front) {
+  uvchan_endpoint_t* endpoint;
+
+  endpoint = _uvchan_find_endpoint(chan, loop);
+  assert(endpoint != 0L && "loop is not attached to threadsafe channel");
+
+  _uvchan_waiter_park(&endpoint->waiters[side], waiter, front);
+
+  // announce waiter before checking channel again. either the other
+  // side sees the announcement, or we see it's progress.
+  _UVCHAN_EXCHANGE(&endpoint->armed[side], 1);
+  _UVCHAN_EXCHANGE(&chan->_armed[side], 1);
+  _UVCHAN_FENCE_SEQ_CST();
+
+  if (_uvchan_threadsafe_ready(chan, side)) {
+    _uvchan_waiter_wake_all(&endpoint->waiters[side]);
+  }
+}
+
+void _uvchan_park(uvchan_t* chan, uv_loop_t* loop, uvchan_waiter_t* waiters,
+                  uvchan_waiter_t* waiter, int front) {
+  // select keeps its cases parked on channels it was not woken by
+  if (waiter->next != waiter) {
+    return;
+  }
+
+  if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    _uvchan_threadsafe_park(
+        chan, loop,
+        waiters == &chan->pop_waiters ? _UVCHAN_POP_SIDE : _UVCHAN_PUSH_SIDE,
+        waiter, front);
+    return;
+  }
+
+  _uvchan_waiter_park(waiters, waiter, front);
+
+  if (chan->flags & UVCHAN_FLAG_SHM) {
+    _uvchan_shm_watch(chan, loop, waiters);
+  }
+}
+
+void _uvchan_wake(uvchan_t* chan, uvchan_waiter_t* waiters) {
+  if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    _uvchan_endpoints_wake(chan, waiters == &chan->pop_waiters
+                                     ? _UVCHAN_POP_SIDE
+                                     : _UVCHAN_PUSH_SIDE);
+    return;
+  }
+
+  _uvchan_waiter_wake_one(waiters);
+}
+
+// tells whether an operation may try channel now, or has to queue up
+// behind operations which arrived before it
+static int _uvchan_turn(uvchan_t* chan, uvchan_waiter_t* waiters, int woken) {
+  return woken || _UVCHAN_LOAD_ACQUIRE(&chan->closed) ||
+         _uvchan_waiter_idle(waiters);
+}
+
+uvchan_error_t uvchan_attach(uvchan_t* chan, uv_loop_t* loop) {
+  uvchan_endpoint_t* endpoint;
+
+  if (!(chan->flags & UVCHAN_FLAG_THREADSAFE)) {
+    return UVCHAN_ERR_SUCCESS;
+  }
+
+  endpoint = (uvchan_endpoint_t*)_uvchan_malloc(sizeof(uvchan_endpoint_t));
+  if (endpoint == 0L) {
+    return UVCHAN_ERR_NO_MEMORY;
+  }
+
+  uv_async_init(loop, &endpoint->async, _uvchan_endpoint_async_cb);
+  endpoint->loop = loop;
+#ifdef LIBUV_1X
+  endpoint->thread = uv_thread_self();
+#endif
+  endpoint->chan = chan;
+  _uvchan_waiter_init(&endpoint->waiters[_UVCHAN_PUSH_SIDE], 0L, 0L);
+  _uvchan_waiter_init(&endpoint->waiters[_UVCHAN_POP_SIDE], 0L, 0L);
+  endpoint->armed[_UVCHAN_PUSH_SIDE] = 0;
+  endpoint->armed[_UVCHAN_POP_SIDE] = 0;
+  endpoint->pending = 0;
+  uvchan_ref(chan);
+
+  uv_mutex_lock(&chan->_lock);
+  endpoint->next = chan->_endpoints;
+  chan->_endpoints = endpoint;
+  uv_mutex_unlock(&chan->_lock);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_detach(uvchan_t* chan, uv_loop_t* loop) {
+  uvchan_endpoint_t** link;
+  uvchan_endpoint_t* endpoint;
+
+  if (!(chan->flags & UVCHAN_FLAG_THREADSAFE)) {
+    return;
+  }
+
+  endpoint = 0L;
+
+  uv_mutex_lock(&chan->_lock);
+  for (link = &chan->_endpoints; *link != 0L; link = &(*link)->next) {
+    if ((*link)->loop == loop) {
+      endpoint = *link;
+      *link = endpoint->next;
+      break;
+    }
+  }
+  uv_mutex_unlock(&chan->_lock);
+
+  if (endpoint != 0L) {
+    uv_close((uv_handle_t*)&endpoint->async, _uvchan_endpoint_close_cb);
+  }
+}
+
+static uvchan_error_t _uvchan_queue_push(uvchan_t* chan,
+                                         const void* element) {
+  if (chan->flags & UVCHAN_FLAG_SHM) {
+    // consumer process may have closed channel
+    if (uvchan_shm_queue_closed(&chan->shm_queue)) {
+      chan->closed = 1;
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+    return uvchan_shm_queue_push(&chan->shm_queue, element);
+  } else if (chan->flags & UVCHAN_FLAG_BYTES) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (chan->flags & UVCHAN_FLAG_MPMC) {
+    return uvchan_mpmc_queue_push(&chan->mpmc_queue, element);
+  } else if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return uvchan_segment_queue_push(&chan->segment_queue, element);
+  }
+
+  return uvchan_queue_push(&chan->queue, element);
+}
+
+static uvchan_error_t _uvchan_queue_pop(uvchan_t* chan, void* element) {
+  if (chan->flags & UVCHAN_FLAG_SHM) {
+    return uvchan_shm_queue_pop(&chan->shm_queue, element);
+  } else if (chan->flags & UVCHAN_FLAG_BYTES) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (chan->flags & UVCHAN_FLAG_MPMC) {
+    return uvchan_mpmc_queue_pop(&chan->mpmc_queue, element);
+  } else if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return uvchan_segment_queue_pop(&chan->segment_queue, element);
+  }
+
+  return uvchan_queue_pop(&chan->queue, element);
+}
+
+// hands every item left in an owned channel to it's dealloc
+// callback, so that channel can be destroyed while not empty.
+static void _uvchan_dealloc_items(uvchan_t* chan) {
+  void* item;
+
+  while (_uvchan_queue_pop(chan, &item) == UVCHAN_ERR_SUCCESS) {
+    chan->dealloc(item);
+  }
+}
+
+static uvchan_error_t _uvchan_queue_reserve(uvchan_t* chan, void** slot) {
+  if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return uvchan_segment_queue_reserve(&chan->segment_queue, slot);
+  }
+
+  return uvchan_queue_reserve(&chan->queue, slot);
+}
+
+static void _uvchan_queue_commit(uvchan_t* chan) {
+  if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    uvchan_segment_queue_commit(&chan->segment_queue);
+  } else {
+    uvchan_queue_commit(&chan->queue);
+  }
+}
+
+static uvchan_error_t _uvchan_queue_peek(uvchan_t* chan, const void** slot) {
+  if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return uvchan_segment_queue_peek(&chan->segment_queue, slot);
+  }
+
+  return uvchan_queue_peek(&chan->queue, slot);
+}
+
+static void _uvchan_queue_release(uvchan_t* chan) {
+  if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    uvchan_segment_queue_release(&chan->segment_queue);
+  } else if (chan->flags & UVCHAN_FLAG_BYTES) {
+    uvchan_byte_queue_release(&chan->byte_queue);
+  } else {
+    uvchan_queue_release(&chan->queue);
+  }
+}
+
+uvchan_error_t _uvchan_try_push(uvchan_t* chan, const void* element) {
+  if ((chan->poll_required && !_UVCHAN_LOAD_RELAXED(&chan->polling)) ||
+      chan->reserving ||
+      (_uvchan_queue_push(chan, element) != UVCHAN_ERR_SUCCESS)) {
+    return UVCHAN_ERR_QUEUE_FULL;
+  }
+
+  _uvchan_wake(chan, &chan->pop_waiters);
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t _uvchan_try_pop(uvchan_t* chan, void* element) {
+  if (chan->peeking ||
+      (_uvchan_queue_pop(chan, element) != UVCHAN_ERR_SUCCESS)) {
+    return UVCHAN_ERR_QUEUE_EMPTY;
+  }
+
+  _uvchan_wake(chan, &chan->push_waiters);
+  return UVCHAN_ERR_SUCCESS;
+}
+
+static void _uvchan_add_poller(uvchan_t* chan) {
+  _uvchan_add(chan, &chan->polling, 1);
+
+  // unbuffered channels only accept pushes while someone is polling
+  if (chan->poll_required) {
+    _uvchan_wake(chan, &chan->push_waiters);
+  }
+}
+
+// a parked operation whose deadline passed or which was cancelled
+// leaves line right away. one woken already is left alone, it gives up
+// on its own turn.
+static void _uvchan_handle_abort(uvchan_handle_t* handle) {
+  if (handle->waiter.queue == 0L) {
+    _uvchan_waiter_unpark(&handle->waiter);
+  }
+
+  uv_idle_start((uv_idle_t*)handle, handle->waiter.idle_cb);
+}
+
+static void _uvchan_handle_expire_cb(uvchan_deadline_t* deadline) {
+  uvchan_handle_t* handle;
+
+  handle = (uvchan_handle_t*)((char*)deadline -
+                              offsetof(uvchan_handle_t, deadline));
+  _uvchan_handle_abort(handle);
+}
+
+static void _uvchan_handle_cancel_cb(uvchan_cancel_link_t* link) {
+  uvchan_handle_t* handle;
+
+  handle = (uvchan_handle_t*)((char*)link - offsetof(uvchan_handle_t, cancel));
+  _uvchan_handle_abort(handle);
+}
+
+void uvchan_handle_init(uv_loop_t* loop, uvchan_handle_t* handle,
+                        uvchan_t* ch) {
+  uv_idle_init(loop, (uv_idle_t*)handle);
+  handle->callback = 0L;
+  handle->ch = ch;
+  handle->data = 0L;
+  handle->reading = 0;
+  _uvchan_waiter_init(&handle->waiter, (uv_idle_t*)handle, 0L);
+  uvchan_deadline_init(&handle->deadline, _uvchan_handle_expire_cb);
+  uvchan_cancel_link_init(&handle->cancel, _uvchan_handle_cancel_cb);
+}
+
+void uvchan_handle_set_deadline(uvchan_handle_t* handle, uvchan_wheel_t* wheel,
+                                uint64_t timeout_ms) {
+  uvchan_deadline_disarm(&handle->deadline);
+  handle->deadline.wheel = wheel;
+  handle->deadline.timeout = timeout_ms;
+  handle->deadline.expired = 0;
+}
+
+void uvchan_handle_set_cancel(uvchan_handle_t* handle,
+                              uvchan_cancel_t* cancel) {
+  uvchan_cancel_detach(&handle->cancel);
+  handle->cancel.cancel = cancel;
+  handle->cancel.cancelled = 0;
+}
+
+static void _uvchan_handle_arm(uvchan_handle_t* handle) {
+  if (handle->deadline.wheel != 0L) {
+    uvchan_deadline_arm(&handle->deadline, handle->deadline.wheel,
+                        handle->deadline.timeout);
+  } else {
+    handle->deadline.expired = 0;
+  }
+
+  handle->cancel.cancelled = 0;
+  uvchan_cancel_attach(&handle->cancel);
+}
+
+// deadline is off wheel and operation is detached from its token while
+// it runs, both count again once it waits
+static void _uvchan_handle_disarm(uvchan_handle_t* handle) {
+  uvchan_deadline_disarm(&handle->deadline);
+  uvchan_cancel_detach(&handle->cancel);
+}
+
+static void _uvchan_handle_park(uvchan_handle_t* handle,
+                                uvchan_waiter_t* waiters, int front) {
+  _uvchan_park(handle->ch, handle->idle_handle.loop, waiters,
+               &handle->waiter, front);
+  uvchan_deadline_rearm(&handle->deadline);
+  uvchan_cancel_attach(&handle->cancel);
+
+  // token may have been cancelled by a callback this operation ran
+  if (handle->cancel.cancelled) {
+    _uvchan_handle_abort(handle);
+  }
+}
+
+// a token cancelled before operation got to run wins over a ready
+// channel, and a turn operation was woken for passes on to next waiter
+static int _uvchan_handle_cancelled(uvchan_handle_t* handle,
+                                    uvchan_waiter_t* waiters, int woken) {
+  if (!handle->cancel.cancelled) {
+    return 0;
+  }
+
+  if (woken) {
+    _uvchan_wake(handle->ch, waiters);
+  }
+
+  return 1;
+}
+
+static int _uvchan_handle_aborted(uvchan_handle_t* handle) {
+  return handle->cancel.cancelled || handle->deadline.expired;
+}
+
+static uvchan_error_t _uvchan_handle_abort_error(uvchan_handle_t* handle) {
+  return handle->cancel.cancelled ? UVCHAN_ERR_CANCELLED : UVCHAN_ERR_TIMEOUT;
+}
+
+// bytes channels carry messages of any length, callers built around
+// fixed-size items have to refuse them
+size_t _uvchan_element_size(uvchan_t* chan) {
+  if (chan->flags & UVCHAN_FLAG_BYTES) {
+    return 0;
+  } else if (chan->flags & UVCHAN_FLAG_SHM) {
+    return chan->shm_queue._element_size;
+  } else if (chan->flags & UVCHAN_FLAG_MPMC) {
+    return chan->mpmc_queue.element_size;
+  } else if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return chan->segment_queue.element_size;
+  }
+
+  return chan->queue.element_size;
+}
+
+// rendezvous on an unbuffered channel. if a receiver is already parked,
+// item is copied straight into its buffer and receiver completes right
+// away, instead of going through channel's slot on a later iteration.
+static int _uvchan_handoff(uvchan_t* chan, const void* element) {
+  uvchan_waiter_t* waiter;
+  uvchan_handle_t* receiver;
+
+  // a reserved slot is ahead of us, and channels shared across loops or
+  // processes wake their receivers through own endpoints.
+  if (chan->reserving ||
+      (chan->flags &
+       (UVCHAN_FLAG_SHM | UVCHAN_FLAG_BYTES | UVCHAN_FLAG_THREADSAFE))) {
+    return 0;
+  }
+
+  // only the oldest receiver may take it, and only while no receiver
+  // has been woken for an item already sitting in channel
+  waiter = chan->pop_waiters.next;
+  if (waiter == &chan->pop_waiters || chan->pop_waiters.woken ||
+      waiter->idle_cb != _uvchan_start_pop_idle_cb) {
+    return 0;
+  }
+
+  receiver = (uvchan_handle_t*)waiter->idle_handle;
+  _uvchan_waiter_unpark(waiter);
+  _uvchan_handle_disarm(receiver);
+  memcpy(receiver->element, element, _uvchan_element_size(chan));
+  _uvchan_add(chan, &chan->polling, -1);
+
+  ((uvchan_pop_cb)(receiver->callback))(receiver, receiver->element,
+                                        UVCHAN_ERR_SUCCESS);
+  uvchan_unref(chan);
+
+  return 1;
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_push_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_push_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
+
+  if (_UVCHAN_LOAD_ACQUIRE(&ch_handle->ch->closed)) {
+    uv_idle_stop(handle);
+    ((uvchan_push_cb)(ch_handle->callback))(ch_handle,
+                                            UVCHAN_ERR_CHANNEL_CLOSED);
+
+    uvchan_unref(ch_handle->ch);
+  } else if (ch_handle->ch->flags & UVCHAN_FLAG_BYTES) {
+    uv_idle_stop(handle);
+    ((uvchan_push_cb)(ch_handle->callback))(ch_handle,
+                                            UVCHAN_ERR_NOT_SUPPORTED);
+
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch_handle->ch->push_waiters,
+                                      woken)) {
+    uv_idle_stop(handle);
+    ((uvchan_push_cb)(ch_handle->callback))(ch_handle, UVCHAN_ERR_CANCELLED);
+
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_turn(ch_handle->ch, &ch_handle->ch->push_waiters,
+                          woken) &&
+             ((ch_handle->ch->poll_required &&
+               _uvchan_handoff(ch_handle->ch, ch_handle->element)) ||
+              _uvchan_try_push(ch_handle->ch, ch_handle->element) ==
+                  UVCHAN_ERR_SUCCESS)) {
+    uv_idle_stop(handle);
+    ((uvchan_push_cb)(ch_handle->callback))(ch_handle, UVCHAN_ERR_SUCCESS);
+
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_handle_aborted(ch_handle)) {
+    uv_idle_stop(handle);
+    ((uvchan_push_cb)(ch_handle->callback))(
+        ch_handle, _uvchan_handle_abort_error(ch_handle));
+
+    uvchan_unref(ch_handle->ch);
+  } else {
+    uv_idle_stop(handle);
+    _uvchan_handle_park(ch_handle, &ch_handle->ch->push_waiters, woken);
+  }
+}
+
+void uvchan_start_push(uvchan_handle_t* handle, const void* element,
+                       uvchan_push_cb cb) {
+  if (cb == 0L) {
+    cb = &_uvchan_default_push_cb;
+  }
+
+  handle->element = (void*)element;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_push_idle_cb;
+  uvchan_ref(handle->ch);
+
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_push_idle_cb);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_pop_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_pop_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
+
+  if (ch_handle->ch->flags & UVCHAN_FLAG_BYTES) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch_handle->ch, &ch_handle->ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           UVCHAN_ERR_NOT_SUPPORTED);
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch_handle->ch->pop_waiters,
+                                      woken)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch_handle->ch, &ch_handle->ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           UVCHAN_ERR_CANCELLED);
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_turn(ch_handle->ch, &ch_handle->ch->pop_waiters,
+                          woken) &&
+             _uvchan_try_pop(ch_handle->ch, ch_handle->element) ==
+                 UVCHAN_ERR_SUCCESS) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch_handle->ch, &ch_handle->ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           UVCHAN_ERR_SUCCESS);
+    uvchan_unref(ch_handle->ch);
+  } else if (_UVCHAN_LOAD_ACQUIRE(&ch_handle->ch->closed)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch_handle->ch, &ch_handle->ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           UVCHAN_ERR_CHANNEL_CLOSED);
+    uvchan_unref(ch_handle->ch);
+  } else if (_uvchan_handle_aborted(ch_handle)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch_handle->ch, &ch_handle->ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(
+        ch_handle, ch_handle->element, _uvchan_handle_abort_error(ch_handle));
+    uvchan_unref(ch_handle->ch);
+  } else {
+    uv_idle_stop(handle);
+    _uvchan_handle_park(ch_handle, &ch_handle->ch->pop_waiters, woken);
+  }
+}
+
+void uvchan_start_pop(uvchan_handle_t* handle, void* element,
+                      uvchan_pop_cb cb) {
+  if (cb == 0L) {
+    cb = &_uvchan_default_pop_cb;
+  }
+
+  handle->element = element;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_pop_idle_cb;
+  uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
 
-uvchan_t* uvchan_new(size_t num_elements, size_t element_size) {
-  uvchan_t* chan;
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_pop_idle_cb);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_reserve_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_reserve_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  void* slot;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
 
-  chan = (uvchan_t*)malloc(sizeof(uvchan_t));
+  ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
 
-  if (num_elements < 1) {
-    num_elements = 1;
-    chan->poll_required = 1;
+  if (ch->flags &
+      (UVCHAN_FLAG_MPMC | UVCHAN_FLAG_SHM | UVCHAN_FLAG_BYTES)) {
+    uv_idle_stop(handle);
+    ((uvchan_reserve_cb)(ch_handle->callback))(ch_handle, 0L,
+                                               UVCHAN_ERR_NOT_SUPPORTED);
+
+    uvchan_unref(ch);
+  } else if (_UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    uv_idle_stop(handle);
+    ((uvchan_reserve_cb)(ch_handle->callback))(ch_handle, 0L,
+                                               UVCHAN_ERR_CHANNEL_CLOSED);
+
+    uvchan_unref(ch);
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->push_waiters, woken)) {
+    uv_idle_stop(handle);
+    ((uvchan_reserve_cb)(ch_handle->callback))(ch_handle, 0L,
+                                               UVCHAN_ERR_CANCELLED);
+
+    uvchan_unref(ch);
+  } else if (_uvchan_turn(ch, &ch->push_waiters, woken) &&
+             (!ch->poll_required || _UVCHAN_LOAD_RELAXED(&ch->polling)) &&
+             !ch->reserving &&
+             (_uvchan_queue_reserve(ch, &slot) == UVCHAN_ERR_SUCCESS)) {
+    uv_idle_stop(handle);
+    ch->reserving = 1;
+
+    // channel reference is kept until uvchan_commit
+    ((uvchan_reserve_cb)(ch_handle->callback))(ch_handle, slot,
+                                               UVCHAN_ERR_SUCCESS);
+  } else if (_uvchan_handle_aborted(ch_handle)) {
+    uv_idle_stop(handle);
+    ((uvchan_reserve_cb)(ch_handle->callback))(
+        ch_handle, 0L, _uvchan_handle_abort_error(ch_handle));
+
+    uvchan_unref(ch);
   } else {
-    chan->poll_required = 0;
+    uv_idle_stop(handle);
+    _uvchan_handle_park(ch_handle, &ch->push_waiters, woken);
   }
+}
 
-  uvchan_queue_init(&chan->queue, num_elements, element_size);
-  chan->closed = 0;
-  chan->polling = 0;
-  chan->reference_count = 1;
+void uvchan_start_reserve(uvchan_handle_t* handle, uvchan_reserve_cb cb) {
+  handle->element = 0L;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_reserve_idle_cb;
+  uvchan_ref(handle->ch);
 
-  return chan;
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_reserve_idle_cb);
 }
 
-void uvchan_unref(uvchan_t* chan) {
-  if ((--chan->reference_count) < 1) {
-    uvchan_queue_destroy(&chan->queue);
-    free(chan);
-  }
-}
+void uvchan_commit(uvchan_handle_t* handle) {
+  uvchan_t* ch;
 
-void uvchan_ref(uvchan_t* chan) { ++chan->reference_count; }
+  ch = handle->ch;
 
-void uvchan_close(uvchan_t* chan) { chan->closed = 1; }
+  _uvchan_queue_commit(ch);
+  ch->reserving = 0;
+  _uvchan_wake(ch, &ch->pop_waiters);
+  _uvchan_wake(ch, &ch->push_waiters);
 
-void uvchan_handle_init(uv_loop_t* loop, uvchan_handle_t* handle,
-                        uvchan_t* ch) {
-  uv_idle_init(loop, (uv_idle_t*)handle);
-  handle->callback = 0L;
-  handle->ch = ch;
-  handle->data = 0L;
+  uvchan_unref(ch);
 }
 
 #ifdef LIBUV_0X
-static void _uvchan_start_push_idle_cb(uv_idle_t* handle, int status) {
+static void _uvchan_start_peek_idle_cb(uv_idle_t* handle, int status) {
 #elif LIBUV_1X
-static void _uvchan_start_push_idle_cb(uv_idle_t* handle) {
+static void _uvchan_start_peek_idle_cb(uv_idle_t* handle) {
 #else
 #error callback not defined for unknown version of libuv
 #endif
   uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  const void* slot;
+  int woken;
 
 #ifdef LIBUV_0X
   ((void)status);
 #endif
 
   ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
 
-  if (ch_handle->ch->closed) {
+  if (ch->flags &
+      (UVCHAN_FLAG_MPMC | UVCHAN_FLAG_SHM | UVCHAN_FLAG_BYTES)) {
     uv_idle_stop(handle);
-    ((uvchan_push_cb)(ch_handle->callback))(ch_handle,
+    _uvchan_add(ch, &ch->polling, -1);
+
+    ((uvchan_peek_cb)(ch_handle->callback))(ch_handle, 0L,
+                                            UVCHAN_ERR_NOT_SUPPORTED);
+    uvchan_unref(ch);
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->pop_waiters, woken)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch, &ch->polling, -1);
+
+    ((uvchan_peek_cb)(ch_handle->callback))(ch_handle, 0L,
+                                            UVCHAN_ERR_CANCELLED);
+    uvchan_unref(ch);
+  } else if (_uvchan_turn(ch, &ch->pop_waiters, woken) && !ch->peeking &&
+             (_uvchan_queue_peek(ch, &slot) == UVCHAN_ERR_SUCCESS)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch, &ch->polling, -1);
+    ch->peeking = 1;
+
+    // channel reference is kept until uvchan_release
+    ((uvchan_peek_cb)(ch_handle->callback))(ch_handle, slot,
+                                            UVCHAN_ERR_SUCCESS);
+  } else if (_UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch, &ch->polling, -1);
+
+    ((uvchan_peek_cb)(ch_handle->callback))(ch_handle, 0L,
                                             UVCHAN_ERR_CHANNEL_CLOSED);
+    uvchan_unref(ch);
+  } else if (_uvchan_handle_aborted(ch_handle)) {
+    uv_idle_stop(handle);
+    _uvchan_add(ch, &ch->polling, -1);
 
-    uvchan_unref(ch_handle->ch);
-  } else if ((!ch_handle->ch->poll_required || ch_handle->ch->polling) &&
-             (uvchan_queue_push(&ch_handle->ch->queue, ch_handle->element) ==
-              UVCHAN_ERR_SUCCESS)) {
+    ((uvchan_peek_cb)(ch_handle->callback))(
+        ch_handle, 0L, _uvchan_handle_abort_error(ch_handle));
+    uvchan_unref(ch);
+  } else {
     uv_idle_stop(handle);
-    ((uvchan_push_cb)(ch_handle->callback))(ch_handle, UVCHAN_ERR_SUCCESS);
+    _uvchan_handle_park(ch_handle, &ch->pop_waiters, woken);
+  }
+}
 
-    uvchan_unref(ch_handle->ch);
+void uvchan_start_peek(uvchan_handle_t* handle, uvchan_peek_cb cb) {
+  handle->element = 0L;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_peek_idle_cb;
+  uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
+
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_peek_idle_cb);
+}
+
+void uvchan_release(uvchan_handle_t* handle) {
+  uvchan_t* ch;
+
+  ch = handle->ch;
+
+  _uvchan_queue_release(ch);
+  ch->peeking = 0;
+  _uvchan_wake(ch, &ch->push_waiters);
+  _uvchan_wake(ch, &ch->pop_waiters);
+
+  uvchan_unref(ch);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_push_bytes_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_push_bytes_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  uvchan_error_t err;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
+
+  if (_UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    err = UVCHAN_ERR_CHANNEL_CLOSED;
+  } else if (!(ch->flags & UVCHAN_FLAG_BYTES)) {
+    err = UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->push_waiters, woken)) {
+    err = UVCHAN_ERR_CANCELLED;
+  } else if (!_uvchan_turn(ch, &ch->push_waiters, woken)) {
+    err = UVCHAN_ERR_QUEUE_FULL;
+  } else {
+    err = uvchan_byte_queue_push(&ch->byte_queue, ch_handle->element,
+                                 ch_handle->length);
   }
+
+  if (err == UVCHAN_ERR_QUEUE_FULL && _uvchan_handle_aborted(ch_handle)) {
+    err = _uvchan_handle_abort_error(ch_handle);
+  }
+
+  uv_idle_stop(handle);
+
+  if (err == UVCHAN_ERR_QUEUE_FULL) {
+    _uvchan_handle_park(ch_handle, &ch->push_waiters, woken);
+    return;
+  } else if (err == UVCHAN_ERR_SUCCESS) {
+    _uvchan_wake(ch, &ch->pop_waiters);
+  }
+
+  ((uvchan_push_cb)(ch_handle->callback))(ch_handle, err);
+  uvchan_unref(ch);
 }
 
-void uvchan_start_push(uvchan_handle_t* handle, const void* element,
-                       uvchan_push_cb cb) {
+void uvchan_start_push_bytes(uvchan_handle_t* handle, const void* buffer,
+                             size_t length, uvchan_push_cb cb) {
   if (cb == 0L) {
     cb = &_uvchan_default_push_cb;
   }
 
-  handle->element = (void*)element;
+  handle->element = (void*)buffer;
+  handle->length = length;
   handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_push_bytes_idle_cb;
   uvchan_ref(handle->ch);
 
-  uv_idle_start((uv_idle_t*)handle, _uvchan_start_push_idle_cb);
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_push_bytes_idle_cb);
 }
 
 #ifdef LIBUV_0X
-static void _uvchan_start_pop_idle_cb(uv_idle_t* handle, int status) {
+static void _uvchan_start_pop_bytes_idle_cb(uv_idle_t* handle, int status) {
 #elif LIBUV_1X
-static void _uvchan_start_pop_idle_cb(uv_idle_t* handle) {
+static void _uvchan_start_pop_bytes_idle_cb(uv_idle_t* handle) {
 #else
 #error callback not defined for unknown version of libuv
 #endif
   uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  uvchan_error_t err;
+  const void* data;
+  int woken;
 
 #ifdef LIBUV_0X
   ((void)status);
 #endif
 
   ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
 
-  if (uvchan_queue_pop(&ch_handle->ch->queue, ch_handle->element) ==
-      UVCHAN_ERR_SUCCESS) {
-    uv_idle_stop(handle);
-    ch_handle->ch->polling--;
+  if (!(ch->flags & UVCHAN_FLAG_BYTES)) {
+    err = UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->pop_waiters, woken)) {
+    err = UVCHAN_ERR_CANCELLED;
+  } else if (ch->peeking || !_uvchan_turn(ch, &ch->pop_waiters, woken)) {
+    err = UVCHAN_ERR_QUEUE_EMPTY;
+  } else if (ch_handle->element == 0L) {
+    // zero-copy peek, message stays in channel until uvchan_release
+    err = uvchan_byte_queue_peek(&ch->byte_queue, &data, &ch_handle->length);
+  } else {
+    data = ch_handle->element;
+    err = uvchan_byte_queue_pop(&ch->byte_queue, ch_handle->element,
+                                ch_handle->length, &ch_handle->length);
+  }
 
-    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
-                                           UVCHAN_ERR_SUCCESS);
-    uvchan_unref(ch_handle->ch);
-  } else if (ch_handle->ch->closed) {
-    uv_idle_stop(handle);
-    ch_handle->ch->polling--;
+  if (err == UVCHAN_ERR_QUEUE_EMPTY && _UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    err = UVCHAN_ERR_CHANNEL_CLOSED;
+  } else if (err == UVCHAN_ERR_QUEUE_EMPTY &&
+             _uvchan_handle_aborted(ch_handle)) {
+    err = _uvchan_handle_abort_error(ch_handle);
+  }
 
-    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
-                                           UVCHAN_ERR_CHANNEL_CLOSED);
-    uvchan_unref(ch_handle->ch);
+  uv_idle_stop(handle);
+
+  if (err == UVCHAN_ERR_QUEUE_EMPTY) {
+    _uvchan_handle_park(ch_handle, &ch->pop_waiters, woken);
+    return;
+  }
+
+  _uvchan_add(ch, &ch->polling, -1);
+
+  if (err != UVCHAN_ERR_SUCCESS) {
+    ((uvchan_bytes_cb)(ch_handle->callback))(ch_handle, 0L,
+                                             ch_handle->length, err);
+    uvchan_unref(ch);
+  } else if (ch_handle->element == 0L) {
+    ch->peeking = 1;
+
+    // channel reference is kept until uvchan_release
+    ((uvchan_bytes_cb)(ch_handle->callback))(ch_handle, data,
+                                             ch_handle->length, err);
+  } else {
+    _uvchan_wake(ch, &ch->push_waiters);
+
+    ((uvchan_bytes_cb)(ch_handle->callback))(ch_handle, data,
+                                             ch_handle->length, err);
+    uvchan_unref(ch);
   }
 }
 
-void uvchan_start_pop(uvchan_handle_t* handle, void* element,
-                      uvchan_pop_cb cb) {
-  if (cb == 0L) {
-    cb = &_uvchan_default_pop_cb;
+void uvchan_start_pop_bytes(uvchan_handle_t* handle, void* buffer,
+                            size_t capacity, uvchan_bytes_cb cb) {
+  handle->element = buffer;
+  handle->length = capacity;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_pop_bytes_idle_cb;
+  uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
+
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_pop_bytes_idle_cb);
+}
+
+void uvchan_start_peek_bytes(uvchan_handle_t* handle, uvchan_bytes_cb cb) {
+  uvchan_start_pop_bytes(handle, 0L, 0, cb);
+}
+
+static size_t _uvchan_queue_pop_n(uvchan_t* chan, void* buffer,
+                                  size_t num_elements) {
+  size_t element_size;
+  size_t count;
+
+  if (!(chan->flags & (UVCHAN_FLAG_SHM | UVCHAN_FLAG_BYTES |
+                       UVCHAN_FLAG_MPMC | UVCHAN_FLAG_UNBOUNDED))) {
+    return uvchan_queue_pop_n(&chan->queue, buffer, num_elements);
+  } else if (chan->flags & UVCHAN_FLAG_UNBOUNDED) {
+    return uvchan_segment_queue_pop_n(&chan->segment_queue, buffer,
+                                      num_elements);
   }
 
-  handle->element = element;
+  element_size = _uvchan_element_size(chan);
+  for (count = 0; count < num_elements; count++) {
+    if (_uvchan_queue_pop(chan, (char*)buffer + count * element_size) !=
+        UVCHAN_ERR_SUCCESS) {
+      break;
+    }
+  }
+
+  return count;
+}
+
+// a batch of popped items frees as many slots, so as many pushers as
+// wait for them may go
+static void _uvchan_wake_pushers(uvchan_t* chan, size_t count) {
+  size_t i;
+
+  if (chan->flags & UVCHAN_FLAG_THREADSAFE) {
+    _uvchan_wake(chan, &chan->push_waiters);
+    return;
+  }
+
+  for (i = 0; i < count && !_uvchan_waiter_idle(&chan->push_waiters); i++) {
+    _uvchan_waiter_wake_one(&chan->push_waiters);
+  }
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_pop_batch_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_pop_batch_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  uvchan_error_t err;
+  size_t count;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
+  count = 0;
+
+  if (ch->flags & UVCHAN_FLAG_BYTES) {
+    err = UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->pop_waiters, woken)) {
+    err = UVCHAN_ERR_CANCELLED;
+  } else {
+    // whatever is ready is copied out in bulk, and producers are woken
+    // once for all of it
+    if (_uvchan_turn(ch, &ch->pop_waiters, woken) && !ch->peeking) {
+      count = _uvchan_queue_pop_n(ch, ch_handle->element, ch_handle->length);
+      _uvchan_wake_pushers(ch, count);
+    }
+
+    if (count > 0) {
+      err = UVCHAN_ERR_SUCCESS;
+    } else if (_UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+      err = UVCHAN_ERR_CHANNEL_CLOSED;
+    } else if (_uvchan_handle_aborted(ch_handle)) {
+      err = _uvchan_handle_abort_error(ch_handle);
+    } else {
+      err = UVCHAN_ERR_QUEUE_EMPTY;
+    }
+  }
+
+  uv_idle_stop(handle);
+
+  if (err == UVCHAN_ERR_QUEUE_EMPTY) {
+    _uvchan_handle_park(ch_handle, &ch->pop_waiters, woken);
+    return;
+  }
+
+  _uvchan_add(ch, &ch->polling, -1);
+
+  ((uvchan_batch_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           count, err);
+  uvchan_unref(ch);
+}
+
+void uvchan_start_pop_batch(uvchan_handle_t* handle, void* buffer,
+                            size_t max_n, uvchan_batch_cb cb) {
+  assert(max_n > 0 && "batch has to hold at least one element");
+
+  handle->element = buffer;
+  handle->length = max_n;
   handle->callback = (void*)cb;
-  handle->ch->polling++;
+  handle->waiter.idle_cb = _uvchan_start_pop_batch_idle_cb;
   uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
 
-  uv_idle_start((uv_idle_t*)handle, _uvchan_start_pop_idle_cb);
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_pop_batch_idle_cb);
+}
+
+// pops everything ready into a growing buffer. buffer and its capacity
+// are kept by caller for the whole drain, so waking up to an empty
+// channel allocates nothing.
+static uvchan_error_t _uvchan_drain(uvchan_t* chan, void** buffer,
+                                   size_t* capacity, size_t* count) {
+  size_t element_size;
+  size_t grown_capacity;
+  size_t popped;
+  void* grown;
+
+  element_size = _uvchan_element_size(chan);
+  *count = 0;
+
+  if (chan->peeking) {
+    return UVCHAN_ERR_QUEUE_EMPTY;
+  }
+
+  do {
+    if (*count == *capacity) {
+      grown_capacity = *capacity ? *capacity * 2 : kUvChanDrainElements;
+      grown = _uvchan_realloc(*buffer, grown_capacity * element_size);
+      if (grown == 0L) {
+        break;
+      }
+      *buffer = grown;
+      *capacity = grown_capacity;
+    }
+
+    popped = _uvchan_queue_pop_n(chan, (char*)*buffer + *count * element_size,
+                                 *capacity - *count);
+    *count += popped;
+  } while (popped > 0 && *count == *capacity);
+
+  if (*count == 0) {
+    return *buffer == 0L ? UVCHAN_ERR_NO_MEMORY : UVCHAN_ERR_QUEUE_EMPTY;
+  }
+
+  _uvchan_wake_pushers(chan, *count);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_start_drain_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_start_drain_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  uvchan_error_t err;
+  void* buffer;
+  size_t count;
+  int woken;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  _uvchan_handle_disarm(ch_handle);
+  count = 0;
+
+  if (ch->flags & UVCHAN_FLAG_BYTES) {
+    err = UVCHAN_ERR_NOT_SUPPORTED;
+  } else if (_uvchan_handle_cancelled(ch_handle, &ch->pop_waiters, woken)) {
+    err = UVCHAN_ERR_CANCELLED;
+  } else if (!_uvchan_turn(ch, &ch->pop_waiters, woken)) {
+    err = UVCHAN_ERR_QUEUE_EMPTY;
+  } else {
+    err = _uvchan_drain(ch, &ch_handle->element, &ch_handle->length,
+                        &count);
+  }
+
+  if (err == UVCHAN_ERR_QUEUE_EMPTY && _UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    err = UVCHAN_ERR_CHANNEL_CLOSED;
+  } else if (err == UVCHAN_ERR_QUEUE_EMPTY &&
+             _uvchan_handle_aborted(ch_handle)) {
+    err = _uvchan_handle_abort_error(ch_handle);
+  }
+
+  uv_idle_stop(handle);
+
+  if (err == UVCHAN_ERR_QUEUE_EMPTY) {
+    _uvchan_handle_park(ch_handle, &ch->pop_waiters, woken);
+    return;
+  }
+
+  _uvchan_add(ch, &ch->polling, -1);
+  buffer = ch_handle->element;
+  ch_handle->element = 0L;
+  ch_handle->length = 0;
+
+  ((uvchan_batch_cb)(ch_handle->callback))(ch_handle, count ? buffer : 0L,
+                                           count, err);
+  if (buffer != 0L) {
+    _uvchan_free(buffer);
+  }
+  uvchan_unref(ch);
+}
+
+void uvchan_start_drain(uvchan_handle_t* handle, uvchan_batch_cb cb) {
+  handle->element = 0L;
+  handle->length = 0;
+  handle->callback = (void*)cb;
+  handle->waiter.idle_cb = _uvchan_start_drain_idle_cb;
+  uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
+
+  _uvchan_handle_arm(handle);
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_drain_idle_cb);
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_read_idle_cb(uv_idle_t* handle, int status) {
+#elif LIBUV_1X
+static void _uvchan_read_idle_cb(uv_idle_t* handle) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_handle_t* ch_handle;
+  uvchan_t* ch;
+  uvchan_error_t err;
+  int woken;
+  int delivered;
+  int drained;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  ch_handle = (uvchan_handle_t*)handle;
+  ch = ch_handle->ch;
+  woken = _uvchan_waiter_claim(&ch_handle->waiter);
+  delivered = 0;
+  drained = 0;
+  err = UVCHAN_ERR_SUCCESS;
+
+  if (ch->flags & UVCHAN_FLAG_BYTES) {
+    err = UVCHAN_ERR_NOT_SUPPORTED;
+  } else {
+    // keep delivering ready items until someone else waits for them
+    while (ch_handle->reading &&
+           (delivered ? _uvchan_waiter_idle(&ch->pop_waiters)
+                      : _uvchan_turn(ch, &ch->pop_waiters, woken))) {
+      if (_uvchan_try_pop(ch, ch_handle->element) != UVCHAN_ERR_SUCCESS) {
+        drained = 1;
+        break;
+      }
+
+      delivered = 1;
+      ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                             UVCHAN_ERR_SUCCESS);
+    }
+  }
+
+  if (!ch_handle->reading) {
+    // stopped from within callback
+    return;
+  }
+
+  uv_idle_stop(handle);
+
+  if (drained && _UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
+    err = UVCHAN_ERR_CHANNEL_CLOSED;
+  }
+
+  if (err != UVCHAN_ERR_SUCCESS) {
+    ch_handle->reading = 0;
+    _uvchan_add(ch, &ch->polling, -1);
+
+    ((uvchan_pop_cb)(ch_handle->callback))(ch_handle, ch_handle->element,
+                                           err);
+    uvchan_unref(ch);
+    return;
+  }
+
+  _uvchan_park(ch, handle->loop, &ch->pop_waiters, &ch_handle->waiter,
+               woken && !delivered);
+
+  // we yielded to other consumers while items are left, let the next
+  // one in line take over
+  if (delivered && !drained) {
+    _uvchan_wake(ch, &ch->pop_waiters);
+  }
+}
+
+void uvchan_read_start(uvchan_handle_t* handle, void* buffer,
+                       uvchan_pop_cb cb) {
+  assert(!handle->reading && "handle is already reading");
+
+  handle->element = buffer;
+  handle->callback = (void*)cb;
+  handle->reading = 1;
+  handle->waiter.idle_cb = _uvchan_read_idle_cb;
+  uvchan_ref(handle->ch);
+  _uvchan_add_poller(handle->ch);
+
+  uv_idle_start((uv_idle_t*)handle, _uvchan_read_idle_cb);
+}
+
+void uvchan_read_stop(uvchan_handle_t* handle) {
+  if (!handle->reading) {
+    return;
+  }
+
+  handle->reading = 0;
+  uv_idle_stop((uv_idle_t*)handle);
+  _uvchan_waiter_unpark(&handle->waiter);
+  _uvchan_add(handle->ch, &handle->ch->polling, -1);
+
+  uvchan_unref(handle->ch);
 }
 
 void _uvchan_default_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
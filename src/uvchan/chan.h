@@ -2,15 +2,144 @@
 #define UVCHAN_CHAN_H__
 
 #include <uv.h>
+#include <uvchan/arena.h>
+#include <uvchan/byte_queue.h>
+#include <uvchan/cancel.h>
+#include <uvchan/dealloc.h>
 #include <uvchan/error.h>
+#include <uvchan/mpmc_queue.h>
+#include <uvchan/pool.h>
 #include <uvchan/queue.h>
+#include <uvchan/segment_queue.h>
+#include <uvchan/shm_queue.h>
+#include <uvchan/wheel.h>
+
+/**
+ * @brief back channel by _uvchan_mpmc_queue instead of _uvchan_queue
+ *
+ * Such channels do not support #uvchan_start_reserve and
+ * #uvchan_start_peek.
+ */
+#define UVCHAN_FLAG_MPMC 0x01
+
+/**
+ * @brief back channel by an unbounded _uvchan_segment_queue
+ *
+ * Pushes to such channels never wait for room. Requested number of
+ * elements is used as segment size, zero selects a default size.
+ */
+#define UVCHAN_FLAG_UNBOUNDED 0x02
+
+/**
+ * @brief allocate channel's ring with #UVCHAN_QUEUE_MIRRORED
+ *
+ * Falls back to a regular ring where mirroring is not available.
+ */
+#define UVCHAN_FLAG_MIRRORED 0x04
+
+/**
+ * @brief back channel by a _uvchan_shm_queue shared with another process
+ *
+ * Other process attaches to the channel with #uvchan_open_shm, using
+ * file descriptors found in #_uvchan_t#shm_queue. Operations parked on
+ * such channels are woken by the other process through eventfds
+ * polled by the loop. Channel is always buffered, and only supports a
+ * single producer and a single consumer process. Such channels do not
+ * support #uvchan_start_reserve and #uvchan_start_peek.
+ */
+#define UVCHAN_FLAG_SHM 0x08
+
+/**
+ * @brief back channel by a _uvchan_byte_queue of variable length messages
+ *
+ * Set on channels created by #uvchan_new_bytes. Messages are exchanged
+ * with #uvchan_start_push_bytes, #uvchan_start_pop_bytes and
+ * #uvchan_start_peek_bytes, other operations fail with
+ * #UVCHAN_ERR_NOT_SUPPORTED.
+ */
+#define UVCHAN_FLAG_BYTES 0x10
+
+/**
+ * @brief share channel between loops running in different threads
+ *
+ * Reference count and state of channel are updated atomically and
+ * items go through a _uvchan_mpmc_queue, so this flag implies
+ * #UVCHAN_FLAG_MPMC and overrides other flags. Every loop has to be
+ * attached with #uvchan_attach before starting operations on channel
+ * from it. A loop whose operations wait on channel is woken by other
+ * threads through an async handle, sent at most once until that loop
+ * gets to run it.
+ */
+#define UVCHAN_FLAG_THREADSAFE 0x20
+
+/**
+ * @brief largest ring in bytes kept in the same allocation as channel
+ *
+ * Plain buffered channels whose ring fits are allocated with a single
+ * malloc, ring placed right after #_uvchan_t.
+ */
+#define kUvChanInlineRingSize 1024
+
+/**
+ * @brief number of elements a drain buffer starts with
+ *
+ * Buffer doubles while items keep coming.
+ */
+#define kUvChanDrainElements 256
+
+/**
+ * @brief a pending operation parked on a channel
+ *
+ * Operations which can not make progress are not polled on every
+ * loop iteration. Instead their idle handle is stopped and a waiter
+ * is linked into the channel, so that the loop is free to block while
+ * nothing is ready. Once the opposite side makes progress or the
+ * channel is closed, parked waiters are unlinked and their idle handle
+ * is restarted to retry the operation on the next iteration.
+ *
+ * Waiters are kept in arrival order. Every completion wakes only the
+ * oldest waiter of the opposite side, which holds its turn until it
+ * runs: new operations queue up behind it instead of overtaking, and a
+ * woken waiter that fails again goes back to the front of the line.
+ */
+typedef struct _uvchan_waiter_t {
+  struct _uvchan_waiter_t* next;  /**< @private */
+  struct _uvchan_waiter_t* prev;  /**< @private */
+  uv_idle_t* idle_handle;         /**< @private */
+  uv_idle_cb idle_cb;             /**< @private */
+  struct _uvchan_waiter_t* queue; /**< @private list it was woken from */
+  int woken; /**< @private waiters woken from this list, not yet run */
+} uvchan_waiter_t;
 
 typedef struct _uvchan_t {
-  uvchan_queue queue;
+  union {
+    uvchan_queue queue;
+    uvchan_mpmc_queue mpmc_queue;
+    uvchan_segment_queue segment_queue;
+    uvchan_shm_queue shm_queue;
+    uvchan_byte_queue byte_queue;
+  };
+  unsigned int flags;
   int closed;
   int polling;
   int poll_required;
   int reference_count;
+  int reserving;
+  int peeking;
+  uvchan_dealloc_cb dealloc;
+
+  uvchan_waiter_t push_waiters; /**< @private */
+  uvchan_waiter_t pop_waiters;  /**< @private */
+  uv_poll_t* _data_poll;        /**< @private */
+  uv_poll_t* _space_poll;       /**< @private */
+
+  uv_mutex_t _lock;                      /**< @private */
+  struct _uvchan_endpoint_t* _endpoints; /**< @private */
+  int _armed[2];                         /**< @private */
+
+  uvchan_pool_t* _pool;   /**< @private */
+  uvchan_arena_t* _arena; /**< @private */
+  size_t _block_size;     /**< @private */
 } uvchan_t;
 
 typedef struct _uvchan_handle_t {
@@ -18,23 +147,285 @@ typedef struct _uvchan_handle_t {
 
   uvchan_t* ch;
   void* element;
+  size_t length;
   void* callback;
   void* data;
+
+  uvchan_waiter_t waiter;      /**< @private */
+  int reading;                 /**< @private */
+  uvchan_deadline_t deadline;  /**< @private */
+  uvchan_cancel_link_t cancel; /**< @private */
 } uvchan_handle_t;
 
 typedef void (*uvchan_push_cb)(uvchan_handle_t* handle, uvchan_error_t err);
 typedef void (*uvchan_pop_cb)(uvchan_handle_t* handle, void* buffer,
                               uvchan_error_t err);
+typedef void (*uvchan_reserve_cb)(uvchan_handle_t* handle, void* slot,
+                                  uvchan_error_t err);
+typedef void (*uvchan_peek_cb)(uvchan_handle_t* handle, const void* slot,
+                               uvchan_error_t err);
+typedef void (*uvchan_bytes_cb)(uvchan_handle_t* handle, const void* data,
+                                size_t length, uvchan_error_t err);
+typedef void (*uvchan_batch_cb)(uvchan_handle_t* handle, void* buffer,
+                                size_t count, uvchan_error_t err);
 
+/**
+ * @brief create a channel of @p num_elements items of @p element_size
+ *
+ * @return new channel, or NULL if it could not be allocated.
+ */
 uvchan_t* uvchan_new(size_t num_elements, size_t element_size);
+
+/**
+ * @brief create a new channel
+ *
+ * Same as #uvchan_new, with behaviour of channel selected by @p flags.
+ *
+ * @return new channel, or NULL if channel or its ring could not be
+ * allocated, or if #UVCHAN_FLAG_SHM is requested but shared memory is
+ * not available.
+ */
+uvchan_t* uvchan_new_ex(size_t num_elements, size_t element_size,
+                        unsigned int flags);
+
+/**
+ * @brief create a channel of variable length messages
+ *
+ * Messages of any size up to #_uvchan_byte_queue#max_message_size are
+ * packed back to back into a ring of @p capacity_bytes bytes.
+ *
+ * @return new channel, or NULL if it could not be allocated.
+ *
+ * @see UVCHAN_FLAG_BYTES
+ */
+uvchan_t* uvchan_new_bytes(size_t capacity_bytes);
+
+/**
+ * @brief create a channel out of @p pool
+ *
+ * Same as #uvchan_new, except that channel and its ring are carved
+ * out of a single block of @p pool, which goes back to @p pool once
+ * channel is destroyed. Meant for short lived channels, like one
+ * channel per request. Channel has to be destroyed by thread owning
+ * @p pool.
+ *
+ * @return new channel, or NULL if @p pool could not provide a block.
+ */
+uvchan_t* uvchan_new_pooled(uvchan_pool_t* pool, size_t num_elements,
+                            size_t element_size);
+
+/**
+ * @brief create a channel out of @p arena
+ *
+ * Same as #uvchan_new_pooled, except that channel's memory is only
+ * released by #uvchan_arena_delete. Channel holds no other resources,
+ * so a graph of such channels may be dropped in one shot by deleting
+ * their arena, without unreferencing each of them, once no operation
+ * is pending on any of them. Items still in channels are not passed
+ * to #_uvchan_t#dealloc in that case.
+ *
+ * @return new channel, or NULL if @p arena could not grow.
+ */
+uvchan_t* uvchan_new_arena(uvchan_arena_t* arena, size_t num_elements,
+                           size_t element_size);
+
+/**
+ * @brief attach to a #UVCHAN_FLAG_SHM channel of another process
+ *
+ * @p mem_fd, @p data_fd and @p space_fd are the descriptors found in
+ * #_uvchan_t#shm_queue of the creating process, inherited through
+ * fork or received over a unix socket. Returned channel owns them.
+ * @p element_size is the item size channel was created with.
+ *
+ * @return new channel, or NULL if it could not be allocated, mapping
+ * fails or shared ring does not hold items of @p element_size.
+ */
+uvchan_t* uvchan_open_shm(int mem_fd, int data_fd, int space_fd,
+                          size_t element_size);
+
+/**
+ * @brief create a channel carrying owned pointers
+ *
+ * Each element is a single pointer, pushed and popped through a
+ * `void*` variable, so payloads move through the channel at the cost
+ * of copying one word. Ownership of the pointed buffer passes from
+ * producer to consumer. Items still in the channel when it is
+ * destroyed are passed to @p dealloc instead of being leaked.
+ * @p flags are the same as for #uvchan_new_ex.
+ *
+ * @return new channel, or NULL if #uvchan_new_ex fails.
+ */
+uvchan_t* uvchan_new_owned(size_t num_elements, unsigned int flags,
+                           uvchan_dealloc_cb dealloc);
 void uvchan_ref(uvchan_t* chan);
 void uvchan_unref(uvchan_t* chan);
 
 void uvchan_handle_init(uv_loop_t* loop, uvchan_handle_t* handle, uvchan_t* ch);
 
+/**
+ * @brief bound time operations of @p handle may wait
+ *
+ * Every operation started on @p handle afterwards which does not
+ * complete within @p timeout_ms completes with #UVCHAN_ERR_TIMEOUT
+ * instead. Deadlines are kept in @p wheel, which has to run on loop of
+ * handle, and fire up to one tick of wheel late. NULL @p wheel removes
+ * the bound. Does not apply to #uvchan_read_start.
+ */
+void uvchan_handle_set_deadline(uvchan_handle_t* handle, uvchan_wheel_t* wheel,
+                                uint64_t timeout_ms);
+
+/**
+ * @brief attach operations of @p handle to @p cancel
+ *
+ * Every operation started on @p handle afterwards completes with
+ * #UVCHAN_ERR_CANCELLED once @p cancel is cancelled, unless it completed
+ * before. An operation started on a token already cancelled completes
+ * with #UVCHAN_ERR_CANCELLED even if channel is ready. NULL @p cancel
+ * detaches handle. Does not apply to #uvchan_read_start.
+ */
+void uvchan_handle_set_cancel(uvchan_handle_t* handle, uvchan_cancel_t* cancel);
+
+/**
+ * @brief let @p loop operate on a #UVCHAN_FLAG_THREADSAFE channel
+ *
+ * Must be called from thread running @p loop. Attachment holds a
+ * reference to channel and keeps @p loop alive until
+ * #uvchan_detach. Does nothing for other channels.
+ *
+ * @return #UVCHAN_ERR_NO_MEMORY if attachment could not be allocated.
+ */
+uvchan_error_t uvchan_attach(uvchan_t* chan, uv_loop_t* loop);
+
+/**
+ * @brief undo #uvchan_attach
+ *
+ * Must be called from thread running @p loop, once no operation of
+ * @p loop is pending on channel.
+ */
+void uvchan_detach(uvchan_t* chan, uv_loop_t* loop);
+
+/**
+ * @brief close channel
+ *
+ * Every operation parked on channel is woken at once and completes on
+ * next loop iteration, pushes with #UVCHAN_ERR_CHANNEL_CLOSED and pops
+ * with remaining items first. Remaining items are best collected with
+ * a single #uvchan_start_drain.
+ */
 void uvchan_close(uvchan_t* chan);
 void uvchan_start_push(uvchan_handle_t* handle, const void* buffer,
                        uvchan_push_cb cb);
 void uvchan_start_pop(uvchan_handle_t* handle, void* buffer, uvchan_pop_cb cb);
 
+/**
+ * @brief wait for items and pop all ready ones, up to @p max_n
+ *
+ * @p buffer has room for @p max_n elements. Once at least one item is
+ * available, as many items as are ready are popped back to back into
+ * @p buffer, and @p cb receives their @p count in a single call. On a
+ * closed and drained channel @p cb receives zero items along with
+ * #UVCHAN_ERR_CHANNEL_CLOSED.
+ */
+void uvchan_start_pop_batch(uvchan_handle_t* handle, void* buffer,
+                            size_t max_n, uvchan_batch_cb cb);
+
+/**
+ * @brief wait for items and pop all ready ones, without a bound
+ *
+ * Same as #uvchan_start_pop_batch, except that items are popped into a
+ * buffer allocated by the library, only valid until @p cb returns.
+ * Items are copied out in bulk rather than one by one, so a drain
+ * started after #uvchan_close hands whole backlog to consumer in a
+ * single call. If buffer can not be allocated @p cb receives zero
+ * items along with #UVCHAN_ERR_NO_MEMORY.
+ */
+void uvchan_start_drain(uvchan_handle_t* handle, uvchan_batch_cb cb);
+
+/**
+ * @brief pop every item into @p buffer until channel closes
+ *
+ * Same as calling #uvchan_start_pop again from each callback, but the
+ * handle stays registered as a consumer and holds a single reference
+ * to channel for the whole stream. @p cb is called once for every
+ * item, and a last time with #UVCHAN_ERR_CHANNEL_CLOSED once channel
+ * is closed and drained, after which reading stops by itself.
+ */
+void uvchan_read_start(uvchan_handle_t* handle, void* buffer,
+                       uvchan_pop_cb cb);
+
+/**
+ * @brief stop reading started by #uvchan_read_start
+ *
+ * May be called from within the read callback. Does nothing if handle
+ * is not reading.
+ */
+void uvchan_read_stop(uvchan_handle_t* handle);
+
+/**
+ * @brief wait for a free slot and hand it out for in-place writing
+ *
+ * Once a slot is available @p cb receives a pointer into channel's
+ * ring. The caller serializes it's item directly into the slot and
+ * calls #uvchan_commit to publish it. Other producers on the channel
+ * wait until the slot is committed.
+ */
+void uvchan_start_reserve(uvchan_handle_t* handle, uvchan_reserve_cb cb);
+void uvchan_commit(uvchan_handle_t* handle);
+
+/**
+ * @brief wait for an item and hand it out for in-place reading
+ *
+ * Once an item is available @p cb receives a pointer to it inside
+ * channel's ring. The item stays in the channel until the caller
+ * calls #uvchan_release. Other consumers on the channel wait until
+ * the item is released.
+ */
+void uvchan_start_peek(uvchan_handle_t* handle, uvchan_peek_cb cb);
+void uvchan_release(uvchan_handle_t* handle);
+
+/**
+ * @brief copy a message of @p length bytes into a bytes channel
+ *
+ * @p cb receives #UVCHAN_ERR_MESSAGE_TOO_LARGE if message can never
+ * fit into channel.
+ */
+void uvchan_start_push_bytes(uvchan_handle_t* handle, const void* buffer,
+                             size_t length, uvchan_push_cb cb);
+
+/**
+ * @brief wait for a message and copy it into @p buffer
+ *
+ * Once a message is available @p cb receives @p buffer and length of
+ * message. If message is longer than @p capacity, @p cb receives
+ * #UVCHAN_ERR_MESSAGE_TOO_LARGE along with it's length, and message
+ * is left in channel.
+ */
+void uvchan_start_pop_bytes(uvchan_handle_t* handle, void* buffer,
+                            size_t capacity, uvchan_bytes_cb cb);
+
+/**
+ * @brief wait for a message and hand it out for in-place reading
+ *
+ * Same as #uvchan_start_peek, for channels created by
+ * #uvchan_new_bytes. Message stays in channel until the caller calls
+ * #uvchan_release.
+ */
+void uvchan_start_peek_bytes(uvchan_handle_t* handle, uvchan_bytes_cb cb);
+
+void _uvchan_waiter_init(uvchan_waiter_t* waiter, uv_idle_t* idle_handle,
+                         uv_idle_cb idle_cb);
+void _uvchan_waiter_park(uvchan_waiter_t* waiters, uvchan_waiter_t* waiter,
+                         int front);
+void _uvchan_waiter_unpark(uvchan_waiter_t* waiter);
+int _uvchan_waiter_claim(uvchan_waiter_t* waiter);
+int _uvchan_waiter_idle(uvchan_waiter_t* waiters);
+void _uvchan_waiter_wake_one(uvchan_waiter_t* waiters);
+void _uvchan_waiter_wake_all(uvchan_waiter_t* waiters);
+void _uvchan_park(uvchan_t* chan, uv_loop_t* loop, uvchan_waiter_t* waiters,
+                  uvchan_waiter_t* waiter, int front);
+void _uvchan_wake(uvchan_t* chan, uvchan_waiter_t* waiters);
+uvchan_error_t _uvchan_try_push(uvchan_t* chan, const void* element);
+uvchan_error_t _uvchan_try_pop(uvchan_t* chan, void* element);
+size_t _uvchan_element_size(uvchan_t* chan);
+
 #endif  // UVCHAN_CHAN_H__
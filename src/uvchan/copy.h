@@ -0,0 +1,45 @@
+#ifndef UVCHAN_COPY_H__
+#define UVCHAN_COPY_H__
+
+#include <string.h>
+
+// copies a single item. common small sizes are dispatched to memcpy
+// calls with a constant size, which compilers lower to plain loads and
+// stores instead of a call to generic memcpy. defining
+// UVCHAN_GENERIC_COPY disables this, which is only useful to measure
+// gain of specialized paths.
+#ifdef UVCHAN_GENERIC_COPY
+#define _UVCHAN_COPY_ELEMENT(dst, src, size) memcpy((dst), (src), (size))
+#else
+#define _UVCHAN_COPY_ELEMENT(dst, src, size) \
+  _uvchan_copy_element((dst), (src), (size))
+#endif
+
+static __inline__ void _uvchan_copy_element(void* dst, const void* src,
+                                            size_t size) {
+  switch (size) {
+    case 1:
+      memcpy(dst, src, 1);
+      break;
+    case 2:
+      memcpy(dst, src, 2);
+      break;
+    case 4:
+      memcpy(dst, src, 4);
+      break;
+    case 8:
+      memcpy(dst, src, 8);
+      break;
+    case 16:
+      memcpy(dst, src, 16);
+      break;
+    case 32:
+      memcpy(dst, src, 32);
+      break;
+    default:
+      memcpy(dst, src, size);
+      break;
+  }
+}
+
+#endif  // UVCHAN_COPY_H__
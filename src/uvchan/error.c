@@ -20,6 +20,20 @@ const char* uvchan_strerr(uvchan_error_t code) {
       return "requested tag was not found";
     case UVCHAN_ERR_SELECT_NORESULT:
       return "select structure has no result yet";
+    case UVCHAN_ERR_NOT_SUPPORTED:
+      return "operation is not supported by channel";
+    case UVCHAN_ERR_MESSAGE_TOO_LARGE:
+      return "message does not fit";
+    case UVCHAN_ERR_INVALID_ARGUMENT:
+      return "invalid argument";
+    case UVCHAN_ERR_TIMEOUT:
+      return "operation timed out";
+    case UVCHAN_ERR_CANCELLED:
+      return "operation was cancelled";
+    case UVCHAN_ERR_LAGGED:
+      return "subscriber fell too far behind";
+    case UVCHAN_ERR_NO_MEMORY:
+      return "out of memory";
     default:
       return "unknown";
   }
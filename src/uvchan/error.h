@@ -11,6 +11,13 @@ typedef enum _uvchan_error_t {
   UVCHAN_ERR_SELECT_EMPTY,
   UVCHAN_ERR_SELECT_TAG_NOTFOUND,
   UVCHAN_ERR_SELECT_NORESULT,
+  UVCHAN_ERR_NOT_SUPPORTED,
+  UVCHAN_ERR_MESSAGE_TOO_LARGE,
+  UVCHAN_ERR_INVALID_ARGUMENT,
+  UVCHAN_ERR_TIMEOUT,
+  UVCHAN_ERR_CANCELLED,
+  UVCHAN_ERR_LAGGED,
+  UVCHAN_ERR_NO_MEMORY,
   _UVCHAN_ERR_COUNT
 } uvchan_error_t;
 
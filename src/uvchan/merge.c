@@ -0,0 +1,225 @@
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
+#include <uvchan/merge.h>
+
+#include "./config.h"
+
+// batch of an input starts aligned, right after the input itself
+#define _UVCHAN_MERGE_BUFFER_OFFSET \
+  ((sizeof(uvchan_merge_input_t) + 15) & ~((size_t)15))
+
+typedef struct _uvchan_merge_input_t {
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t push_handle;
+  uvchan_merge_t* merge;
+  uvchan_t* input;
+  char* buffer;
+  size_t count;
+  size_t pushed;
+  int closing;
+} uvchan_merge_input_t;
+
+static void _uvchan_merge_push(uvchan_merge_input_t* input);
+
+void uvchan_merge_init(uv_loop_t* loop, uvchan_merge_t* merge,
+                       uvchan_t* output) {
+  merge->loop = loop;
+  merge->output = output;
+  merge->data = 0L;
+  merge->batch_size = kUvChanMergeBatchSize;
+  merge->close_output = 1;
+  merge->_done_cb = 0L;
+  merge->_pending = 0;
+  merge->_open = 0;
+  merge->_err = UVCHAN_ERR_SUCCESS;
+}
+
+// merge itself and every input not yet released keep it pending, and
+// the last one to go ends it
+static void _uvchan_merge_release(uvchan_merge_t* merge) {
+  if (--merge->_pending > 0) {
+    return;
+  }
+
+  if (merge->close_output) {
+    uvchan_close(merge->output);
+  }
+  uvchan_unref(merge->output);
+
+  merge->_done_cb(merge, merge->_err);
+}
+
+void uvchan_merge_close(uvchan_merge_t* merge) {
+  if (!merge->_open) {
+    return;
+  }
+
+  merge->_open = 0;
+  _uvchan_merge_release(merge);
+}
+
+static void _uvchan_merge_close_cb(uv_handle_t* handle) {
+  uvchan_merge_input_t* input;
+  uvchan_merge_t* merge;
+
+  input = (uvchan_merge_input_t*)((uvchan_handle_t*)handle)->data;
+  if (--input->closing > 0) {
+    return;
+  }
+
+  merge = input->merge;
+  uvchan_unref(input->input);
+  _uvchan_free(input);
+
+  _uvchan_merge_release(merge);
+}
+
+// an input is dropped once its channel is drained or anything failed,
+// the first failure stops every other input and merge along with them
+static void _uvchan_merge_drop(uvchan_merge_input_t* input,
+                               uvchan_error_t err) {
+  uvchan_merge_t* merge;
+
+  merge = input->merge;
+  if (err != UVCHAN_ERR_SUCCESS && merge->_err == UVCHAN_ERR_SUCCESS) {
+    merge->_err = err;
+    uvchan_cancel(&merge->_cancel);
+    uvchan_merge_close(merge);
+  }
+
+  input->closing = 2;
+  uv_close((uv_handle_t*)&input->pop_handle, _uvchan_merge_close_cb);
+  uv_close((uv_handle_t*)&input->push_handle, _uvchan_merge_close_cb);
+}
+
+static void _uvchan_merge_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                 size_t count, uvchan_error_t err) {
+  uvchan_merge_input_t* input;
+
+  input = (uvchan_merge_input_t*)handle->data;
+
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED || err == UVCHAN_ERR_CANCELLED) {
+    _uvchan_merge_drop(input, UVCHAN_ERR_SUCCESS);
+    return;
+  } else if (err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_merge_drop(input, err);
+    return;
+  }
+
+  input->count = count;
+  input->pushed = 0;
+  _uvchan_merge_push(input);
+}
+
+static void _uvchan_merge_push_cb(uvchan_handle_t* handle,
+                                  uvchan_error_t err) {
+  uvchan_merge_input_t* input;
+
+  input = (uvchan_merge_input_t*)handle->data;
+
+  if (err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_merge_drop(input, err);
+    return;
+  }
+
+  input->pushed++;
+  _uvchan_merge_push(input);
+}
+
+static void _uvchan_merge_pop(uvchan_merge_input_t* input) {
+  if (input->merge->_err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_merge_drop(input, UVCHAN_ERR_SUCCESS);
+    return;
+  }
+
+  uvchan_start_pop_batch(&input->pop_handle, input->buffer,
+                         input->merge->batch_size, _uvchan_merge_pop_cb);
+}
+
+// items go straight into output channel while it has room and nobody
+// is queued before us, only the rest waits as a regular push
+static void _uvchan_merge_push(uvchan_merge_input_t* input) {
+  uvchan_t* output;
+  size_t size;
+  void* element;
+
+  output = input->merge->output;
+  size = _uvchan_element_size(output);
+
+  while (input->pushed < input->count) {
+    element = input->buffer + input->pushed * size;
+
+    if (_UVCHAN_LOAD_ACQUIRE(&output->closed)) {
+      _uvchan_merge_drop(input, UVCHAN_ERR_CHANNEL_CLOSED);
+      return;
+    } else if (!_uvchan_waiter_idle(&output->push_waiters) ||
+               _uvchan_try_push(output, element) != UVCHAN_ERR_SUCCESS) {
+      uvchan_start_push(&input->push_handle, element, _uvchan_merge_push_cb);
+      return;
+    }
+
+    input->pushed++;
+  }
+
+  _uvchan_merge_pop(input);
+}
+
+uvchan_error_t uvchan_merge_start(uvchan_merge_t* merge, uvchan_merge_cb cb) {
+  if (merge->batch_size < 1) {
+    return UVCHAN_ERR_INVALID_ARGUMENT;
+  } else if (merge->output->flags & UVCHAN_FLAG_BYTES) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  merge->_done_cb = cb;
+  merge->_pending = 1;
+  merge->_open = 1;
+  merge->_err = UVCHAN_ERR_SUCCESS;
+  uvchan_cancel_init(&merge->_cancel);
+  uvchan_ref(merge->output);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_merge_add(uvchan_merge_t* merge, uvchan_t* chan) {
+  uvchan_merge_input_t* input;
+  size_t size;
+
+  if (!merge->_open) {
+    return UVCHAN_ERR_CHANNEL_CLOSED;
+  } else if (chan->flags & UVCHAN_FLAG_BYTES) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  size = _uvchan_element_size(merge->output);
+  if (_uvchan_element_size(chan) != size) {
+    return UVCHAN_ERR_INVALID_ARGUMENT;
+  }
+
+  // input and its batch share a single allocation
+  input = (uvchan_merge_input_t*)_uvchan_malloc(_UVCHAN_MERGE_BUFFER_OFFSET +
+                                                merge->batch_size * size);
+  if (input == 0L) {
+    return UVCHAN_ERR_NO_MEMORY;
+  }
+
+  input->merge = merge;
+  input->input = chan;
+  input->buffer = (char*)input + _UVCHAN_MERGE_BUFFER_OFFSET;
+  input->count = 0;
+  input->pushed = 0;
+  input->closing = 0;
+  uvchan_ref(chan);
+  merge->_pending++;
+
+  uvchan_handle_init(merge->loop, &input->pop_handle, chan);
+  uvchan_handle_init(merge->loop, &input->push_handle, merge->output);
+  input->pop_handle.data = input;
+  input->push_handle.data = input;
+  uvchan_handle_set_cancel(&input->pop_handle, &merge->_cancel);
+  uvchan_handle_set_cancel(&input->push_handle, &merge->_cancel);
+
+  _uvchan_merge_pop(input);
+
+  return UVCHAN_ERR_SUCCESS;
+}
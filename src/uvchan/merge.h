@@ -0,0 +1,111 @@
+#ifndef UVCHAN_MERGE_H__
+#define UVCHAN_MERGE_H__
+
+#include <uv.h>
+#include <uvchan/cancel.h>
+#include <uvchan/chan.h>
+
+/**
+ * @brief number of items an input forwards per turn by default
+ */
+#define kUvChanMergeBatchSize 32
+
+struct _uvchan_merge_t;
+
+typedef void (*uvchan_merge_cb)(struct _uvchan_merge_t* merge,
+                                uvchan_error_t err);
+
+/**
+ * @brief Models a fan-in of any number of channels into one
+ *
+ * uvchan_merge_t forwards items of every input channel added with
+ * #uvchan_merge_add into a single output channel. Each input pops up
+ * to _uvchan_merge_t#batch_size ready items at once and pushes them to
+ * output before popping again, so a busy input does not starve the
+ * others.
+ *
+ * Unlike #uvchan_select_handle_t, a merge is not limited in number of
+ * channels and never scans them. An input with nothing to forward
+ * stays parked on its channel until an item arrives, so cost of a
+ * merge follows number of inputs which are ready, not number of
+ * inputs.
+ *
+ * An input is dropped once its channel is closed and drained. Merge
+ * ends once #uvchan_merge_close was called and every input was
+ * dropped, or once output channel is found closed when pushing.
+ * Output channel is then closed if _uvchan_merge_t#close_output is
+ * set, and the callback given to #uvchan_merge_start is called once
+ * merge releases its resources.
+ *
+ * @code{.c}
+ * uvchan_merge_t merge;
+ *
+ * uvchan_merge_init(loop, &merge, output);
+ * uvchan_merge_start(&merge, on_merge_done);
+ * uvchan_merge_add(&merge, connection_chan);
+ * @endcode
+ *
+ * @see uvchan_merge_init
+ * @see uvchan_merge_start
+ * @see uvchan_merge_add
+ * @see uvchan_merge_close
+ */
+typedef struct _uvchan_merge_t {
+  uv_loop_t* loop;
+  uvchan_t* output;
+  void* data;
+
+  size_t batch_size; /**< number of items an input pops per turn */
+  int close_output;  /**< close output channel once merge ends */
+
+  uvchan_merge_cb _done_cb; /**< @private */
+  size_t _pending;          /**< @private */
+  int _open;                /**< @private */
+  uvchan_error_t _err;      /**< @private */
+  uvchan_cancel_t _cancel;  /**< @private */
+} uvchan_merge_t;
+
+/**
+ * @brief initialize a merge into @p output
+ *
+ * Merge uses #kUvChanMergeBatchSize, and closes @p output once it
+ * ends, unless changed before #uvchan_merge_start.
+ */
+void uvchan_merge_init(uv_loop_t* loop, uvchan_merge_t* merge,
+                       uvchan_t* output);
+
+/**
+ * @brief start accepting inputs
+ *
+ * Merge holds a reference to output channel until @p cb is called.
+ * @p cb receives #UVCHAN_ERR_SUCCESS once merge was closed and every
+ * input was drained, or the error which stopped merge, like
+ * #UVCHAN_ERR_CHANNEL_CLOSED when output channel was closed first.
+ *
+ * @return #UVCHAN_ERR_INVALID_ARGUMENT if batch size is zero,
+ * #UVCHAN_ERR_NOT_SUPPORTED if output is a bytes channel.
+ */
+uvchan_error_t uvchan_merge_start(uvchan_merge_t* merge, uvchan_merge_cb cb);
+
+/**
+ * @brief forward items of @p chan into output of @p merge
+ *
+ * Merge holds a reference to @p chan until it is closed and drained.
+ *
+ * @return #UVCHAN_ERR_INVALID_ARGUMENT if items of @p chan differ in
+ * size from items of output, #UVCHAN_ERR_NOT_SUPPORTED if @p chan is a
+ * bytes channel, #UVCHAN_ERR_CHANNEL_CLOSED if merge was closed or
+ * stopped, #UVCHAN_ERR_NO_MEMORY if input buffer could not be
+ * allocated.
+ */
+uvchan_error_t uvchan_merge_add(uvchan_merge_t* merge, uvchan_t* chan);
+
+/**
+ * @brief stop accepting inputs
+ *
+ * Inputs added before are still forwarded until they are closed and
+ * drained, after which merge ends.
+ */
+void uvchan_merge_close(uvchan_merge_t* merge);
+
+#endif  // UVCHAN_MERGE_H__
@@ -0,0 +1,151 @@
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
+#include <uvchan/copy.h>
+#include <uvchan/mpmc_queue.h>
+
+#include <assert.h>
+#include <string.h>
+
+#define SLOT_LOCATION(queue, index)                                      \
+  (((char*)(queue)->_buffer) +                                           \
+   (((index) & (queue)->_mask) * (queue)->_slot_size))
+#define SLOT_SEQUENCE(slot) ((size_t*)(slot))
+#define SLOT_ELEMENT(slot) (((char*)(slot)) + sizeof(size_t))
+
+void uvchan_mpmc_queue_init(uvchan_mpmc_queue* queue, size_t num_elements,
+                            size_t element_size) {
+  size_t capacity;
+  size_t i;
+
+  if (num_elements < 1) {
+    num_elements = 1;
+  }
+
+  // ring is a power of two for indexing, bound is enforced separately
+  capacity = 2;
+  while (capacity < num_elements) {
+    capacity <<= 1;
+  }
+
+  queue->element_size = element_size;
+  queue->capacity_elements = num_elements;
+  queue->_mask = capacity - 1;
+
+  // keep sequence numbers of every slot aligned
+  queue->_slot_size = (sizeof(size_t) + element_size + sizeof(size_t) - 1) /
+                      sizeof(size_t) * sizeof(size_t);
+  queue->_buffer = _uvchan_malloc(capacity * queue->_slot_size);
+  if (queue->_buffer == 0L) {
+    return;
+  }
+
+  for (i = 0; i < capacity; i++) {
+    *SLOT_SEQUENCE(SLOT_LOCATION(queue, i)) = i;
+  }
+
+  queue->_enqueue_pos = 0;
+  queue->_dequeue_pos = 0;
+}
+
+void uvchan_mpmc_queue_destroy(uvchan_mpmc_queue* queue) {
+  assert(_UVCHAN_LOAD_ACQUIRE(&queue->_enqueue_pos) ==
+         _UVCHAN_LOAD_ACQUIRE(&queue->_dequeue_pos));
+  _uvchan_free(queue->_buffer);
+  queue->_buffer = 0L;
+}
+
+uvchan_error_t uvchan_mpmc_queue_push(uvchan_mpmc_queue* queue,
+                                      const void* element) {
+  char* slot;
+  size_t pos;
+  size_t seq;
+  long diff;
+
+  pos = _UVCHAN_LOAD_RELAXED(&queue->_enqueue_pos);
+
+  for (;;) {
+    // dequeue position only moves forward, so a stale one can only
+    // underestimate room and never lets queue grow past its bound. a
+    // stale pos behind it is caught by compare and swap below.
+    if ((long)(pos - _UVCHAN_LOAD_ACQUIRE(&queue->_dequeue_pos)) >=
+        (long)queue->capacity_elements) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+
+    slot = SLOT_LOCATION(queue, pos);
+    seq = _UVCHAN_LOAD_ACQUIRE(SLOT_SEQUENCE(slot));
+    diff = (long)seq - (long)pos;
+
+    if (diff == 0) {
+      if (_UVCHAN_CAS_WEAK(&queue->_enqueue_pos, &pos, pos + 1)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    } else {
+      pos = _UVCHAN_LOAD_RELAXED(&queue->_enqueue_pos);
+    }
+  }
+
+  _UVCHAN_COPY_ELEMENT(SLOT_ELEMENT(slot), element, queue->element_size);
+  _UVCHAN_STORE_RELEASE(SLOT_SEQUENCE(slot), pos + 1);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_mpmc_queue_pop(uvchan_mpmc_queue* queue,
+                                     void* element) {
+  char* slot;
+  size_t pos;
+  size_t seq;
+  long diff;
+
+  pos = _UVCHAN_LOAD_RELAXED(&queue->_dequeue_pos);
+
+  for (;;) {
+    slot = SLOT_LOCATION(queue, pos);
+    seq = _UVCHAN_LOAD_ACQUIRE(SLOT_SEQUENCE(slot));
+    diff = (long)seq - (long)(pos + 1);
+
+    if (diff == 0) {
+      if (_UVCHAN_CAS_WEAK(&queue->_dequeue_pos, &pos, pos + 1)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    } else {
+      pos = _UVCHAN_LOAD_RELAXED(&queue->_dequeue_pos);
+    }
+  }
+
+  _UVCHAN_COPY_ELEMENT(element, SLOT_ELEMENT(slot), queue->element_size);
+  _UVCHAN_STORE_RELEASE(SLOT_SEQUENCE(slot), pos + queue->_mask + 1);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+// tell whether a push (pop) could have succeeded at time of the call.
+// used to recheck a queue after announcing intent to wait on it.
+int _uvchan_mpmc_queue_can_push(uvchan_mpmc_queue* queue) {
+  size_t pos;
+  size_t seq;
+
+  pos = _UVCHAN_LOAD_RELAXED(&queue->_enqueue_pos);
+  if ((long)(pos - _UVCHAN_LOAD_ACQUIRE(&queue->_dequeue_pos)) >=
+      (long)queue->capacity_elements) {
+    return 0;
+  }
+  seq = _UVCHAN_LOAD_ACQUIRE(SLOT_SEQUENCE(SLOT_LOCATION(queue, pos)));
+
+  return (long)seq - (long)pos >= 0;
+}
+
+int _uvchan_mpmc_queue_can_pop(uvchan_mpmc_queue* queue) {
+  size_t pos;
+  size_t seq;
+
+  pos = _UVCHAN_LOAD_RELAXED(&queue->_dequeue_pos);
+  seq = _UVCHAN_LOAD_ACQUIRE(SLOT_SEQUENCE(SLOT_LOCATION(queue, pos)));
+
+  return (long)seq - (long)(pos + 1) >= 0;
+}
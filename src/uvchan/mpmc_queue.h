@@ -0,0 +1,110 @@
+#ifndef UVCHAN_MPMC_QUEUE_H__
+#define UVCHAN_MPMC_QUEUE_H__
+
+#include <stdlib.h>
+#include <uvchan/error.h>
+#include <uvchan/queue.h>
+
+/**
+ * @brief Models a bounded FIFO queue for many producers and consumers
+ *
+ * uvchan_mpmc_queue is a sibling of _uvchan_queue which may be used
+ * concurrently by any number of producer and consumer threads without
+ * a lock. Every slot carries a sequence number which tells whether it
+ * is ready to be written or read for a given lap around the ring.
+ * Producers and consumers claim positions with a single compare and
+ * swap on their own cache line, so threads on the same side contend
+ * only on that position and never on a global lock.
+ *
+ * As with _uvchan_queue, items are deep copied using memcpy.
+ *
+ * @code{.c}
+ * uvchan_mpmc_queue q;
+ * int value;
+ *
+ * uvchan_mpmc_queue_init(&q, 16, sizeof(int));
+ *
+ * value = 5;
+ * uvchan_mpmc_queue_push(&q, &value);
+ *
+ * uvchan_mpmc_queue_pop(&q, &value);
+ *
+ * uvchan_mpmc_queue_destroy(&q);
+ * @endcode
+ *
+ * @see uvchan_mpmc_queue_init
+ * @see uvchan_mpmc_queue_push
+ * @see uvchan_mpmc_queue_pop
+ * @see uvchan_mpmc_queue_destroy
+ */
+typedef struct _uvchan_mpmc_queue {
+  void* _buffer;            /**< @private */
+  size_t element_size;      /**< size of each item in queue in bytes */
+  size_t capacity_elements; /**< capacity of queue */
+  size_t _mask;             /**< @private */
+  size_t _slot_size;        /**< @private */
+  char _pad0[kUvChanCacheLineSize - sizeof(void*) -
+             4 * sizeof(size_t)]; /**< @private */
+
+  size_t _enqueue_pos;                               /**< @private */
+  char _pad1[kUvChanCacheLineSize - sizeof(size_t)]; /**< @private */
+
+  size_t _dequeue_pos;                               /**< @private */
+  char _pad2[kUvChanCacheLineSize - sizeof(size_t)]; /**< @private */
+} uvchan_mpmc_queue;
+
+/**
+ * @brief initialize a new multi producer multi consumer queue
+ *
+ * This function initializes a new queue, same as #uvchan_queue_init.
+ * Queue holds up to @p num_elements items, at least one, in a ring
+ * whose size is rounded up to a power of two of at least two slots.
+ * Capacity is available as #_uvchan_mpmc_queue#capacity_elements.
+ *
+ * @param queue location of _uvchan_mpmc_queue instance to initialize.
+ * @param num_elements shows capacity of queue.
+ * @param element_size shows size of each item in bytes.
+ *
+ * @see uvchan_mpmc_queue_destroy
+ */
+void uvchan_mpmc_queue_init(uvchan_mpmc_queue* queue, size_t num_elements,
+                            size_t element_size);
+
+/**
+ * @brief destroy resources allocated to queue
+ *
+ * @warning same as #uvchan_queue_destroy, queue is asserted to be empty.
+ *
+ * @see uvchan_mpmc_queue_init
+ */
+void uvchan_mpmc_queue_destroy(uvchan_mpmc_queue* queue);
+
+/**
+ * @brief push a new item to back of queue
+ *
+ * Safe to be called concurrently from any number of threads.
+ *
+ * @return zero if operation succeeds. non-zero if error occurs.
+ *
+ * @see UVCHAN_ERR_SUCCESS
+ * @see UVCHAN_ERR_QUEUE_FULL
+ */
+uvchan_error_t uvchan_mpmc_queue_push(uvchan_mpmc_queue* queue,
+                                      const void* buffer);
+
+/**
+ * @brief pop an item from front of queue
+ *
+ * Safe to be called concurrently from any number of threads.
+ *
+ * @return zero if operation succeeds. non-zero if error occurs.
+ *
+ * @see UVCHAN_ERR_SUCCESS
+ * @see UVCHAN_ERR_QUEUE_EMPTY
+ */
+uvchan_error_t uvchan_mpmc_queue_pop(uvchan_mpmc_queue* queue, void* buffer);
+
+int _uvchan_mpmc_queue_can_push(uvchan_mpmc_queue* queue);
+int _uvchan_mpmc_queue_can_pop(uvchan_mpmc_queue* queue);
+
+#endif  // UVCHAN_MPMC_QUEUE_H__
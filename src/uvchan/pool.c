@@ -0,0 +1,140 @@
+#include <uvchan/alloc.h>
+#include <uvchan/pool.h>
+
+#include <assert.h>
+
+// slab header is padded so that blocks keep malloc's alignment
+#define kUvChanPoolSlabHeaderSize 64
+
+typedef struct _uvchan_pool_slab {
+  struct _uvchan_pool_slab* next;
+} uvchan_pool_slab;
+
+typedef struct _uvchan_pool_block {
+  struct _uvchan_pool_block* next;
+} uvchan_pool_block;
+
+static int _uvchan_pool_class(size_t size, size_t* block_size) {
+  int index;
+
+  *block_size = kUvChanPoolMinBlockSize;
+  for (index = 0; index < kUvChanPoolClasses; index++) {
+    if (size <= *block_size) {
+      return index;
+    }
+    *block_size <<= 1;
+  }
+
+  return -1;
+}
+
+static void _uvchan_pool_release(uvchan_pool_t* pool) {
+  uvchan_pool_slab* slab;
+
+  while (pool->_slabs) {
+    slab = (uvchan_pool_slab*)pool->_slabs;
+    pool->_slabs = slab->next;
+    _uvchan_free(slab);
+  }
+
+  _uvchan_free(pool);
+}
+
+// carves a new slab into blocks of class @p index
+static int _uvchan_pool_grow(uvchan_pool_t* pool, int index,
+                             size_t block_size) {
+  uvchan_pool_slab* slab;
+  uvchan_pool_block* block;
+  size_t count;
+  size_t i;
+
+  count = kUvChanPoolSlabSize / block_size;
+  if (count < 1) {
+    count = 1;
+  }
+
+  slab = (uvchan_pool_slab*)_uvchan_malloc(kUvChanPoolSlabHeaderSize +
+                                           count * block_size);
+  if (!slab) {
+    return 0;
+  }
+
+  slab->next = (uvchan_pool_slab*)pool->_slabs;
+  pool->_slabs = slab;
+
+  for (i = 0; i < count; i++) {
+    block = (uvchan_pool_block*)((char*)slab + kUvChanPoolSlabHeaderSize +
+                                 i * block_size);
+    block->next = (uvchan_pool_block*)pool->_free[index];
+    pool->_free[index] = block;
+  }
+
+  return 1;
+}
+
+uvchan_pool_t* uvchan_pool_new(void) {
+  uvchan_pool_t* pool;
+  int i;
+
+  pool = (uvchan_pool_t*)_uvchan_malloc(sizeof(uvchan_pool_t));
+  for (i = 0; i < kUvChanPoolClasses; i++) {
+    pool->_free[i] = 0L;
+  }
+  pool->_slabs = 0L;
+  pool->outstanding = 0;
+  pool->_deleted = 0;
+
+  return pool;
+}
+
+void uvchan_pool_delete(uvchan_pool_t* pool) {
+  assert(!pool->_deleted);
+
+  pool->_deleted = 1;
+  if (pool->outstanding == 0) {
+    _uvchan_pool_release(pool);
+  }
+}
+
+void* uvchan_pool_alloc(uvchan_pool_t* pool, size_t size) {
+  uvchan_pool_block* block;
+  size_t block_size;
+  int index;
+
+  index = _uvchan_pool_class(size, &block_size);
+  if (index < 0) {
+    block = (uvchan_pool_block*)_uvchan_malloc(size);
+  } else if (pool->_free[index] ||
+             _uvchan_pool_grow(pool, index, block_size)) {
+    block = (uvchan_pool_block*)pool->_free[index];
+    pool->_free[index] = block->next;
+  } else {
+    block = 0L;
+  }
+
+  if (block) {
+    pool->outstanding++;
+  }
+
+  return block;
+}
+
+void uvchan_pool_free(uvchan_pool_t* pool, void* block, size_t size) {
+  uvchan_pool_block* free_block;
+  size_t block_size;
+  int index;
+
+  index = _uvchan_pool_class(size, &block_size);
+  if (index < 0) {
+    _uvchan_free(block);
+  } else {
+    free_block = (uvchan_pool_block*)block;
+    free_block->next = (uvchan_pool_block*)pool->_free[index];
+    pool->_free[index] = free_block;
+  }
+
+  pool->outstanding--;
+  if (pool->_deleted && pool->outstanding == 0) {
+    _uvchan_pool_release(pool);
+  }
+}
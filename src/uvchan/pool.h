@@ -0,0 +1,74 @@
+#ifndef UVCHAN_POOL_H__
+#define UVCHAN_POOL_H__
+
+#include <stdlib.h>
+
+/**
+ * @brief number of size classes served by a _uvchan_pool_t
+ *
+ * Classes are powers of two from #kUvChanPoolMinBlockSize up, larger
+ * requests fall through to #uvchan_replace_allocator functions.
+ */
+#define kUvChanPoolClasses 6
+
+/**
+ * @brief smallest block handed out by a _uvchan_pool_t, in bytes
+ */
+#define kUvChanPoolMinBlockSize 256
+
+/**
+ * @brief bytes carved into blocks of a size class at once
+ *
+ * A class whose blocks are larger than this gets one block per slab.
+ */
+#define kUvChanPoolSlabSize (16 * 1024)
+
+/**
+ * @brief Models a slab pool of fixed size blocks
+ *
+ * uvchan_pool_t serves short lived objects, like channels created and
+ * destroyed per request, without going through malloc for each of
+ * them. Requests are rounded up to a size class, and each class keeps
+ * a free list of blocks carved out of slabs of #kUvChanPoolSlabSize
+ * bytes. Freed blocks go back to their free list, slabs are only
+ * released once pool is deleted and all of its blocks are freed.
+ *
+ * A pool is not threadsafe. It is meant to be owned by a single loop,
+ * with every block allocated and freed by thread running that loop,
+ * so that loops of different threads never contend on a pool.
+ *
+ * @see uvchan_pool_new
+ * @see uvchan_pool_alloc
+ * @see uvchan_pool_free
+ * @see uvchan_pool_delete
+ */
+typedef struct _uvchan_pool_t {
+  void* _free[kUvChanPoolClasses]; /**< @private */
+  void* _slabs;                    /**< @private */
+  size_t outstanding;              /**< number of blocks not freed yet */
+  int _deleted;                    /**< @private */
+} uvchan_pool_t;
+
+uvchan_pool_t* uvchan_pool_new(void);
+
+/**
+ * @brief release a pool
+ *
+ * Slabs of pool are released once every block allocated from it is
+ * freed, so objects still holding blocks may outlive this call.
+ */
+void uvchan_pool_delete(uvchan_pool_t* pool);
+
+/**
+ * @brief allocate a block of at least @p size bytes
+ *
+ * Blocks are at least as aligned as memory returned by malloc.
+ */
+void* uvchan_pool_alloc(uvchan_pool_t* pool, size_t size);
+
+/**
+ * @brief give back a block allocated with same @p size
+ */
+void uvchan_pool_free(uvchan_pool_t* pool, void* block, size_t size);
+
+#endif  // UVCHAN_POOL_H__
@@ -1,52 +1,430 @@
+#define _GNU_SOURCE
+
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
+#include <uvchan/copy.h>
 #include <uvchan/queue.h>
 
 #include <assert.h>
 #include <string.h>
 
-#define MEM_LOCATION(buffer, index, element_size) \
-  (((char*)(buffer)) + ((index) * (element_size)))
-#define INCREMENT(index, capacity_elements) \
-  (((index) + 1) % (capacity_elements))
+#include "./config.h"
 
-void uvchan_queue_init(uvchan_queue* queue, size_t num_elements,
-                       size_t element_size) {
-  queue->_buffer = malloc((num_elements + 1) * element_size);
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#include <unistd.h>
+#define UVCHAN_HAVE_MIRRORED_RING 1
+#endif
+
+#define MEM_LOCATION(queue, index)                       \
+  (((char*)(queue)->_buffer) +                           \
+   (((index) & (queue)->_mask) * (queue)->element_size))
+
+static size_t _uvchan_queue_round_capacity(size_t num_elements) {
+  size_t result;
+
+  result = 1;
+  while (result < num_elements) {
+    result <<= 1;
+  }
+
+  return result;
+}
+
+static void _uvchan_queue_init_positions(uvchan_queue* queue,
+                                         size_t num_elements,
+                                         size_t element_size, size_t slots) {
   queue->element_size = element_size;
+  queue->capacity_elements = num_elements;
+  queue->_mask = slots - 1;
+  queue->_head = 0;
+  queue->_cached_tail = 0;
   queue->_tail = 0;
-  queue->capacity_elements = num_elements + 1;
-  queue->_head = INCREMENT(0, queue->capacity_elements);
+  queue->_cached_head = 0;
+}
+
+void uvchan_queue_init(uvchan_queue* queue, size_t num_elements,
+                       size_t element_size) {
+  size_t slots;
+
+  slots = _uvchan_queue_round_capacity(num_elements);
+
+  queue->_buffer = _uvchan_malloc(slots * element_size);
+  queue->_mapped_size = 0;
+  queue->_borrowed = 0;
+  _uvchan_queue_init_positions(queue, num_elements, element_size, slots);
+}
+
+size_t uvchan_queue_buffer_size(size_t num_elements, size_t element_size) {
+  return _uvchan_queue_round_capacity(num_elements) * element_size;
+}
+
+void uvchan_queue_init_buffer(uvchan_queue* queue, size_t num_elements,
+                              size_t element_size, void* buffer) {
+  queue->_buffer = buffer;
+  queue->_mapped_size = 0;
+  queue->_borrowed = 1;
+  _uvchan_queue_init_positions(queue, num_elements, element_size,
+                               _uvchan_queue_round_capacity(num_elements));
+}
+
+#ifdef UVCHAN_HAVE_MIRRORED_RING
+static void* _uvchan_queue_map_mirrored(size_t size, unsigned int flags) {
+  unsigned int memfd_flags;
+  size_t alignment;
+  size_t reserved;
+  char* region;
+  char* base;
+  int fd;
+
+  memfd_flags = MFD_CLOEXEC;
+  alignment = 0;
+  if (flags & UVCHAN_QUEUE_HUGE_PAGES) {
+#ifdef MFD_HUGETLB
+    memfd_flags |= MFD_HUGETLB;
+    alignment = kUvChanHugePageSize;
+#else
+    return 0L;
+#endif
+  }
+
+  fd = memfd_create("uvchan_queue", memfd_flags);
+  if (fd < 0) {
+    return 0L;
+  }
+
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    return 0L;
+  }
+
+  // reserve address space for both views, then map file over it twice.
+  // views of huge pages have to start on a huge page, so reservation
+  // gets room to slide base up to one, and slack is given back.
+  reserved = 2 * size + alignment;
+  region = (char*)mmap(0L, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+  if (region == MAP_FAILED) {
+    close(fd);
+    return 0L;
+  }
+
+  base = region;
+  if (alignment > 0) {
+    base = (char*)(((size_t)region + alignment - 1) & ~(alignment - 1));
+    if (base > region) {
+      munmap(region, base - region);
+    }
+    if (region + reserved > base + 2 * size) {
+      munmap(base + 2 * size, region + reserved - (base + 2 * size));
+    }
+  }
+
+  if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd,
+           0) == MAP_FAILED ||
+      mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+           fd, 0) == MAP_FAILED) {
+    munmap(base, 2 * size);
+    close(fd);
+    return 0L;
+  }
+
+  close(fd);
+
+  return base;
+}
+#endif
+
+uvchan_error_t uvchan_queue_init_ex(uvchan_queue* queue, size_t num_elements,
+                                    size_t element_size, unsigned int flags) {
+#ifdef UVCHAN_HAVE_MIRRORED_RING
+  size_t slots;
+  size_t page_size;
+  size_t page_slots;
+  void* buffer;
+#endif
+
+  if (!(flags & UVCHAN_QUEUE_MIRRORED)) {
+    uvchan_queue_init(queue, num_elements, element_size);
+    return UVCHAN_ERR_SUCCESS;
+  }
+
+#ifdef UVCHAN_HAVE_MIRRORED_RING
+  if (element_size < 1) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  if (flags & UVCHAN_QUEUE_HUGE_PAGES) {
+    page_size = kUvChanHugePageSize;
+  } else {
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+  }
+
+  // ring has to span whole pages for second view to line up. since
+  // page size is a power of two, smallest such number of slots is
+  // page size divided by largest power of two dividing element size.
+  page_slots = page_size / (element_size & (~element_size + 1));
+  if (page_slots < 1) {
+    page_slots = 1;
+  }
+
+  slots = _uvchan_queue_round_capacity(num_elements);
+  if (slots < page_slots) {
+    slots = page_slots;
+  }
+
+  buffer = _uvchan_queue_map_mirrored(slots * element_size, flags);
+  if (!buffer) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  queue->_buffer = buffer;
+  queue->_mapped_size = slots * element_size;
+  queue->_borrowed = 0;
+  _uvchan_queue_init_positions(queue, num_elements, element_size, slots);
+
+  return UVCHAN_ERR_SUCCESS;
+#else
+  return UVCHAN_ERR_NOT_SUPPORTED;
+#endif
 }
 
 void uvchan_queue_destroy(uvchan_queue* queue) {
-  assert(queue->_head == INCREMENT(queue->_tail, queue->capacity_elements));
-  free(queue->_buffer);
+  assert(_UVCHAN_LOAD_ACQUIRE(&queue->_head) ==
+         _UVCHAN_LOAD_ACQUIRE(&queue->_tail));
+
+#ifdef UVCHAN_HAVE_MIRRORED_RING
+  if (queue->_mapped_size) {
+    munmap(queue->_buffer, 2 * queue->_mapped_size);
+    queue->_buffer = 0L;
+    return;
+  }
+#endif
+
+  if (!queue->_borrowed) {
+    _uvchan_free(queue->_buffer);
+  }
   queue->_buffer = 0L;
 }
 
 uvchan_error_t uvchan_queue_push(uvchan_queue* queue, const void* element) {
-  if (queue->_head == queue->_tail) {
-    return UVCHAN_ERR_QUEUE_FULL;
+  size_t head;
+
+  head = _UVCHAN_LOAD_RELAXED(&queue->_head);
+
+  if (head - queue->_cached_tail >= queue->capacity_elements) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_tail);
+
+    if (head - queue->_cached_tail >= queue->capacity_elements) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
   }
 
-  memcpy(MEM_LOCATION(queue->_buffer, queue->_head, queue->element_size),
-         element, queue->element_size);
-  queue->_head = INCREMENT(queue->_head, queue->capacity_elements);
+  _UVCHAN_COPY_ELEMENT(MEM_LOCATION(queue, head), element,
+                       queue->element_size);
+  _UVCHAN_STORE_RELEASE(&queue->_head, head + 1);
 
   return UVCHAN_ERR_SUCCESS;
 }
 
 uvchan_error_t uvchan_queue_pop(uvchan_queue* queue, void* element) {
-  size_t next;
+  size_t tail;
 
-  next = INCREMENT(queue->_tail, queue->capacity_elements);
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
 
-  if (next == queue->_head) {
-    return UVCHAN_ERR_QUEUE_EMPTY;
+  if (tail == queue->_cached_head) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_head);
+
+    if (tail == queue->_cached_head) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    }
   }
 
-  memcpy(element, MEM_LOCATION(queue->_buffer, next, queue->element_size),
-         queue->element_size);
-  queue->_tail = next;
+  _UVCHAN_COPY_ELEMENT(element, MEM_LOCATION(queue, tail),
+                       queue->element_size);
+  _UVCHAN_STORE_RELEASE(&queue->_tail, tail + 1);
 
   return UVCHAN_ERR_SUCCESS;
 }
+
+size_t uvchan_queue_push_n(uvchan_queue* queue, const void* buffer,
+                           size_t num_elements) {
+  size_t head;
+  size_t available;
+  size_t first;
+
+  head = _UVCHAN_LOAD_RELAXED(&queue->_head);
+  available = queue->capacity_elements - (head - queue->_cached_tail);
+
+  if (available < num_elements) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_tail);
+    available = queue->capacity_elements - (head - queue->_cached_tail);
+  }
+
+  if (num_elements > available) {
+    num_elements = available;
+  }
+
+  if (num_elements < 1) {
+    return 0;
+  }
+
+  first = queue->_mask + 1 - (head & queue->_mask);
+  if (first > num_elements || queue->_mapped_size) {
+    first = num_elements;
+  }
+
+  memcpy(MEM_LOCATION(queue, head), buffer, first * queue->element_size);
+  memcpy(queue->_buffer, ((const char*)buffer) + first * queue->element_size,
+         (num_elements - first) * queue->element_size);
+  _UVCHAN_STORE_RELEASE(&queue->_head, head + num_elements);
+
+  return num_elements;
+}
+
+size_t uvchan_queue_pop_n(uvchan_queue* queue, void* buffer,
+                          size_t num_elements) {
+  size_t tail;
+  size_t available;
+  size_t first;
+
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
+  available = queue->_cached_head - tail;
+
+  if (available < num_elements) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_head);
+    available = queue->_cached_head - tail;
+  }
+
+  if (num_elements > available) {
+    num_elements = available;
+  }
+
+  if (num_elements < 1) {
+    return 0;
+  }
+
+  first = queue->_mask + 1 - (tail & queue->_mask);
+  if (first > num_elements || queue->_mapped_size) {
+    first = num_elements;
+  }
+
+  memcpy(buffer, MEM_LOCATION(queue, tail), first * queue->element_size);
+  memcpy(((char*)buffer) + first * queue->element_size, queue->_buffer,
+         (num_elements - first) * queue->element_size);
+  _UVCHAN_STORE_RELEASE(&queue->_tail, tail + num_elements);
+
+  return num_elements;
+}
+
+uvchan_error_t uvchan_queue_reserve(uvchan_queue* queue, void** slot) {
+  size_t head;
+
+  head = _UVCHAN_LOAD_RELAXED(&queue->_head);
+
+  if (head - queue->_cached_tail >= queue->capacity_elements) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_tail);
+
+    if (head - queue->_cached_tail >= queue->capacity_elements) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+  }
+
+  *slot = MEM_LOCATION(queue, head);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_queue_commit(uvchan_queue* queue) {
+  _UVCHAN_STORE_RELEASE(&queue->_head,
+                        _UVCHAN_LOAD_RELAXED(&queue->_head) + 1);
+}
+
+uvchan_error_t uvchan_queue_peek(uvchan_queue* queue, const void** slot) {
+  size_t tail;
+
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
+
+  if (tail == queue->_cached_head) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_head);
+
+    if (tail == queue->_cached_head) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    }
+  }
+
+  *slot = MEM_LOCATION(queue, tail);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_queue_release(uvchan_queue* queue) {
+  _UVCHAN_STORE_RELEASE(&queue->_tail,
+                        _UVCHAN_LOAD_RELAXED(&queue->_tail) + 1);
+}
+
+size_t uvchan_queue_reserve_n(uvchan_queue* queue, void** slot,
+                              size_t num_elements) {
+  size_t head;
+  size_t available;
+  size_t contiguous;
+
+  head = _UVCHAN_LOAD_RELAXED(&queue->_head);
+  available = queue->capacity_elements - (head - queue->_cached_tail);
+
+  if (available < num_elements) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_tail);
+    available = queue->capacity_elements - (head - queue->_cached_tail);
+  }
+
+  if (num_elements > available) {
+    num_elements = available;
+  }
+
+  contiguous = queue->_mask + 1 - (head & queue->_mask);
+  if (num_elements > contiguous && !queue->_mapped_size) {
+    num_elements = contiguous;
+  }
+
+  *slot = MEM_LOCATION(queue, head);
+
+  return num_elements;
+}
+
+void uvchan_queue_commit_n(uvchan_queue* queue, size_t num_elements) {
+  _UVCHAN_STORE_RELEASE(&queue->_head,
+                        _UVCHAN_LOAD_RELAXED(&queue->_head) + num_elements);
+}
+
+size_t uvchan_queue_peek_n(uvchan_queue* queue, const void** slot,
+                           size_t num_elements) {
+  size_t tail;
+  size_t available;
+  size_t contiguous;
+
+  tail = _UVCHAN_LOAD_RELAXED(&queue->_tail);
+  available = queue->_cached_head - tail;
+
+  if (available < num_elements) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_head);
+    available = queue->_cached_head - tail;
+  }
+
+  if (num_elements > available) {
+    num_elements = available;
+  }
+
+  contiguous = queue->_mask + 1 - (tail & queue->_mask);
+  if (num_elements > contiguous && !queue->_mapped_size) {
+    num_elements = contiguous;
+  }
+
+  *slot = MEM_LOCATION(queue, tail);
+
+  return num_elements;
+}
+
+void uvchan_queue_release_n(uvchan_queue* queue, size_t num_elements) {
+  _UVCHAN_STORE_RELEASE(&queue->_tail,
+                        _UVCHAN_LOAD_RELAXED(&queue->_tail) + num_elements);
+}
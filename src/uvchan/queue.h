@@ -4,6 +4,37 @@
 #include <stdlib.h>
 #include <uvchan/error.h>
 
+/**
+ * @brief assumed size of a cache line in bytes
+ *
+ * Producer and consumer owned parts of _uvchan_queue are padded
+ * apart by this amount to avoid false sharing between threads.
+ */
+#define kUvChanCacheLineSize 64
+
+/**
+ * @brief map ring memory twice back to back
+ *
+ * With this flag #uvchan_queue_init_ex maps ring's memory a second
+ * time right after itself, so that any run of items is addressable as
+ * one contiguous span even when it wraps around end of the ring.
+ * Ring size is rounded up to a multiple of page size.
+ */
+#define UVCHAN_QUEUE_MIRRORED 0x01
+
+/**
+ * @brief back a mirrored ring by huge pages
+ *
+ * Only meaningful together with #UVCHAN_QUEUE_MIRRORED. Ring size is
+ * rounded up to a multiple of #kUvChanHugePageSize.
+ */
+#define UVCHAN_QUEUE_HUGE_PAGES 0x02
+
+/**
+ * @brief assumed size of a huge page in bytes
+ */
+#define kUvChanHugePageSize (2 * 1024 * 1024)
+
 /**
  * @brief Models a FIFO queue
  *
@@ -24,7 +55,14 @@
  * IO or other stuff and libuv idle handlers, because
  * there would be a single producer and a single consumer,
  * and the queue itself is lockless. This is achieved by
- * incorporating \b volatile on internal queue structure.
+ * publishing producer and consumer positions with acquire/release
+ * atomics. Each position lives on it's own cache line together with
+ * a cached copy of the opposite position, so that threads only touch
+ * each other's cache line when the queue looks full or empty.
+ *
+ * Internally the ring is sized to a power of two so that slots are
+ * addressed by masking free running positions, while the number of
+ * items is still bounded by requested capacity.
  *
  * Also note that queue does not private a \b length operation
  * intentionally. As providing this method would violate
@@ -52,9 +90,20 @@
 typedef struct _uvchan_queue {
   void* _buffer;            /**< @private */
   size_t element_size;      /**< size of each item in queue in bytes */
-  volatile size_t _head;    /**< @private */
-  volatile size_t _tail;    /**< @private */
   size_t capacity_elements; /**< capacity of queue */
+  size_t _mask;             /**< @private */
+  size_t _mapped_size;      /**< @private */
+  size_t _borrowed;         /**< @private ring is owned by caller */
+  char _pad0[kUvChanCacheLineSize - sizeof(void*) -
+             5 * sizeof(size_t)]; /**< @private */
+
+  size_t _head;        /**< @private written by producer */
+  size_t _cached_tail; /**< @private */
+  char _pad1[kUvChanCacheLineSize - 2 * sizeof(size_t)]; /**< @private */
+
+  size_t _tail;        /**< @private written by consumer */
+  size_t _cached_head; /**< @private */
+  char _pad2[kUvChanCacheLineSize - 2 * sizeof(size_t)]; /**< @private */
 } uvchan_queue;
 
 /**
@@ -78,6 +127,41 @@ typedef struct _uvchan_queue {
 void uvchan_queue_init(uvchan_queue* queue, size_t num_elements,
                        size_t element_size);
 
+/**
+ * @brief bytes of ring memory needed by a queue
+ *
+ * Size of buffer #uvchan_queue_init_buffer expects for a queue of
+ * @p num_elements items of @p element_size bytes each.
+ */
+size_t uvchan_queue_buffer_size(size_t num_elements, size_t element_size);
+
+/**
+ * @brief initialize a new queue over caller provided ring memory
+ *
+ * Same as #uvchan_queue_init, except that ring lives in @p buffer of
+ * at least #uvchan_queue_buffer_size bytes, so that a queue may share
+ * a single allocation with its owner. #uvchan_queue_destroy leaves
+ * @p buffer alone.
+ */
+void uvchan_queue_init_buffer(uvchan_queue* queue, size_t num_elements,
+                              size_t element_size, void* buffer);
+
+/**
+ * @brief initialize a new queue with allocation flags
+ *
+ * Same as #uvchan_queue_init, except that ring memory is allocated
+ * according to @p flags.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_NOT_SUPPORTED if
+ * requested allocation mode is not available on this platform, in
+ * which case @p queue is left uninitialized.
+ *
+ * @see UVCHAN_QUEUE_MIRRORED
+ * @see UVCHAN_QUEUE_HUGE_PAGES
+ */
+uvchan_error_t uvchan_queue_init_ex(uvchan_queue* queue, size_t num_elements,
+                                    size_t element_size, unsigned int flags);
+
 /**
  * @brief destroy resources allocated to queue
  *
@@ -128,4 +212,118 @@ uvchan_error_t uvchan_queue_push(uvchan_queue* queue, const void* buffer);
  */
 uvchan_error_t uvchan_queue_pop(uvchan_queue* queue, void* buffer);
 
+/**
+ * @brief push up to @p num_elements items to back of queue
+ *
+ * This function pushes as many items from @p buffer as currently fit
+ * into queue, but no more than @p num_elements. @p buffer is expected to
+ * hold items back to back, each #_uvchan_queue#element_size bytes long.
+ * Items are deep-copied using at most two memcpy calls, one on each side
+ * of the ring's wraparound point, and are published to the consumer
+ * all at once.
+ *
+ * @return number of items pushed, zero if queue is full.
+ *
+ * @see uvchan_queue_push
+ */
+size_t uvchan_queue_push_n(uvchan_queue* queue, const void* buffer,
+                           size_t num_elements);
+
+/**
+ * @brief pop up to @p num_elements items from front of queue
+ *
+ * This function retrieves as many items as are currently available,
+ * but no more than @p num_elements, into @p buffer. So the caller has
+ * to have allocated at least @p num_elements times
+ * #_uvchan_queue#element_size bytes. Items are deep-copied using at most
+ * two memcpy calls and are released to the producer all at once.
+ *
+ * @return number of items popped, zero if queue is empty.
+ *
+ * @see uvchan_queue_pop
+ */
+size_t uvchan_queue_pop_n(uvchan_queue* queue, void* buffer,
+                          size_t num_elements);
+
+/**
+ * @brief reserve a slot at back of queue for in-place writing
+ *
+ * This function hands out location of next free slot in @p slot,
+ * so that producer can construct an item directly inside queue's
+ * memory instead of copying it in. Reserved slot becomes visible to
+ * consumer only after calling #uvchan_queue_commit. Producer must not
+ * push or reserve again before committing.
+ *
+ * @return zero if operation succeeds. non-zero if error occurs.
+ *
+ * @see UVCHAN_ERR_SUCCESS
+ * @see UVCHAN_ERR_QUEUE_FULL
+ * @see uvchan_queue_commit
+ */
+uvchan_error_t uvchan_queue_reserve(uvchan_queue* queue, void** slot);
+
+/**
+ * @brief publish slot previously reserved by #uvchan_queue_reserve
+ */
+void uvchan_queue_commit(uvchan_queue* queue);
+
+/**
+ * @brief expose item at front of queue for in-place reading
+ *
+ * This function hands out location of item at front of queue in
+ * @p slot, without copying it out. Item stays in queue and it's slot
+ * is not reused until calling #uvchan_queue_release. Consumer must not
+ * pop or peek again before releasing.
+ *
+ * @return zero if operation succeeds. non-zero if error occurs.
+ *
+ * @see UVCHAN_ERR_SUCCESS
+ * @see UVCHAN_ERR_QUEUE_EMPTY
+ * @see uvchan_queue_release
+ */
+uvchan_error_t uvchan_queue_peek(uvchan_queue* queue, const void** slot);
+
+/**
+ * @brief remove item previously exposed by #uvchan_queue_peek
+ */
+void uvchan_queue_release(uvchan_queue* queue);
+
+/**
+ * @brief reserve a contiguous span of slots for in-place writing
+ *
+ * Same as #uvchan_queue_reserve but hands out up to @p num_elements
+ * consecutive slots starting at @p slot. Unless queue is
+ * #UVCHAN_QUEUE_MIRRORED, span stops at end of the ring.
+ *
+ * @return number of slots in span, zero if queue is full.
+ *
+ * @see uvchan_queue_commit_n
+ */
+size_t uvchan_queue_reserve_n(uvchan_queue* queue, void** slot,
+                              size_t num_elements);
+
+/**
+ * @brief publish first @p num_elements slots of a reserved span
+ */
+void uvchan_queue_commit_n(uvchan_queue* queue, size_t num_elements);
+
+/**
+ * @brief expose a contiguous span of items for in-place reading
+ *
+ * Same as #uvchan_queue_peek but hands out up to @p num_elements
+ * consecutive items starting at @p slot. Unless queue is
+ * #UVCHAN_QUEUE_MIRRORED, span stops at end of the ring.
+ *
+ * @return number of items in span, zero if queue is empty.
+ *
+ * @see uvchan_queue_release_n
+ */
+size_t uvchan_queue_peek_n(uvchan_queue* queue, const void** slot,
+                           size_t num_elements);
+
+/**
+ * @brief remove first @p num_elements items of a peeked span
+ */
+void uvchan_queue_release_n(uvchan_queue* queue, size_t num_elements);
+
 #endif  // UVCHAN_QUEUE_H__
@@ -0,0 +1,193 @@
+#include <uvchan/alloc.h>
+#include <uvchan/copy.h>
+#include <uvchan/segment_queue.h>
+
+#include <assert.h>
+#include <string.h>
+
+#define SEGMENT_DATA(segment) (((char*)(segment)) + sizeof(uvchan_segment))
+#define MEM_LOCATION(queue, segment, index)                   \
+  (SEGMENT_DATA(segment) + ((index) * (queue)->element_size))
+
+static uvchan_segment* _uvchan_segment_new(uvchan_segment_queue* queue) {
+  uvchan_segment* segment;
+
+  if (queue->_free_segments) {
+    segment = queue->_free_segments;
+    queue->_free_segments = segment->next;
+    queue->_free_count--;
+  } else {
+    segment = (uvchan_segment*)_uvchan_malloc(
+        sizeof(uvchan_segment) + queue->segment_elements * queue->element_size);
+
+    if (!segment) {
+      return 0L;
+    }
+  }
+
+  segment->next = 0L;
+  segment->read = 0;
+  segment->write = 0;
+
+  return segment;
+}
+
+static void _uvchan_segment_recycle(uvchan_segment_queue* queue,
+                                    uvchan_segment* segment) {
+  if (queue->_free_count < kUvChanSegmentFreeListSize) {
+    segment->next = queue->_free_segments;
+    queue->_free_segments = segment;
+    queue->_free_count++;
+  } else {
+    _uvchan_free(segment);
+  }
+}
+
+void uvchan_segment_queue_init(uvchan_segment_queue* queue,
+                               size_t segment_elements, size_t element_size) {
+  if (segment_elements < 1) {
+    segment_elements = kUvChanDefaultSegmentElements;
+  }
+
+  queue->element_size = element_size;
+  queue->segment_elements = segment_elements;
+  queue->_free_segments = 0L;
+  queue->_free_count = 0;
+  queue->_read_segment = _uvchan_segment_new(queue);
+  queue->_write_segment = queue->_read_segment;
+}
+
+void uvchan_segment_queue_destroy(uvchan_segment_queue* queue) {
+  uvchan_segment* segment;
+
+  assert(queue->_read_segment == queue->_write_segment &&
+         queue->_read_segment->read == queue->_read_segment->write);
+
+  _uvchan_free(queue->_read_segment);
+  queue->_read_segment = 0L;
+  queue->_write_segment = 0L;
+
+  while (queue->_free_segments) {
+    segment = queue->_free_segments;
+    queue->_free_segments = segment->next;
+    _uvchan_free(segment);
+  }
+  queue->_free_count = 0;
+}
+
+uvchan_error_t uvchan_segment_queue_reserve(uvchan_segment_queue* queue,
+                                            void** slot) {
+  uvchan_segment* segment;
+
+  segment = queue->_write_segment;
+
+  if (segment->write == queue->segment_elements) {
+    segment = _uvchan_segment_new(queue);
+
+    if (!segment) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+
+    queue->_write_segment->next = segment;
+    queue->_write_segment = segment;
+  }
+
+  *slot = MEM_LOCATION(queue, segment, segment->write);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_segment_queue_commit(uvchan_segment_queue* queue) {
+  queue->_write_segment->write++;
+}
+
+uvchan_error_t uvchan_segment_queue_peek(uvchan_segment_queue* queue,
+                                         const void** slot) {
+  uvchan_segment* segment;
+
+  segment = queue->_read_segment;
+
+  // next segment may hold nothing but a slot reserved and not yet
+  // committed, which is no item either
+  while (segment->read == segment->write) {
+    if (segment == queue->_write_segment) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    }
+
+    queue->_read_segment = segment->next;
+    _uvchan_segment_recycle(queue, segment);
+    segment = queue->_read_segment;
+  }
+
+  *slot = MEM_LOCATION(queue, segment, segment->read);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+void uvchan_segment_queue_release(uvchan_segment_queue* queue) {
+  queue->_read_segment->read++;
+}
+
+uvchan_error_t uvchan_segment_queue_push(uvchan_segment_queue* queue,
+                                         const void* element) {
+  void* slot;
+
+  if (uvchan_segment_queue_reserve(queue, &slot) != UVCHAN_ERR_SUCCESS) {
+    return UVCHAN_ERR_QUEUE_FULL;
+  }
+
+  _UVCHAN_COPY_ELEMENT(slot, element, queue->element_size);
+  queue->_write_segment->write++;
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_segment_queue_pop(uvchan_segment_queue* queue,
+                                        void* element) {
+  const void* slot;
+
+  if (uvchan_segment_queue_peek(queue, &slot) != UVCHAN_ERR_SUCCESS) {
+    return UVCHAN_ERR_QUEUE_EMPTY;
+  }
+
+  _UVCHAN_COPY_ELEMENT(element, slot, queue->element_size);
+  queue->_read_segment->read++;
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+size_t uvchan_segment_queue_pop_n(uvchan_segment_queue* queue, void* buffer,
+                                  size_t num_elements) {
+  uvchan_segment* segment;
+  size_t popped;
+  size_t run;
+
+  popped = 0;
+  segment = queue->_read_segment;
+
+  while (popped < num_elements) {
+    if (segment->read == segment->write) {
+      if (segment == queue->_write_segment) {
+        break;
+      }
+
+      queue->_read_segment = segment->next;
+      _uvchan_segment_recycle(queue, segment);
+      segment = queue->_read_segment;
+      continue;
+    }
+
+    run = segment->write - segment->read;
+    if (run > num_elements - popped) {
+      run = num_elements - popped;
+    }
+
+    memcpy((char*)buffer + popped * queue->element_size,
+           MEM_LOCATION(queue, segment, segment->read),
+           run * queue->element_size);
+    segment->read += run;
+    popped += run;
+  }
+
+  return popped;
+}
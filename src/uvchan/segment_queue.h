@@ -0,0 +1,129 @@
+#ifndef UVCHAN_SEGMENT_QUEUE_H__
+#define UVCHAN_SEGMENT_QUEUE_H__
+
+#include <stdlib.h>
+#include <uvchan/error.h>
+
+/**
+ * @brief number of drained segments kept around for reuse
+ *
+ * Segments drained by consumer are recycled through a free list of at
+ * most this many segments, so that a steady backlog does not allocate.
+ * Any segment beyond that is released, which shrinks memory back once
+ * a burst has been consumed.
+ */
+#define kUvChanSegmentFreeListSize 2
+
+/**
+ * @brief segment size used when caller does not specify one
+ */
+#define kUvChanDefaultSegmentElements 64
+
+/**
+ * @private
+ */
+typedef struct _uvchan_segment {
+  struct _uvchan_segment* next;
+  size_t read;
+  size_t write;
+} uvchan_segment;
+
+/**
+ * @brief Models an unbounded FIFO queue
+ *
+ * uvchan_segment_queue stores items in a linked list of fixed-size
+ * segments. Producer appends to last segment and links a new one once
+ * it fills up, consumer reads from first segment and unlinks it once
+ * it is drained. So memory grows with actual backlog instead of being
+ * provisioned up front, while items within a segment are laid out
+ * contiguously same as _uvchan_queue.
+ *
+ * Unlike _uvchan_queue, uvchan_segment_queue is not threadsafe.
+ *
+ * @see uvchan_segment_queue_init
+ * @see uvchan_segment_queue_push
+ * @see uvchan_segment_queue_pop
+ * @see uvchan_segment_queue_destroy
+ */
+typedef struct _uvchan_segment_queue {
+  uvchan_segment* _read_segment;  /**< @private */
+  uvchan_segment* _write_segment; /**< @private */
+  uvchan_segment* _free_segments; /**< @private */
+  size_t _free_count;             /**< @private */
+  size_t element_size;            /**< size of each item in queue in bytes */
+  size_t segment_elements;        /**< number of items in each segment */
+} uvchan_segment_queue;
+
+/**
+ * @brief initialize a new unbounded queue
+ *
+ * @param queue location of _uvchan_segment_queue instance to initialize.
+ * @param segment_elements number of items each segment holds, zero
+ * selects #kUvChanDefaultSegmentElements.
+ * @param element_size shows size of each item in bytes.
+ *
+ * @see uvchan_segment_queue_destroy
+ */
+void uvchan_segment_queue_init(uvchan_segment_queue* queue,
+                               size_t segment_elements, size_t element_size);
+
+/**
+ * @brief destroy resources allocated to queue
+ *
+ * @warning same as #uvchan_queue_destroy, queue is asserted to be empty.
+ */
+void uvchan_segment_queue_destroy(uvchan_segment_queue* queue);
+
+/**
+ * @brief push a new item to back of queue
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_FULL only if
+ * a new segment could not be allocated.
+ */
+uvchan_error_t uvchan_segment_queue_push(uvchan_segment_queue* queue,
+                                         const void* buffer);
+
+/**
+ * @brief pop an item from front of queue
+ *
+ * @return zero if operation succeeds. non-zero if error occurs.
+ *
+ * @see UVCHAN_ERR_SUCCESS
+ * @see UVCHAN_ERR_QUEUE_EMPTY
+ */
+uvchan_error_t uvchan_segment_queue_pop(uvchan_segment_queue* queue,
+                                        void* buffer);
+
+/**
+ * @brief pop up to @p num_elements items into @p buffer
+ *
+ * Same as #uvchan_queue_pop_n, items are copied a segment at a time.
+ *
+ * @return number of items popped.
+ */
+size_t uvchan_segment_queue_pop_n(uvchan_segment_queue* queue, void* buffer,
+                                  size_t num_elements);
+
+/**
+ * @brief same as #uvchan_queue_reserve
+ */
+uvchan_error_t uvchan_segment_queue_reserve(uvchan_segment_queue* queue,
+                                            void** slot);
+
+/**
+ * @brief same as #uvchan_queue_commit
+ */
+void uvchan_segment_queue_commit(uvchan_segment_queue* queue);
+
+/**
+ * @brief same as #uvchan_queue_peek
+ */
+uvchan_error_t uvchan_segment_queue_peek(uvchan_segment_queue* queue,
+                                         const void** slot);
+
+/**
+ * @brief same as #uvchan_queue_release
+ */
+void uvchan_segment_queue_release(uvchan_segment_queue* queue);
+
+#endif  // UVCHAN_SEGMENT_QUEUE_H__
@@ -1,17 +1,76 @@
+#include <uvchan/atomic.h>
 #include <uvchan/error.h>
 #include <uvchan/select.h>
 
 #include <uv.h>
 
+#include <stddef.h>
+
 #include "./config.h"
 
+#ifdef LIBUV_0X
+static void _uvchan_start_select_idle_cb(uv_idle_t* idle_handle, int status);
+#elif LIBUV_1X
+static void _uvchan_start_select_idle_cb(uv_idle_t* idle_handle);
+#else
+#error callback not defined for unknown version of libuv
+#endif
+
+static void _uvchan_select_handle_init_waiters(uvchan_select_handle_t* handle) {
+  int i;
+
+  for (i = 0; i < kUvChanMaxSelect; i++) {
+    _uvchan_waiter_init(&handle->waiters[i], (uv_idle_t*)handle,
+                        _uvchan_start_select_idle_cb);
+  }
+}
+
+static void _uvchan_select_handle_unpark(uvchan_select_handle_t* handle) {
+  int i;
+
+  for (i = 0; i < handle->count; i++) {
+    _uvchan_waiter_unpark(&handle->waiters[i]);
+  }
+}
+
+// a case may try its channel when it was woken by it, or when nobody
+// else is waiting there
+static int _uvchan_select_turn(uvchan_waiter_t* waiters,
+                               uvchan_waiter_t* waiter) {
+  return waiter->queue != 0L || _uvchan_waiter_idle(waiters);
+}
+
+// cases stay parked, select retries them once more before giving up
+static void _uvchan_select_expire_cb(uvchan_deadline_t* deadline) {
+  uvchan_select_handle_t* handle;
+
+  handle = (uvchan_select_handle_t*)((char*)deadline -
+                                     offsetof(uvchan_select_handle_t,
+                                              deadline));
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_select_idle_cb);
+}
+
+static void _uvchan_select_cancel_cb(uvchan_cancel_link_t* link) {
+  uvchan_select_handle_t* handle;
+
+  handle = (uvchan_select_handle_t*)((char*)link -
+                                     offsetof(uvchan_select_handle_t,
+                                              cancel));
+  uv_idle_start((uv_idle_t*)handle, _uvchan_start_select_idle_cb);
+}
+
 void uvchan_select_handle_init(uv_loop_t* loop, uvchan_select_handle_t* handle,
                                uvchan_select_cb cb) {
   uv_idle_init(loop, (uv_idle_t*)handle);
 
   handle->count = 0;
   handle->has_default = 0;
+  handle->has_timeout = 0;
+  handle->has_cancel = 0;
   handle->callback = cb;
+  _uvchan_select_handle_init_waiters(handle);
+  uvchan_deadline_init(&handle->deadline, _uvchan_select_expire_cb);
+  uvchan_cancel_link_init(&handle->cancel, _uvchan_select_cancel_cb);
 }
 
 int _uvchan_select_handle_indexof(uvchan_select_handle_t* handle, int tag) {
@@ -75,15 +134,42 @@ int uvchan_select_handle_add_default(uvchan_select_handle_t* handle, int tag) {
   return UVCHAN_ERR_SUCCESS;
 }
 
+int uvchan_select_handle_add_timeout(uvchan_select_handle_t* handle, int tag,
+                                     uvchan_wheel_t* wheel,
+                                     uint64_t timeout_ms) {
+  handle->has_timeout = 1;
+  handle->timeout_tag = tag;
+  handle->deadline.wheel = wheel;
+  handle->deadline.timeout = timeout_ms;
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+int uvchan_select_handle_add_cancel(uvchan_select_handle_t* handle, int tag,
+                                    uvchan_cancel_t* cancel) {
+  handle->has_cancel = 1;
+  handle->cancel_tag = tag;
+  handle->cancel.cancel = cancel;
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
 int uvchan_select_handle_remove_tag(uvchan_select_handle_t* handle, int tag) {
   int i;
   int j;
+  int parked;
 
   i = _uvchan_select_handle_indexof(handle, tag);
   if (i < 0) {
     return UVCHAN_ERR_SELECT_TAG_NOTFOUND;
   }
 
+  // waiters are unlinked before shifting cases, otherwise channel
+  // waiter lists would point into stale slots. a parked select is
+  // retried on next iteration so that remaining cases are parked again.
+  parked = handle->waiters[i].next != &handle->waiters[i];
+  _uvchan_select_handle_unpark(handle);
+
   uvchan_unref(handle->channels[i]);
 
   j = i + 1;
@@ -98,6 +184,11 @@ int uvchan_select_handle_remove_tag(uvchan_select_handle_t* handle, int tag) {
   }
 
   handle->count--;
+  _uvchan_select_handle_init_waiters(handle);
+
+  if (parked) {
+    uv_idle_start((uv_idle_t*)handle, _uvchan_start_select_idle_cb);
+  }
 
   return UVCHAN_ERR_SUCCESS;
 }
@@ -107,6 +198,7 @@ void _uvchan_start_select_fire(uvchan_select_handle_t* handle, int tag,
   int i;
 
   uv_idle_stop((uv_idle_t*)handle);
+  _uvchan_select_handle_unpark(handle);
   for (i = 0; i < handle->count; i++) {
     uvchan_unref(handle->channels[i]);
   }
@@ -131,12 +223,23 @@ static void _uvchan_start_select_idle_cb(uv_idle_t* idle_handle) {
 #endif
 
   handle = (uvchan_select_handle_t*)idle_handle;
+  uvchan_deadline_disarm(&handle->deadline);
+  uvchan_cancel_detach(&handle->cancel);
+
+  // a token cancelled before select got to run wins over ready cases
+  if (handle->has_cancel && handle->cancel.cancelled) {
+    _uvchan_start_select_fire(handle, handle->cancel_tag,
+                              UVCHAN_ERR_CANCELLED);
+    return;
+  }
 
+  // cases stay parked on channels which did not wake select, so that
+  // they keep their place in line there
   for (i = 0; i < handle->count; i++) {
     ch = handle->channels[i];
     element = handle->elements[i];
 
-    if (ch->closed) {
+    if (_UVCHAN_LOAD_ACQUIRE(&ch->closed)) {
       _uvchan_start_select_fire(handle, handle->tags[i],
                                 UVCHAN_ERR_CHANNEL_CLOSED);
       return;
@@ -144,15 +247,18 @@ static void _uvchan_start_select_idle_cb(uv_idle_t* idle_handle) {
 
     switch (handle->operations[i]) {
       case _UVCHAN_OPERATION_PUSH:
-        if ((!ch->poll_required || ch->polling) &&
-            (uvchan_queue_push(&ch->queue, element) == UVCHAN_ERR_SUCCESS)) {
+        if (_uvchan_select_turn(&ch->push_waiters, &handle->waiters[i]) &&
+            _uvchan_try_push(ch, element) == UVCHAN_ERR_SUCCESS) {
+          _uvchan_waiter_claim(&handle->waiters[i]);
           _uvchan_start_select_fire(handle, handle->tags[i],
                                     UVCHAN_ERR_SUCCESS);
           return;
         }
         break;
       case _UVCHAN_OPERATION_POP:
-        if (uvchan_queue_pop(&ch->queue, element) == UVCHAN_ERR_SUCCESS) {
+        if (_uvchan_select_turn(&ch->pop_waiters, &handle->waiters[i]) &&
+            _uvchan_try_pop(ch, element) == UVCHAN_ERR_SUCCESS) {
+          _uvchan_waiter_claim(&handle->waiters[i]);
           _uvchan_start_select_fire(handle, handle->tags[i],
                                     UVCHAN_ERR_SUCCESS);
           return;
@@ -165,13 +271,50 @@ static void _uvchan_start_select_idle_cb(uv_idle_t* idle_handle) {
     _uvchan_start_select_fire(handle, handle->default_tag, UVCHAN_ERR_SUCCESS);
     return;
   }
+
+  if (handle->has_timeout && handle->deadline.expired) {
+    _uvchan_start_select_fire(handle, handle->timeout_tag, UVCHAN_ERR_TIMEOUT);
+    return;
+  }
+
+  uv_idle_stop(idle_handle);
+  for (i = 0; i < handle->count; i++) {
+    ch = handle->channels[i];
+
+    switch (handle->operations[i]) {
+      case _UVCHAN_OPERATION_PUSH:
+        _uvchan_park(ch, idle_handle->loop, &ch->push_waiters,
+                     &handle->waiters[i],
+                     _uvchan_waiter_claim(&handle->waiters[i]));
+        break;
+      case _UVCHAN_OPERATION_POP:
+        _uvchan_park(ch, idle_handle->loop, &ch->pop_waiters,
+                     &handle->waiters[i],
+                     _uvchan_waiter_claim(&handle->waiters[i]));
+        break;
+    }
+  }
+
+  uvchan_deadline_rearm(&handle->deadline);
+  uvchan_cancel_attach(&handle->cancel);
 }
 
 int uvchan_select_handle_start(uvchan_select_handle_t* handle) {
-  if (!handle->has_default && handle->count < 1) {
+  if (!handle->has_default && !handle->has_timeout && !handle->has_cancel &&
+      handle->count < 1) {
     return UVCHAN_ERR_SELECT_EMPTY;
   }
 
+  if (handle->has_timeout) {
+    uvchan_deadline_arm(&handle->deadline, handle->deadline.wheel,
+                        handle->deadline.timeout);
+  }
+
+  if (handle->has_cancel) {
+    handle->cancel.cancelled = 0;
+    uvchan_cancel_attach(&handle->cancel);
+  }
+
   uv_idle_start((uv_idle_t*)handle, _uvchan_start_select_idle_cb);
   return UVCHAN_ERR_SUCCESS;
 }
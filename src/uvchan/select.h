@@ -19,8 +19,16 @@ typedef struct _uvchan_select_handle_t {
   int count;
   int has_default;
   int default_tag;
+  int has_timeout;
+  int timeout_tag;
+  int has_cancel;
+  int cancel_tag;
 
   void* data;
+
+  uvchan_waiter_t waiters[kUvChanMaxSelect]; /**< @private */
+  uvchan_deadline_t deadline;                /**< @private */
+  uvchan_cancel_link_t cancel;               /**< @private */
 } uvchan_select_handle_t;
 
 typedef void (*uvchan_select_cb)(uvchan_select_handle_t* handle, int tag,
@@ -33,6 +41,26 @@ int uvchan_select_handle_add_push(uvchan_select_handle_t* handle, int tag,
 int uvchan_select_handle_add_pop(uvchan_select_handle_t* handle, int tag,
                                  uvchan_t* ch, void* buffer);
 int uvchan_select_handle_add_default(uvchan_select_handle_t* handle, int tag);
+
+/**
+ * @brief give up waiting after @p timeout_ms
+ *
+ * If no case is ready within @p timeout_ms of #uvchan_select_handle_start,
+ * select completes with @p tag and #UVCHAN_ERR_TIMEOUT. Deadline is kept
+ * in @p wheel, which has to run on loop of select.
+ */
+int uvchan_select_handle_add_timeout(uvchan_select_handle_t* handle, int tag,
+                                     uvchan_wheel_t* wheel,
+                                     uint64_t timeout_ms);
+
+/**
+ * @brief give up waiting once @p cancel is cancelled
+ *
+ * Select completes with @p tag and #UVCHAN_ERR_CANCELLED if @p cancel
+ * is cancelled before a case is ready.
+ */
+int uvchan_select_handle_add_cancel(uvchan_select_handle_t* handle, int tag,
+                                    uvchan_cancel_t* cancel);
 int uvchan_select_handle_remove_tag(uvchan_select_handle_t* handle, int tag);
 
 int uvchan_select_handle_start(uvchan_select_handle_t* handle);
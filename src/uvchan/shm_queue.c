@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+
+#include <uvchan/atomic.h>
+#include <uvchan/copy.h>
+#include <uvchan/shm_queue.h>
+
+#include <string.h>
+
+#include "./config.h"
+
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H) && \
+    defined(HAVE_SYS_EVENTFD_H)
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define UVCHAN_HAVE_SHM_QUEUE 1
+#endif
+
+#define MEM_LOCATION(queue, index) \
+  ((queue)->_buffer + (((index) & (queue)->_mask) * (queue)->_element_size))
+
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+static void _uvchan_shm_queue_signal(int fd) {
+  uint64_t value;
+
+  value = 1;
+  // eventfd counter only overflows after 2^64 - 1 unacknowledged
+  // signals, so a failed write has nothing useful to report.
+  if (write(fd, &value, sizeof(value)) != sizeof(value)) {
+    return;
+  }
+}
+
+// header may have been written by a peer we do not trust, so it is
+// read once, checked against mapping, and never consulted again
+static int _uvchan_shm_ring_valid(const uvchan_shm_ring* ring, size_t size,
+                                  size_t element_size) {
+  size_t slots;
+
+  slots = ring->_mask + 1;
+  if (slots == 0 || (slots & ring->_mask) != 0 ||
+      ring->element_size != element_size || element_size == 0 ||
+      ring->capacity_elements < 1 || ring->capacity_elements > slots ||
+      ring->_buffer_offset < sizeof(uvchan_shm_ring) ||
+      ring->_buffer_offset > size) {
+    return 0;
+  }
+
+  return slots <= (size - ring->_buffer_offset) / element_size;
+}
+
+static uvchan_error_t _uvchan_shm_queue_map(uvchan_shm_queue* queue,
+                                            size_t size,
+                                            size_t element_size) {
+  uvchan_shm_ring header;
+  void* base;
+
+  base = mmap(0L, size, PROT_READ | PROT_WRITE, MAP_SHARED, queue->mem_fd, 0);
+  if (base == MAP_FAILED) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  memcpy(&header, base, sizeof(header));
+  if (!_uvchan_shm_ring_valid(&header, size, element_size)) {
+    munmap(base, size);
+    return UVCHAN_ERR_INVALID_ARGUMENT;
+  }
+
+  queue->_ring = (uvchan_shm_ring*)base;
+  queue->_buffer = ((char*)base) + header._buffer_offset;
+  queue->_mapped_size = size;
+  queue->_element_size = header.element_size;
+  queue->_capacity = header.capacity_elements;
+  queue->_mask = header._mask;
+  queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&queue->_ring->_head);
+  queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&queue->_ring->_tail);
+
+  return UVCHAN_ERR_SUCCESS;
+}
+#endif
+
+uvchan_error_t uvchan_shm_queue_init(uvchan_shm_queue* queue,
+                                     size_t num_elements,
+                                     size_t element_size) {
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  uvchan_shm_ring ring;
+  size_t slots;
+  size_t size;
+
+  slots = 1;
+  while (slots < num_elements) {
+    slots <<= 1;
+  }
+  size = sizeof(uvchan_shm_ring) + slots * element_size;
+
+  queue->mem_fd = memfd_create("uvchan_shm_queue", MFD_CLOEXEC);
+  queue->data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  queue->space_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+  memset(&ring, 0, sizeof(ring));
+  ring.element_size = element_size;
+  ring.capacity_elements = num_elements;
+  ring._mask = slots - 1;
+  ring._buffer_offset = sizeof(uvchan_shm_ring);
+
+  // a fresh memfd reads as zeros, so only header has to be written
+  if (queue->mem_fd < 0 || queue->data_fd < 0 || queue->space_fd < 0 ||
+      ftruncate(queue->mem_fd, size) != 0 ||
+      pwrite(queue->mem_fd, &ring, sizeof(ring), 0) != sizeof(ring) ||
+      _uvchan_shm_queue_map(queue, size, element_size) !=
+          UVCHAN_ERR_SUCCESS) {
+    if (queue->mem_fd >= 0) {
+      close(queue->mem_fd);
+    }
+    if (queue->data_fd >= 0) {
+      close(queue->data_fd);
+    }
+    if (queue->space_fd >= 0) {
+      close(queue->space_fd);
+    }
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  return UVCHAN_ERR_SUCCESS;
+#else
+  return UVCHAN_ERR_NOT_SUPPORTED;
+#endif
+}
+
+uvchan_error_t uvchan_shm_queue_open(uvchan_shm_queue* queue, int mem_fd,
+                                     int data_fd, int space_fd,
+                                     size_t element_size) {
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  struct stat st;
+
+  queue->mem_fd = mem_fd;
+  queue->data_fd = data_fd;
+  queue->space_fd = space_fd;
+
+  if (fstat(mem_fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(uvchan_shm_ring)) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  return _uvchan_shm_queue_map(queue, (size_t)st.st_size, element_size);
+#else
+  ((void)element_size);
+  return UVCHAN_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void uvchan_shm_queue_destroy(uvchan_shm_queue* queue) {
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  munmap(queue->_ring, queue->_mapped_size);
+  close(queue->mem_fd);
+  close(queue->data_fd);
+  close(queue->space_fd);
+#endif
+  queue->_ring = 0L;
+  queue->_buffer = 0L;
+}
+
+uvchan_error_t uvchan_shm_queue_push(uvchan_shm_queue* queue,
+                                     const void* element) {
+  uvchan_shm_ring* ring;
+  size_t head;
+
+  ring = queue->_ring;
+  head = _UVCHAN_LOAD_RELAXED(&ring->_head);
+
+  if (head - queue->_cached_tail >= queue->_capacity) {
+    queue->_cached_tail = _UVCHAN_LOAD_ACQUIRE(&ring->_tail);
+    if (head - queue->_cached_tail >= queue->_capacity) {
+      return UVCHAN_ERR_QUEUE_FULL;
+    }
+  }
+
+  _UVCHAN_COPY_ELEMENT(MEM_LOCATION(queue, head), element,
+                       queue->_element_size);
+  _UVCHAN_STORE_RELEASE(&ring->_head, head + 1);
+
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  // pairs with fence in uvchan_shm_queue_arm_pop, either consumer
+  // sees new head or we see it's armed wait.
+  _UVCHAN_FENCE_SEQ_CST();
+  if (_UVCHAN_LOAD_RELAXED(&ring->_data_waiting) &&
+      _UVCHAN_EXCHANGE(&ring->_data_waiting, 0)) {
+    _uvchan_shm_queue_signal(queue->data_fd);
+  }
+#endif
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_shm_queue_pop(uvchan_shm_queue* queue, void* element) {
+  uvchan_shm_ring* ring;
+  size_t tail;
+
+  ring = queue->_ring;
+  tail = _UVCHAN_LOAD_RELAXED(&ring->_tail);
+
+  if (tail == queue->_cached_head) {
+    queue->_cached_head = _UVCHAN_LOAD_ACQUIRE(&ring->_head);
+    if (tail == queue->_cached_head) {
+      return UVCHAN_ERR_QUEUE_EMPTY;
+    }
+  }
+
+  _UVCHAN_COPY_ELEMENT(element, MEM_LOCATION(queue, tail),
+                       queue->_element_size);
+  _UVCHAN_STORE_RELEASE(&ring->_tail, tail + 1);
+
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  _UVCHAN_FENCE_SEQ_CST();
+  if (_UVCHAN_LOAD_RELAXED(&ring->_space_waiting) &&
+      _UVCHAN_EXCHANGE(&ring->_space_waiting, 0)) {
+    _uvchan_shm_queue_signal(queue->space_fd);
+  }
+#endif
+
+  return UVCHAN_ERR_SUCCESS;
+}
+
+uvchan_error_t uvchan_shm_queue_arm_pop(uvchan_shm_queue* queue) {
+  uvchan_shm_ring* ring;
+
+  ring = queue->_ring;
+
+  _UVCHAN_STORE_RELAXED(&ring->_data_waiting, 1);
+  _UVCHAN_FENCE_SEQ_CST();
+
+  if (_UVCHAN_LOAD_ACQUIRE(&ring->_head) !=
+      _UVCHAN_LOAD_RELAXED(&ring->_tail)) {
+    _UVCHAN_STORE_RELAXED(&ring->_data_waiting, 0);
+    return UVCHAN_ERR_SUCCESS;
+  }
+
+  if (uvchan_shm_queue_closed(queue)) {
+    return UVCHAN_ERR_CHANNEL_CLOSED;
+  }
+
+  return UVCHAN_ERR_QUEUE_EMPTY;
+}
+
+uvchan_error_t uvchan_shm_queue_arm_push(uvchan_shm_queue* queue) {
+  uvchan_shm_ring* ring;
+
+  ring = queue->_ring;
+
+  _UVCHAN_STORE_RELAXED(&ring->_space_waiting, 1);
+  _UVCHAN_FENCE_SEQ_CST();
+
+  if (uvchan_shm_queue_closed(queue)) {
+    return UVCHAN_ERR_CHANNEL_CLOSED;
+  }
+
+  if (_UVCHAN_LOAD_RELAXED(&ring->_head) -
+          _UVCHAN_LOAD_ACQUIRE(&ring->_tail) <
+      queue->_capacity) {
+    _UVCHAN_STORE_RELAXED(&ring->_space_waiting, 0);
+    return UVCHAN_ERR_SUCCESS;
+  }
+
+  return UVCHAN_ERR_QUEUE_FULL;
+}
+
+void uvchan_shm_queue_ack(int fd) {
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  uint64_t value;
+
+  // eventfd is non-blocking, a spurious wakeup just fails with EAGAIN
+  if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+    return;
+  }
+#endif
+}
+
+void uvchan_shm_queue_close(uvchan_shm_queue* queue) {
+  _UVCHAN_STORE_RELEASE(&queue->_ring->_closed, 1);
+
+#ifdef UVCHAN_HAVE_SHM_QUEUE
+  _uvchan_shm_queue_signal(queue->data_fd);
+  _uvchan_shm_queue_signal(queue->space_fd);
+#endif
+}
+
+int uvchan_shm_queue_closed(uvchan_shm_queue* queue) {
+  return _UVCHAN_LOAD_ACQUIRE(&queue->_ring->_closed);
+}
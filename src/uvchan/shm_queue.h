@@ -0,0 +1,184 @@
+#ifndef UVCHAN_SHM_QUEUE_H__
+#define UVCHAN_SHM_QUEUE_H__
+
+#include <stdlib.h>
+#include <uvchan/error.h>
+#include <uvchan/queue.h>
+
+/**
+ * @brief part of _uvchan_shm_queue living in shared memory
+ *
+ * Header is followed by the ring itself at #_uvchan_shm_ring#_buffer_offset
+ * bytes from start of mapping. Nothing in shared memory is a pointer,
+ * so each process may map it at a different address.
+ */
+typedef struct _uvchan_shm_ring {
+  size_t element_size;      /**< size of each item in queue in bytes */
+  size_t capacity_elements; /**< capacity of queue */
+  size_t _mask;             /**< @private */
+  size_t _buffer_offset;    /**< @private */
+  int _closed;              /**< @private */
+  char _pad0[kUvChanCacheLineSize - 4 * sizeof(size_t) -
+             sizeof(int)]; /**< @private */
+
+  size_t _head;         /**< @private written by producer */
+  int _space_waiting;   /**< @private producer waits on space_fd */
+  char _pad1[kUvChanCacheLineSize - sizeof(size_t) -
+             sizeof(int)]; /**< @private */
+
+  size_t _tail;        /**< @private written by consumer */
+  int _data_waiting;   /**< @private consumer waits on data_fd */
+  char _pad2[kUvChanCacheLineSize - sizeof(size_t) -
+             sizeof(int)]; /**< @private */
+} uvchan_shm_ring;
+
+/**
+ * @brief Models a FIFO queue shared between two processes
+ *
+ * uvchan_shm_queue is a sibling of _uvchan_queue whose ring lives in a
+ * memfd mapping, so that a producer and a consumer in two processes on
+ * the same host exchange items at memory speed. Same as _uvchan_queue
+ * it is safe for a single producer and a single consumer.
+ *
+ * Each side may wait for the other one through a pair of eventfds.
+ * A side which finds the queue empty (or full) arms it's wait with
+ * #uvchan_shm_queue_arm_pop (or #uvchan_shm_queue_arm_push) and then
+ * polls #_uvchan_shm_queue#data_fd (or #_uvchan_shm_queue#space_fd).
+ * The opposite side only writes an eventfd when a wait is armed, so
+ * no system call is made on the hot path while both sides keep up.
+ *
+ * Queue is created by #uvchan_shm_queue_init in one process, and it's
+ * three file descriptors are handed to the other process, either by
+ * fork or over a unix socket, which attaches with
+ * #uvchan_shm_queue_open.
+ *
+ * @see uvchan_shm_queue_init
+ * @see uvchan_shm_queue_open
+ * @see uvchan_shm_queue_push
+ * @see uvchan_shm_queue_pop
+ * @see uvchan_shm_queue_destroy
+ */
+typedef struct _uvchan_shm_queue {
+  uvchan_shm_ring* _ring; /**< @private */
+  char* _buffer;          /**< @private */
+  size_t _mapped_size;    /**< @private */
+  size_t _cached_head;    /**< @private */
+  size_t _cached_tail;    /**< @private */
+  size_t _element_size;   /**< @private checked copy of ring header */
+  size_t _capacity;       /**< @private checked copy of ring header */
+  size_t _mask;           /**< @private checked copy of ring header */
+  int mem_fd;             /**< memfd holding ring */
+  int data_fd;            /**< eventfd signalled when items become available */
+  int space_fd;           /**< eventfd signalled when room becomes available */
+} uvchan_shm_queue;
+
+/**
+ * @brief create a new queue in shared memory
+ *
+ * @param queue location of _uvchan_shm_queue instance to initialize.
+ * @param num_elements shows desired maximum capacity of queue.
+ * @param element_size shows size of each item in bytes.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_NOT_SUPPORTED if
+ * shared memory or eventfds are not available, in which case @p queue
+ * is left uninitialized.
+ *
+ * @see uvchan_shm_queue_destroy
+ */
+uvchan_error_t uvchan_shm_queue_init(uvchan_shm_queue* queue,
+                                     size_t num_elements,
+                                     size_t element_size);
+
+/**
+ * @brief attach to a queue created by another process
+ *
+ * @p mem_fd, @p data_fd and @p space_fd are file descriptors of a
+ * queue created by #uvchan_shm_queue_init. @p queue takes ownership
+ * of them and closes them in #uvchan_shm_queue_destroy. Header of ring
+ * is written by the other process, so it is checked against size of
+ * mapping and against @p element_size before ring is used, and only
+ * checked copies of it are used afterwards.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_NOT_SUPPORTED if
+ * mapping fails, #UVCHAN_ERR_INVALID_ARGUMENT if header does not
+ * describe a ring of @p element_size items fitting into mapping. In
+ * both cases @p queue is left uninitialized.
+ */
+uvchan_error_t uvchan_shm_queue_open(uvchan_shm_queue* queue, int mem_fd,
+                                     int data_fd, int space_fd,
+                                     size_t element_size);
+
+/**
+ * @brief unmap queue and close it's file descriptors
+ *
+ * Unlike #uvchan_queue_destroy, queue is not required to be empty,
+ * since the other process may still be using it. Shared memory is
+ * released once both processes have destroyed their queue.
+ */
+void uvchan_shm_queue_destroy(uvchan_shm_queue* queue);
+
+/**
+ * @brief push a new item to back of queue
+ *
+ * Signals #_uvchan_shm_queue#data_fd if consumer has armed it's wait.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_FULL if queue
+ * is full.
+ */
+uvchan_error_t uvchan_shm_queue_push(uvchan_shm_queue* queue,
+                                     const void* buffer);
+
+/**
+ * @brief pop an item from front of queue
+ *
+ * Signals #_uvchan_shm_queue#space_fd if producer has armed it's wait.
+ *
+ * @return zero if operation succeeds. #UVCHAN_ERR_QUEUE_EMPTY if
+ * queue is empty.
+ */
+uvchan_error_t uvchan_shm_queue_pop(uvchan_shm_queue* queue, void* buffer);
+
+/**
+ * @brief ask producer to signal #_uvchan_shm_queue#data_fd
+ *
+ * Called by consumer after finding queue empty.
+ *
+ * @return #UVCHAN_ERR_QUEUE_EMPTY if queue is still empty and caller
+ * should wait for data_fd to become readable. zero if items arrived
+ * meanwhile, or #UVCHAN_ERR_CHANNEL_CLOSED if queue is closed.
+ */
+uvchan_error_t uvchan_shm_queue_arm_pop(uvchan_shm_queue* queue);
+
+/**
+ * @brief ask consumer to signal #_uvchan_shm_queue#space_fd
+ *
+ * Called by producer after finding queue full.
+ *
+ * @return #UVCHAN_ERR_QUEUE_FULL if queue is still full and caller
+ * should wait for space_fd to become readable. zero if room became
+ * available meanwhile, or #UVCHAN_ERR_CHANNEL_CLOSED if queue is
+ * closed.
+ */
+uvchan_error_t uvchan_shm_queue_arm_push(uvchan_shm_queue* queue);
+
+/**
+ * @brief consume a signal on one of queue's eventfds
+ *
+ * @param fd #_uvchan_shm_queue#data_fd or #_uvchan_shm_queue#space_fd
+ * after it has been reported readable.
+ */
+void uvchan_shm_queue_ack(int fd);
+
+/**
+ * @brief mark queue as closed for both processes
+ *
+ * Both eventfds are signalled so that a waiting side notices.
+ */
+void uvchan_shm_queue_close(uvchan_shm_queue* queue);
+
+/**
+ * @brief tell whether either process has closed queue
+ */
+int uvchan_shm_queue_closed(uvchan_shm_queue* queue);
+
+#endif  // UVCHAN_SHM_QUEUE_H__
@@ -0,0 +1,316 @@
+#include <uvchan/alloc.h>
+#include <uvchan/atomic.h>
+#include <uvchan/stage.h>
+
+#include "./config.h"
+
+// per worker buffers are rounded up to this, so that every worker's
+// batch starts aligned
+#define kUvChanStageAlignment 16
+
+typedef struct _uvchan_stage_worker_t {
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t push_handle;
+  uv_work_t work;
+  uvchan_stage_t* stage;
+  char* inputs;
+  char* outputs;
+  size_t count;
+  size_t emitted;
+  size_t pushed;
+  size_t sequence;
+} uvchan_stage_worker_t;
+
+static void _uvchan_stage_pop(uvchan_stage_worker_t* worker);
+static void _uvchan_stage_push(uvchan_stage_worker_t* worker);
+
+void uvchan_stage_init(uv_loop_t* loop, uvchan_stage_t* stage,
+                       uvchan_t* input, uvchan_t* output, uvchan_stage_fn fn) {
+  stage->loop = loop;
+  stage->input = input;
+  stage->output = output;
+  stage->fn = fn;
+  stage->data = 0L;
+  stage->parallelism = kUvChanStageParallelism;
+  stage->batch_size = kUvChanStageBatchSize;
+  stage->close_output = 1;
+  stage->ordered = 0;
+  stage->_done_cb = 0L;
+  stage->_workers = 0L;
+  stage->_ready = 0L;
+  stage->_next_pop = 0;
+  stage->_next_push = 0;
+  stage->_running = 0;
+  stage->_closing = 0;
+  stage->_err = UVCHAN_ERR_SUCCESS;
+}
+
+static void _uvchan_stage_close_cb(uv_handle_t* handle) {
+  uvchan_stage_t* stage;
+
+  stage = ((uvchan_stage_worker_t*)((uvchan_handle_t*)handle)->data)->stage;
+  if (--stage->_closing > 0) {
+    return;
+  }
+
+  _uvchan_free(stage->_workers);
+  stage->_workers = 0L;
+  stage->_ready = 0L;
+  uvchan_unref(stage->input);
+  uvchan_unref(stage->output);
+
+  stage->_done_cb(stage, stage->_err);
+}
+
+// a worker stops once input is drained or anything failed, and the
+// last one to stop tears stage down
+static void _uvchan_stage_stop(uvchan_stage_worker_t* worker,
+                               uvchan_error_t err) {
+  uvchan_stage_t* stage;
+  uvchan_stage_worker_t* ready;
+  size_t i;
+
+  stage = worker->stage;
+  if (err != UVCHAN_ERR_SUCCESS && stage->_err == UVCHAN_ERR_SUCCESS) {
+    stage->_err = err;
+    // workers waiting on either channel give up right away, and so do
+    // ones holding results for their turn
+    uvchan_cancel(&stage->_cancel);
+    for (i = 0; stage->ordered && i < stage->parallelism; i++) {
+      ready = stage->_ready[i];
+      if (ready != 0L) {
+        stage->_ready[i] = 0L;
+        _uvchan_stage_stop(ready, UVCHAN_ERR_SUCCESS);
+      }
+    }
+  }
+
+  if (--stage->_running > 0) {
+    return;
+  }
+
+  if (stage->close_output) {
+    uvchan_close(stage->output);
+  }
+
+  stage->_closing = 2 * stage->parallelism;
+  for (i = 0; i < stage->parallelism; i++) {
+    uv_close((uv_handle_t*)&stage->_workers[i].pop_handle,
+             _uvchan_stage_close_cb);
+    uv_close((uv_handle_t*)&stage->_workers[i].push_handle,
+             _uvchan_stage_close_cb);
+  }
+}
+
+static void _uvchan_stage_work_cb(uv_work_t* work) {
+  uvchan_stage_worker_t* worker;
+  uvchan_stage_t* stage;
+  size_t in_size;
+  size_t out_size;
+  size_t i;
+
+  worker = (uvchan_stage_worker_t*)work->data;
+  stage = worker->stage;
+  in_size = _uvchan_element_size(stage->input);
+  out_size = _uvchan_element_size(stage->output);
+
+  worker->emitted = 0;
+  for (i = 0; i < worker->count; i++) {
+    if (stage->fn(worker->inputs + i * in_size,
+                  worker->outputs + worker->emitted * out_size,
+                  stage->data)) {
+      worker->emitted++;
+    }
+  }
+}
+
+static void _uvchan_stage_after_work_cb(uv_work_t* work, int status) {
+  uvchan_stage_worker_t* worker;
+  uvchan_stage_t* stage;
+
+  worker = (uvchan_stage_worker_t*)work->data;
+  stage = worker->stage;
+  worker->pushed = 0;
+
+  if (stage->_err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_stage_stop(worker, UVCHAN_ERR_SUCCESS);
+    return;
+  }
+
+  // batches in flight are numbered consecutively and there are never
+  // more of them than workers, so each has a slot of its own
+  if (stage->ordered && worker->sequence != stage->_next_push) {
+    stage->_ready[worker->sequence % stage->parallelism] = worker;
+    return;
+  }
+
+  _uvchan_stage_push(worker);
+}
+
+// hands turn to batch following the one just pushed, if it is done
+static void _uvchan_stage_release(uvchan_stage_t* stage) {
+  uvchan_stage_worker_t** slot;
+  uvchan_stage_worker_t* next;
+
+  stage->_next_push++;
+  slot = &stage->_ready[stage->_next_push % stage->parallelism];
+  next = *slot;
+
+  if (next == 0L || stage->_err != UVCHAN_ERR_SUCCESS) {
+    return;
+  }
+
+  *slot = 0L;
+  _uvchan_stage_push(next);
+}
+
+static void _uvchan_stage_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                 size_t count, uvchan_error_t err) {
+  uvchan_stage_worker_t* worker;
+
+  worker = (uvchan_stage_worker_t*)handle->data;
+
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED || err == UVCHAN_ERR_CANCELLED) {
+    _uvchan_stage_stop(worker, UVCHAN_ERR_SUCCESS);
+    return;
+  } else if (err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_stage_stop(worker, err);
+    return;
+  }
+
+  worker->count = count;
+  worker->sequence = worker->stage->_next_pop++;
+  uv_queue_work(worker->stage->loop, &worker->work, _uvchan_stage_work_cb,
+                _uvchan_stage_after_work_cb);
+}
+
+static void _uvchan_stage_push_cb(uvchan_handle_t* handle,
+                                  uvchan_error_t err) {
+  uvchan_stage_worker_t* worker;
+
+  worker = (uvchan_stage_worker_t*)handle->data;
+
+  if (err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_stage_stop(worker, err);
+    return;
+  }
+
+  worker->pushed++;
+  _uvchan_stage_push(worker);
+}
+
+static void _uvchan_stage_pop(uvchan_stage_worker_t* worker) {
+  if (worker->stage->_err != UVCHAN_ERR_SUCCESS) {
+    _uvchan_stage_stop(worker, UVCHAN_ERR_SUCCESS);
+    return;
+  }
+
+  uvchan_start_pop_batch(&worker->pop_handle, worker->inputs,
+                         worker->stage->batch_size, _uvchan_stage_pop_cb);
+}
+
+// results go straight into output channel while it has room and nobody
+// is queued before us, only the rest waits as a regular push
+static void _uvchan_stage_push(uvchan_stage_worker_t* worker) {
+  uvchan_stage_t* stage;
+  uvchan_t* output;
+  size_t out_size;
+  void* element;
+
+  stage = worker->stage;
+  output = stage->output;
+  out_size = _uvchan_element_size(output);
+
+  while (worker->pushed < worker->emitted) {
+    element = worker->outputs + worker->pushed * out_size;
+
+    if (_UVCHAN_LOAD_ACQUIRE(&output->closed)) {
+      _uvchan_stage_stop(worker, UVCHAN_ERR_CHANNEL_CLOSED);
+      return;
+    } else if (!_uvchan_waiter_idle(&output->push_waiters) ||
+               _uvchan_try_push(output, element) != UVCHAN_ERR_SUCCESS) {
+      uvchan_start_push(&worker->push_handle, element, _uvchan_stage_push_cb);
+      return;
+    }
+
+    worker->pushed++;
+  }
+
+  _uvchan_stage_pop(worker);
+  if (stage->ordered) {
+    _uvchan_stage_release(stage);
+  }
+}
+
+static size_t _uvchan_stage_round(size_t size) {
+  return (size + kUvChanStageAlignment - 1) & ~(kUvChanStageAlignment - 1);
+}
+
+uvchan_error_t uvchan_stage_start(uvchan_stage_t* stage, uvchan_stage_cb cb) {
+  uvchan_stage_worker_t* worker;
+  size_t inputs_size;
+  size_t outputs_size;
+  size_t workers_size;
+  size_t ready_size;
+  char* buffers;
+  size_t i;
+
+  if (stage->parallelism < 1 || stage->batch_size < 1) {
+    return UVCHAN_ERR_INVALID_ARGUMENT;
+  } else if ((stage->input->flags | stage->output->flags) &
+             UVCHAN_FLAG_BYTES) {
+    return UVCHAN_ERR_NOT_SUPPORTED;
+  }
+
+  inputs_size = _uvchan_stage_round(stage->batch_size *
+                                    _uvchan_element_size(stage->input));
+  outputs_size = _uvchan_stage_round(stage->batch_size *
+                                     _uvchan_element_size(stage->output));
+  workers_size =
+      _uvchan_stage_round(stage->parallelism * sizeof(uvchan_stage_worker_t));
+  ready_size = _uvchan_stage_round(stage->parallelism *
+                                   sizeof(uvchan_stage_worker_t*));
+
+  // workers, reorder slots and batches share a single allocation
+  stage->_workers = (uvchan_stage_worker_t*)_uvchan_malloc(
+      workers_size + ready_size +
+      stage->parallelism * (inputs_size + outputs_size));
+  if (stage->_workers == 0L) {
+    return UVCHAN_ERR_NO_MEMORY;
+  }
+
+  stage->_done_cb = cb;
+  stage->_running = stage->parallelism;
+  stage->_err = UVCHAN_ERR_SUCCESS;
+  stage->_ready =
+      (uvchan_stage_worker_t**)((char*)stage->_workers + workers_size);
+  stage->_next_pop = 0;
+  stage->_next_push = 0;
+  uvchan_cancel_init(&stage->_cancel);
+  uvchan_ref(stage->input);
+  uvchan_ref(stage->output);
+
+  buffers = (char*)stage->_ready + ready_size;
+  for (i = 0; i < stage->parallelism; i++) {
+    stage->_ready[i] = 0L;
+    worker = &stage->_workers[i];
+    worker->stage = stage;
+    worker->inputs = buffers;
+    worker->outputs = buffers + inputs_size;
+    worker->work.data = worker;
+    buffers += inputs_size + outputs_size;
+
+    uvchan_handle_init(stage->loop, &worker->pop_handle, stage->input);
+    uvchan_handle_init(stage->loop, &worker->push_handle, stage->output);
+    worker->pop_handle.data = worker;
+    worker->push_handle.data = worker;
+    uvchan_handle_set_cancel(&worker->pop_handle, &stage->_cancel);
+    uvchan_handle_set_cancel(&worker->push_handle, &stage->_cancel);
+  }
+
+  for (i = 0; i < stage->parallelism; i++) {
+    _uvchan_stage_pop(&stage->_workers[i]);
+  }
+
+  return UVCHAN_ERR_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#ifndef UVCHAN_STAGE_H__
+#define UVCHAN_STAGE_H__
+
+#include <uv.h>
+#include <uvchan/cancel.h>
+#include <uvchan/chan.h>
+
+/**
+ * @brief number of work requests a stage keeps in flight by default
+ */
+#define kUvChanStageParallelism 4
+
+/**
+ * @brief number of items a work request carries by default
+ */
+#define kUvChanStageBatchSize 64
+
+struct _uvchan_stage_t;
+struct _uvchan_stage_worker_t;
+
+/**
+ * @brief transform run on a worker thread for every item
+ *
+ * Reads an item of input channel from @p input and writes an item of
+ * output channel to @p output. Returning zero drops the item instead,
+ * so that the same function also filters. Called concurrently from
+ * several threads, with _uvchan_stage_t#data as @p data.
+ */
+typedef int (*uvchan_stage_fn)(const void* input, void* output, void* data);
+
+typedef void (*uvchan_stage_cb)(struct _uvchan_stage_t* stage,
+                                uvchan_error_t err);
+
+/**
+ * @brief Models a map/filter stage between two channels
+ *
+ * uvchan_stage_t pops batches of items from an input channel, runs
+ * #uvchan_stage_fn over each batch on the libuv threadpool, and pushes
+ * results to an output channel. Up to _uvchan_stage_t#parallelism
+ * batches are transformed at once, so a single loop keeps as many
+ * threads busy. A batch is not popped before results of the previous
+ * batch of the same worker are pushed, so a full output channel holds
+ * back the stage instead of piling up results.
+ *
+ * Results of different batches may reach output channel in any order,
+ * unless _uvchan_stage_t#ordered is set. Batches are then numbered in
+ * the order they were popped, and a batch finished ahead of an earlier
+ * one keeps its results until all earlier batches were pushed. Held
+ * results stay in the batch buffer of their worker, which does not pop
+ * again meanwhile, so reorder buffer never grows beyond
+ * _uvchan_stage_t#parallelism batches, however slow a single item is.
+ *
+ * Stage ends once input channel is closed and drained, or output
+ * channel is found closed when pushing results. Output channel is then
+ * closed if _uvchan_stage_t#close_output is set, and the callback
+ * given to #uvchan_stage_start is called once stage releases its
+ * resources.
+ *
+ * @code{.c}
+ * uvchan_stage_t stage;
+ *
+ * uvchan_stage_init(loop, &stage, input, output, square);
+ * stage.parallelism = 8;
+ * uvchan_stage_start(&stage, on_stage_done);
+ * @endcode
+ *
+ * @see uvchan_stage_init
+ * @see uvchan_stage_start
+ */
+typedef struct _uvchan_stage_t {
+  uv_loop_t* loop;
+  uvchan_t* input;
+  uvchan_t* output;
+  uvchan_stage_fn fn;
+  void* data;
+
+  size_t parallelism; /**< number of batches transformed at once */
+  size_t batch_size;  /**< number of items popped per batch */
+  int close_output;   /**< close output channel once stage ends */
+  int ordered;        /**< push results in input order */
+
+  uvchan_stage_cb _done_cb;                /**< @private */
+  struct _uvchan_stage_worker_t* _workers; /**< @private */
+  struct _uvchan_stage_worker_t** _ready;  /**< @private */
+  size_t _next_pop;                        /**< @private */
+  size_t _next_push;                       /**< @private */
+  size_t _running;                         /**< @private */
+  size_t _closing;                         /**< @private */
+  uvchan_error_t _err;                     /**< @private */
+  uvchan_cancel_t _cancel;                 /**< @private */
+} uvchan_stage_t;
+
+/**
+ * @brief initialize a stage running @p fn from @p input to @p output
+ *
+ * Stage uses #kUvChanStageParallelism and #kUvChanStageBatchSize, and
+ * closes @p output once it ends, unless changed before
+ * #uvchan_stage_start.
+ */
+void uvchan_stage_init(uv_loop_t* loop, uvchan_stage_t* stage,
+                       uvchan_t* input, uvchan_t* output, uvchan_stage_fn fn);
+
+/**
+ * @brief start moving items through @p stage
+ *
+ * Stage holds a reference to both channels until @p cb is called.
+ * @p cb receives #UVCHAN_ERR_SUCCESS once input channel was drained,
+ * or the error which stopped stage, like #UVCHAN_ERR_CHANNEL_CLOSED
+ * when output channel was closed first.
+ *
+ * @return #UVCHAN_ERR_INVALID_ARGUMENT if parallelism or batch size is
+ * zero, #UVCHAN_ERR_NOT_SUPPORTED if either channel is a bytes channel,
+ * #UVCHAN_ERR_NO_MEMORY if buffers could not be allocated.
+ */
+uvchan_error_t uvchan_stage_start(uvchan_stage_t* stage, uvchan_stage_cb cb);
+
+#endif  // UVCHAN_STAGE_H__
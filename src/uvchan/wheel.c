@@ -0,0 +1,175 @@
+#include <uvchan/wheel.h>
+
+#include <assert.h>
+
+#include "./config.h"
+
+#define _UVCHAN_WHEEL_MASK (kUvChanWheelSlots - 1)
+
+static void _uvchan_deadline_unlink(uvchan_deadline_t* deadline) {
+  deadline->prev->next = deadline->next;
+  deadline->next->prev = deadline->prev;
+  deadline->next = 0L;
+  deadline->prev = 0L;
+}
+
+static void _uvchan_deadline_append(uvchan_deadline_t* list,
+                                    uvchan_deadline_t* deadline) {
+  deadline->next = list;
+  deadline->prev = list->prev;
+  list->prev->next = deadline;
+  list->prev = deadline;
+}
+
+// slot is moved into a local list first, so that every deadline is
+// visited once no matter what callbacks disarm or arm meanwhile.
+// deadlines armed by a callback land in slot and wait for their turn.
+static void _uvchan_wheel_expire_slot(uvchan_wheel_t* wheel,
+                                      uvchan_deadline_t* slot,
+                                      uint64_t tick) {
+  uvchan_deadline_t pending;
+  uvchan_deadline_t* deadline;
+
+  if (slot->next == slot) {
+    return;
+  }
+
+  pending.next = slot->next;
+  pending.prev = slot->prev;
+  pending.next->prev = &pending;
+  pending.prev->next = &pending;
+  slot->next = slot;
+  slot->prev = slot;
+
+  while (pending.next != &pending) {
+    deadline = pending.next;
+    _uvchan_deadline_unlink(deadline);
+
+    if (deadline->expires > tick) {
+      _uvchan_deadline_append(slot, deadline);
+      continue;
+    }
+
+    wheel->count--;
+    deadline->expired = 1;
+    // callback may disarm any deadline still pending, which unlinks it
+    // from local list just as well
+    deadline->expire_cb(deadline);
+  }
+}
+
+#ifdef LIBUV_0X
+static void _uvchan_wheel_timer_cb(uv_timer_t* timer, int status) {
+#elif LIBUV_1X
+static void _uvchan_wheel_timer_cb(uv_timer_t* timer) {
+#else
+#error callback not defined for unknown version of libuv
+#endif
+  uvchan_wheel_t* wheel;
+  uint64_t now;
+  uint64_t ticks;
+
+#ifdef LIBUV_0X
+  ((void)status);
+#endif
+
+  wheel = (uvchan_wheel_t*)timer;
+  now = uv_now(timer->loop) / wheel->tick_ms;
+
+  // a loop stalled for more than a full turn visits every slot once
+  ticks = now - wheel->current;
+  if (ticks > kUvChanWheelSlots) {
+    ticks = kUvChanWheelSlots;
+  }
+  while (ticks-- > 0 && wheel->count > 0) {
+    wheel->current++;
+    _uvchan_wheel_expire_slot(
+        wheel, &wheel->slots[wheel->current & _UVCHAN_WHEEL_MASK], now);
+  }
+  wheel->current = now;
+
+  if (wheel->count == 0) {
+    uv_timer_stop(&wheel->timer);
+  }
+}
+
+static void _uvchan_wheel_link(uvchan_wheel_t* wheel,
+                               uvchan_deadline_t* deadline) {
+  uvchan_deadline_t* slot;
+
+  // timer keeps running until a tick finds wheel empty, so that
+  // cancelling and arming deadlines never touches loop's timer heap
+  if (!uv_is_active((uv_handle_t*)&wheel->timer)) {
+    wheel->current = uv_now(wheel->timer.loop) / wheel->tick_ms;
+    uv_timer_start(&wheel->timer, _uvchan_wheel_timer_cb, wheel->tick_ms,
+                   wheel->tick_ms);
+  }
+
+  if (deadline->expires <= wheel->current) {
+    deadline->expires = wheel->current + 1;
+  }
+
+  wheel->count++;
+  slot = &wheel->slots[deadline->expires & _UVCHAN_WHEEL_MASK];
+  _uvchan_deadline_append(slot, deadline);
+}
+
+void uvchan_wheel_init(uv_loop_t* loop, uvchan_wheel_t* wheel,
+                       uint64_t tick_ms) {
+  int index;
+
+  uv_timer_init(loop, &wheel->timer);
+  wheel->tick_ms = tick_ms == 0 ? kUvChanWheelTick : tick_ms;
+  wheel->current = 0;
+  wheel->count = 0;
+  for (index = 0; index < kUvChanWheelSlots; index++) {
+    wheel->slots[index].next = &wheel->slots[index];
+    wheel->slots[index].prev = &wheel->slots[index];
+  }
+}
+
+void uvchan_wheel_close(uvchan_wheel_t* wheel, uv_close_cb close_cb) {
+  assert(wheel->count == 0);
+  uv_close((uv_handle_t*)&wheel->timer, close_cb);
+}
+
+void uvchan_deadline_init(uvchan_deadline_t* deadline,
+                          uvchan_deadline_cb expire_cb) {
+  deadline->next = 0L;
+  deadline->prev = 0L;
+  deadline->wheel = 0L;
+  deadline->timeout = 0;
+  deadline->expires = 0;
+  deadline->expired = 0;
+  deadline->expire_cb = expire_cb;
+}
+
+void uvchan_deadline_arm(uvchan_deadline_t* deadline, uvchan_wheel_t* wheel,
+                         uint64_t timeout_ms) {
+  uvchan_deadline_disarm(deadline);
+  deadline->wheel = wheel;
+  deadline->expired = 0;
+
+  // rounded up, so that deadline never fires before timeout passed
+  deadline->expires =
+      (uv_now(wheel->timer.loop) + timeout_ms + wheel->tick_ms - 1) /
+      wheel->tick_ms;
+  _uvchan_wheel_link(wheel, deadline);
+}
+
+void uvchan_deadline_disarm(uvchan_deadline_t* deadline) {
+  if (deadline->next == 0L) {
+    return;
+  }
+
+  _uvchan_deadline_unlink(deadline);
+  deadline->wheel->count--;
+}
+
+void uvchan_deadline_rearm(uvchan_deadline_t* deadline) {
+  if (deadline->wheel == 0L || deadline->expired || deadline->next != 0L) {
+    return;
+  }
+
+  _uvchan_wheel_link(deadline->wheel, deadline);
+}
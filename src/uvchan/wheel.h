@@ -0,0 +1,111 @@
+#ifndef UVCHAN_WHEEL_H__
+#define UVCHAN_WHEEL_H__
+
+#include <uv.h>
+
+/**
+ * @brief number of slots of a _uvchan_wheel_t, a power of two
+ *
+ * Deadlines further away than this many ticks share slots with closer
+ * ones, and simply stay in their slot until wheel comes around again.
+ */
+#define kUvChanWheelSlots 256
+
+/**
+ * @brief tick length used when caller does not specify one, in ms
+ */
+#define kUvChanWheelTick 10
+
+struct _uvchan_wheel_t;
+struct _uvchan_deadline_t;
+
+typedef void (*uvchan_deadline_cb)(struct _uvchan_deadline_t* deadline);
+
+/**
+ * @brief a point in time something gives up waiting at
+ *
+ * Deadline is linked into slot of _uvchan_wheel_t it expires in, so
+ * that arming and disarming it is O(1) regardless of number of
+ * pending deadlines.
+ */
+typedef struct _uvchan_deadline_t {
+  struct _uvchan_deadline_t* next; /**< @private */
+  struct _uvchan_deadline_t* prev; /**< @private */
+  struct _uvchan_wheel_t* wheel;   /**< wheel deadline counts on */
+  uint64_t timeout;                /**< @private requested timeout in ms */
+  uint64_t expires;                /**< @private tick it expires at */
+  int expired;                     /**< set once deadline passed */
+  uvchan_deadline_cb expire_cb;    /**< @private */
+} uvchan_deadline_t;
+
+/**
+ * @brief Models a hashed timer wheel
+ *
+ * uvchan_wheel_t coalesces any number of deadlines of a loop behind a
+ * single uv_timer_t. Time is cut into ticks of _uvchan_wheel_t#tick_ms
+ * and each deadline is hashed by its expiry tick into one of
+ * #kUvChanWheelSlots circular lists. Timer only runs while some
+ * deadline is armed, and on each tick walks the slots that came due,
+ * so a deadline fires up to one tick late but never early.
+ *
+ * A wheel belongs to a single loop and is not threadsafe.
+ *
+ * @see uvchan_wheel_init
+ * @see uvchan_deadline_arm
+ * @see uvchan_deadline_disarm
+ * @see uvchan_wheel_close
+ */
+typedef struct _uvchan_wheel_t {
+  uv_timer_t timer;
+
+  uint64_t tick_ms; /**< length of a tick in ms */
+  uint64_t current; /**< @private last tick processed */
+  size_t count;     /**< number of armed deadlines */
+  uvchan_deadline_t slots[kUvChanWheelSlots]; /**< @private */
+} uvchan_wheel_t;
+
+/**
+ * @brief initialize a wheel ticking every @p tick_ms on @p loop
+ *
+ * Zero @p tick_ms selects #kUvChanWheelTick.
+ */
+void uvchan_wheel_init(uv_loop_t* loop, uvchan_wheel_t* wheel,
+                       uint64_t tick_ms);
+
+/**
+ * @brief close timer of @p wheel
+ *
+ * No deadline may be armed on @p wheel. @p close_cb receives wheel
+ * once it may be released.
+ */
+void uvchan_wheel_close(uvchan_wheel_t* wheel, uv_close_cb close_cb);
+
+void uvchan_deadline_init(uvchan_deadline_t* deadline,
+                          uvchan_deadline_cb expire_cb);
+
+/**
+ * @brief arm @p deadline to expire @p timeout_ms from now
+ *
+ * Once deadline passes it is disarmed, _uvchan_deadline_t#expired is
+ * set and expire callback given to #uvchan_deadline_init is called.
+ */
+void uvchan_deadline_arm(uvchan_deadline_t* deadline, uvchan_wheel_t* wheel,
+                         uint64_t timeout_ms);
+
+/**
+ * @brief take @p deadline off its wheel
+ *
+ * Deadline keeps its expiry, so that #uvchan_deadline_rearm puts it
+ * back to expire at same point in time. Does nothing if deadline is
+ * not armed.
+ */
+void uvchan_deadline_disarm(uvchan_deadline_t* deadline);
+
+/**
+ * @brief put a disarmed deadline back on its wheel
+ *
+ * Does nothing if deadline was never armed or already expired.
+ */
+void uvchan_deadline_rearm(uvchan_deadline_t* deadline);
+
+#endif  // UVCHAN_WHEEL_H__
@@ -0,0 +1,184 @@
+#include <testing.h>
+#include <uvchan/alloc.h>
+#include <uvchan/arena.h>
+#include <uvchan/chan.h>
+#include <uvchan/pool.h>
+
+static int _live_blocks;
+// number of allocations left to succeed, negative for no limit
+static int _allocations_left = -1;
+
+static int _test_allocation_fails(void) {
+  if (_allocations_left == 0) {
+    return 1;
+  } else if (_allocations_left > 0) {
+    _allocations_left--;
+  }
+
+  return 0;
+}
+
+static void* _test_malloc(size_t size) {
+  if (_test_allocation_fails()) {
+    return NULL;
+  }
+  _live_blocks++;
+  return malloc(size);
+}
+
+static void* _test_realloc(void* ptr, size_t size) {
+  if (_test_allocation_fails()) {
+    return NULL;
+  }
+  if (ptr == NULL) {
+    _live_blocks++;
+  }
+  return realloc(ptr, size);
+}
+
+static void* _test_calloc(size_t count, size_t size) {
+  if (_test_allocation_fails()) {
+    return NULL;
+  }
+  _live_blocks++;
+  return calloc(count, size);
+}
+
+static void _test_free(void* ptr) {
+  if (ptr != NULL) {
+    _live_blocks--;
+  }
+  free(ptr);
+}
+
+void test_replace_allocator_should_reject_null(void) {
+  T_CMPINT(uvchan_replace_allocator(_test_malloc, _test_realloc, NULL,
+                                    _test_free),
+           ==, UVCHAN_ERR_INVALID_ARGUMENT);
+}
+
+void test_channels_should_allocate_through_replaced_allocator(void) {
+  uvchan_t* chan;
+
+  T_OK(uvchan_replace_allocator(_test_malloc, _test_realloc, _test_calloc,
+                                _test_free));
+  _live_blocks = 0;
+
+  chan = uvchan_new_ex(4096, sizeof(int), 0);
+  T_CMPINT(_live_blocks, >, 0);
+  uvchan_unref(chan);
+  T_CMPINT(_live_blocks, ==, 0);
+
+  chan = uvchan_new_ex(16, sizeof(int), UVCHAN_FLAG_UNBOUNDED);
+  T_CMPINT(_live_blocks, >, 0);
+  uvchan_unref(chan);
+  T_CMPINT(_live_blocks, ==, 0);
+}
+
+void test_arena_should_release_channels_at_once(void) {
+  uvchan_arena_t* arena;
+  uvchan_t* channels[64];
+  int value;
+  int i;
+
+  T_OK(uvchan_replace_allocator(_test_malloc, _test_realloc, _test_calloc,
+                                _test_free));
+  _live_blocks = 0;
+
+  arena = uvchan_arena_new(0);
+  for (i = 0; i < 64; i++) {
+    channels[i] = uvchan_new_arena(arena, 4, sizeof(int));
+    T_OK(uvchan_queue_push(&channels[i]->queue, &i));
+  }
+
+  // a handful of chunks back all of channels
+  T_CMPINT(_live_blocks, <, 8);
+  T_CMPINT((int)arena->allocated, >=, 64 * (int)sizeof(uvchan_t));
+
+  for (i = 0; i < 64; i++) {
+    T_OK(uvchan_queue_pop(&channels[i]->queue, &value));
+    T_CMPINT(value, ==, i);
+  }
+
+  // no unref needed, whole graph goes away with arena
+  uvchan_arena_delete(arena);
+  T_CMPINT(_live_blocks, ==, 0);
+}
+
+void test_arena_should_serve_oversized_blocks(void) {
+  uvchan_arena_t* arena;
+  char* small;
+  char* large;
+  char* next;
+
+  arena = uvchan_arena_new(256);
+  small = (char*)uvchan_arena_alloc(arena, 8);
+  large = (char*)uvchan_arena_alloc(arena, 4096);
+  next = (char*)uvchan_arena_alloc(arena, 8);
+
+  // small blocks keep bumping same chunk around an oversized one
+  T_CMPINT((int)(next - small), ==, kUvChanArenaAlignment);
+  T_TRUE(large != 0L);
+  T_CMPINT((int)(((size_t)large) % kUvChanArenaAlignment), ==, 0);
+
+  uvchan_arena_delete(arena);
+}
+
+static void _test_new_should_fail_cleanly(unsigned int flags,
+                                          int allocations) {
+  _live_blocks = 0;
+  _allocations_left = allocations;
+  T_TRUE(uvchan_new_ex(4096, sizeof(int), flags) == NULL);
+  _allocations_left = -1;
+  T_CMPINT(_live_blocks, ==, 0);
+}
+
+void test_constructors_should_return_null_when_out_of_memory(void) {
+  uvchan_pool_t* pool;
+  uvchan_arena_t* arena;
+  uvchan_t* chan;
+
+  T_OK(uvchan_replace_allocator(_test_malloc, _test_realloc, _test_calloc,
+                                _test_free));
+
+  // channel itself, then its ring, can not be allocated
+  _test_new_should_fail_cleanly(0, 0);
+  _test_new_should_fail_cleanly(0, 1);
+  _test_new_should_fail_cleanly(UVCHAN_FLAG_MPMC, 0);
+  _test_new_should_fail_cleanly(UVCHAN_FLAG_MPMC, 1);
+  _test_new_should_fail_cleanly(UVCHAN_FLAG_UNBOUNDED, 0);
+  _test_new_should_fail_cleanly(UVCHAN_FLAG_UNBOUNDED, 1);
+
+  _live_blocks = 0;
+  _allocations_left = 1;
+  T_TRUE(uvchan_new_bytes(4096) == NULL);
+  _allocations_left = -1;
+  T_CMPINT(_live_blocks, ==, 0);
+
+  pool = uvchan_pool_new();
+  arena = uvchan_arena_new(0);
+  _allocations_left = 0;
+  T_TRUE(uvchan_new_pooled(pool, 4, sizeof(int)) == NULL);
+  T_TRUE(uvchan_new_arena(arena, 4, sizeof(int)) == NULL);
+  _allocations_left = -1;
+  uvchan_arena_delete(arena);
+  uvchan_pool_delete(pool);
+
+  chan = uvchan_new_ex(4, sizeof(int), UVCHAN_FLAG_THREADSAFE);
+  _allocations_left = 0;
+  T_CMPINT(uvchan_attach(chan, uv_default_loop()), ==,
+           UVCHAN_ERR_NO_MEMORY);
+  _allocations_left = -1;
+  T_CMPINT(chan->reference_count, ==, 1);
+  uvchan_unref(chan);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_replace_allocator_should_reject_null);
+  T_ADD(test_channels_should_allocate_through_replaced_allocator);
+  T_ADD(test_arena_should_release_channels_at_once);
+  T_ADD(test_arena_should_serve_oversized_blocks);
+  T_ADD(test_constructors_should_return_null_when_out_of_memory);
+
+  return T_RUN(argc, argv);
+}
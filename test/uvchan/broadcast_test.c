@@ -0,0 +1,277 @@
+#include <testing.h>
+#include <uvchan/broadcast.h>
+
+#include <stdlib.h>
+#include "./config.h"
+
+typedef struct _publisher_t {
+  int value;
+  int total;
+  int published;
+} publisher_t;
+
+typedef struct _subscriber_t {
+  int received;
+  long sum;
+  int last;
+  int in_order;
+  int done;
+  uvchan_error_t err;
+} subscriber_t;
+
+uv_loop_t* make_loop(void);
+void free_loop(uv_loop_t* loop);
+
+// publishes values 0 to total - 1 one after another, then closes
+static void _test_push_cb(uvchan_broadcast_handle_t* handle,
+                          uvchan_error_t err) {
+  publisher_t* publisher;
+
+  publisher = (publisher_t*)handle->data;
+  T_OK(err);
+  publisher->published++;
+
+  if (publisher->published == publisher->total) {
+    uvchan_broadcast_close(handle->bc);
+    return;
+  }
+
+  publisher->value = publisher->published;
+  uvchan_broadcast_start_push(handle, &publisher->value, _test_push_cb);
+}
+
+static void _test_publish(uvchan_broadcast_handle_t* handle,
+                          publisher_t* publisher, int total) {
+  publisher->value = 0;
+  publisher->total = total;
+  publisher->published = 0;
+  handle->data = publisher;
+
+  uvchan_broadcast_start_push(handle, &publisher->value, _test_push_cb);
+}
+
+static void _test_read_cb(uvchan_broadcast_handle_t* handle,
+                          const void* item, uvchan_error_t err) {
+  subscriber_t* subscriber;
+
+  subscriber = (subscriber_t*)handle->data;
+  if (err != UVCHAN_ERR_SUCCESS) {
+    T_TRUE(item == NULL);
+    subscriber->done++;
+    subscriber->err = err;
+    return;
+  }
+
+  if (*(const int*)item <= subscriber->last) {
+    subscriber->in_order = 0;
+  }
+  subscriber->last = *(const int*)item;
+  subscriber->received++;
+  subscriber->sum += *(const int*)item;
+}
+
+static void _test_subscribe(uv_loop_t* loop,
+                            uvchan_broadcast_handle_t* handle,
+                            uvchan_broadcast_t* bc, subscriber_t* subscriber) {
+  subscriber->received = 0;
+  subscriber->sum = 0;
+  subscriber->last = -1;
+  subscriber->in_order = 1;
+  subscriber->done = 0;
+  subscriber->err = UVCHAN_ERR_SUCCESS;
+
+  uvchan_broadcast_handle_init(loop, handle, bc);
+  handle->data = subscriber;
+  uvchan_broadcast_subscribe(handle);
+}
+
+void test_broadcast_should_deliver_every_item_to_every_subscriber(void) {
+  uv_loop_t* loop;
+  uvchan_broadcast_t* bc;
+  uvchan_broadcast_handle_t push_handle;
+  uvchan_broadcast_handle_t handles[3];
+  subscriber_t subscribers[3];
+  publisher_t publisher;
+  int i;
+
+  loop = make_loop();
+  bc = uvchan_broadcast_new(4, sizeof(int));
+
+  for (i = 0; i < 3; i++) {
+    _test_subscribe(loop, &handles[i], bc, &subscribers[i]);
+    uvchan_broadcast_read_start(&handles[i], _test_read_cb);
+  }
+
+  uvchan_broadcast_handle_init(loop, &push_handle, bc);
+  _test_publish(&push_handle, &publisher, 100);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(publisher.published, ==, 100);
+  for (i = 0; i < 3; i++) {
+    T_CMPINT(subscribers[i].received, ==, 100);
+    T_CMPINT(subscribers[i].sum, ==, 4950);
+    T_TRUE(subscribers[i].in_order);
+    T_CMPINT(subscribers[i].done, ==, 1);
+    T_CMPINT(subscribers[i].err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+    T_CMPINT(handles[i].dropped, ==, 0);
+
+    uvchan_broadcast_unsubscribe(&handles[i]);
+    uv_close((uv_handle_t*)&handles[i], NULL);
+  }
+
+  T_CMPINT(bc->reference_count, ==, 1);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_broadcast_unref(bc);
+  free_loop(loop);
+}
+
+void test_broadcast_should_wait_for_slowest_subscriber(void) {
+  uv_loop_t* loop;
+  uvchan_broadcast_t* bc;
+  uvchan_broadcast_handle_t push_handle;
+  uvchan_broadcast_handle_t handle;
+  subscriber_t subscriber;
+  publisher_t publisher;
+
+  loop = make_loop();
+  bc = uvchan_broadcast_new(4, sizeof(int));
+  _test_subscribe(loop, &handle, bc, &subscriber);
+
+  uvchan_broadcast_handle_init(loop, &push_handle, bc);
+  _test_publish(&push_handle, &publisher, 10);
+
+  // publisher parks once ring is full, leaving nothing to run
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(publisher.published, ==, 4);
+
+  uvchan_broadcast_read_start(&handle, _test_read_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(publisher.published, ==, 10);
+  T_CMPINT(subscriber.received, ==, 10);
+  T_TRUE(subscriber.in_order);
+  T_CMPINT(subscriber.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+
+  uvchan_broadcast_unsubscribe(&handle);
+  uv_close((uv_handle_t*)&handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_broadcast_unref(bc);
+  free_loop(loop);
+}
+
+void test_broadcast_should_drop_items_of_lagging_subscriber(void) {
+  uv_loop_t* loop;
+  uvchan_broadcast_t* bc;
+  uvchan_broadcast_handle_t push_handle;
+  uvchan_broadcast_handle_t handle;
+  subscriber_t subscriber;
+  publisher_t publisher;
+
+  loop = make_loop();
+  bc = uvchan_broadcast_new(4, sizeof(int));
+  bc->overflow = UVCHAN_BROADCAST_DROP;
+  _test_subscribe(loop, &handle, bc, &subscriber);
+
+  uvchan_broadcast_handle_init(loop, &push_handle, bc);
+  _test_publish(&push_handle, &publisher, 10);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(publisher.published, ==, 10);
+  T_CMPINT(handle.dropped, ==, 6);
+
+  // only the last ring of items is left
+  uvchan_broadcast_read_start(&handle, _test_read_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(subscriber.received, ==, 4);
+  T_CMPINT(subscriber.sum, ==, 6 + 7 + 8 + 9);
+  T_CMPINT(subscriber.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+
+  uvchan_broadcast_unsubscribe(&handle);
+  uv_close((uv_handle_t*)&handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_broadcast_unref(bc);
+  free_loop(loop);
+}
+
+void test_broadcast_should_detach_lagging_subscriber(void) {
+  uv_loop_t* loop;
+  uvchan_broadcast_t* bc;
+  uvchan_broadcast_handle_t push_handle;
+  uvchan_broadcast_handle_t fast_handle;
+  uvchan_broadcast_handle_t slow_handle;
+  subscriber_t fast;
+  subscriber_t slow;
+  publisher_t publisher;
+
+  loop = make_loop();
+  bc = uvchan_broadcast_new(4, sizeof(int));
+  bc->overflow = UVCHAN_BROADCAST_DETACH;
+  _test_subscribe(loop, &fast_handle, bc, &fast);
+  _test_subscribe(loop, &slow_handle, bc, &slow);
+  uvchan_broadcast_read_start(&fast_handle, _test_read_cb);
+
+  uvchan_broadcast_handle_init(loop, &push_handle, bc);
+  _test_publish(&push_handle, &publisher, 10);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(publisher.published, ==, 10);
+  T_CMPINT(fast.received, ==, 10);
+  T_CMPINT(fast.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+
+  // detached subscriber learns about it once it reads
+  uvchan_broadcast_read_start(&slow_handle, _test_read_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(slow.received, ==, 0);
+  T_CMPINT(slow.done, ==, 1);
+  T_CMPINT(slow.err, ==, UVCHAN_ERR_LAGGED);
+
+  uvchan_broadcast_unsubscribe(&fast_handle);
+  uvchan_broadcast_unsubscribe(&slow_handle);
+  T_CMPINT(bc->reference_count, ==, 1);
+  uv_close((uv_handle_t*)&fast_handle, NULL);
+  uv_close((uv_handle_t*)&slow_handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_broadcast_unref(bc);
+  free_loop(loop);
+}
+
+uv_loop_t* make_loop(void) {
+  uv_loop_t* loop;
+
+#ifdef LIBUV_0X
+  loop = uv_default_loop();
+#elif LIBUV_1X
+  loop = (uv_loop_t*)malloc(sizeof(uv_loop_t));
+  uv_loop_init(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+
+  return loop;
+}
+
+void free_loop(uv_loop_t* loop) {
+#ifdef LIBUV_0X
+#elif LIBUV_1X
+  uv_loop_close(loop);
+  free(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_broadcast_should_deliver_every_item_to_every_subscriber);
+  T_ADD(test_broadcast_should_wait_for_slowest_subscriber);
+  T_ADD(test_broadcast_should_drop_items_of_lagging_subscriber);
+  T_ADD(test_broadcast_should_detach_lagging_subscriber);
+
+  return T_RUN(argc, argv);
+}
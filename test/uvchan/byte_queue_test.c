@@ -0,0 +1,146 @@
+#include <string.h>
+#include <testing.h>
+#include <uvchan/byte_queue.h>
+
+void test_pop_should_not_read_from_empty(void) {
+  uvchan_byte_queue q;
+  char buffer[16];
+  size_t length;
+
+  uvchan_byte_queue_init(&q, 256);
+  T_CMPINT(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length), ==,
+           UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_byte_queue_destroy(&q);
+}
+
+void test_push_pop_mixed_sizes(void) {
+  uvchan_byte_queue q;
+  char message[100];
+  char buffer[100];
+  size_t length;
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    message[i] = (char)i;
+  }
+
+  uvchan_byte_queue_init(&q, 1024);
+
+  T_OK(uvchan_byte_queue_push(&q, message, 1));
+  T_OK(uvchan_byte_queue_push(&q, message, 0));
+  T_OK(uvchan_byte_queue_push(&q, message, 100));
+  T_OK(uvchan_byte_queue_push(&q, message, 13));
+
+  T_OK(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length));
+  T_CMPINT((int)length, ==, 1);
+  T_OK(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length));
+  T_CMPINT((int)length, ==, 0);
+  T_OK(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length));
+  T_CMPINT((int)length, ==, 100);
+  T_TRUE(memcmp(buffer, message, 100) == 0);
+  T_OK(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length));
+  T_CMPINT((int)length, ==, 13);
+  T_TRUE(memcmp(buffer, message, 13) == 0);
+
+  uvchan_byte_queue_destroy(&q);
+}
+
+void test_messages_should_be_packed(void) {
+  uvchan_byte_queue q;
+  char message[8];
+  size_t length;
+  int count;
+
+  memset(message, 'x', sizeof(message));
+  uvchan_byte_queue_init(&q, 256);
+
+  // each message takes 8 bytes of payload and 8 bytes of prefix
+  count = 0;
+  while (uvchan_byte_queue_push(&q, message, sizeof(message)) ==
+         UVCHAN_ERR_SUCCESS) {
+    count++;
+  }
+  T_CMPINT(count, ==, 16);
+
+  while (count > 0) {
+    T_OK(uvchan_byte_queue_pop(&q, message, sizeof(message), &length));
+    count--;
+  }
+
+  uvchan_byte_queue_destroy(&q);
+}
+
+void test_pop_should_keep_message_larger_than_buffer(void) {
+  uvchan_byte_queue q;
+  char message[32];
+  char buffer[32];
+  size_t length;
+
+  memset(message, 'y', sizeof(message));
+  uvchan_byte_queue_init(&q, 256);
+
+  T_OK(uvchan_byte_queue_push(&q, message, sizeof(message)));
+  T_CMPINT(uvchan_byte_queue_pop(&q, buffer, 16, &length), ==,
+           UVCHAN_ERR_MESSAGE_TOO_LARGE);
+  T_CMPINT((int)length, ==, 32);
+  T_OK(uvchan_byte_queue_pop(&q, buffer, sizeof(buffer), &length));
+  T_TRUE(memcmp(buffer, message, sizeof(message)) == 0);
+
+  uvchan_byte_queue_destroy(&q);
+}
+
+void test_push_should_reject_oversized_message(void) {
+  uvchan_byte_queue q;
+  char message[256];
+  const void* data;
+  size_t length;
+
+  memset(message, 'z', sizeof(message));
+  uvchan_byte_queue_init(&q, 256);
+  T_CMPINT(uvchan_byte_queue_push(&q, message, q.max_message_size + 1), ==,
+           UVCHAN_ERR_MESSAGE_TOO_LARGE);
+  T_OK(uvchan_byte_queue_push(&q, message, q.max_message_size));
+  T_OK(uvchan_byte_queue_peek(&q, &data, &length));
+  T_CMPINT((int)length, ==, (int)q.max_message_size);
+  uvchan_byte_queue_release(&q);
+  uvchan_byte_queue_destroy(&q);
+}
+
+void test_peek_should_not_wrap_messages(void) {
+  uvchan_byte_queue q;
+  char message[100];
+  const void* data;
+  size_t length;
+  int i;
+  int j;
+
+  uvchan_byte_queue_init(&q, 256);
+
+  // sizes are chosen so that messages keep landing across end of ring
+  for (i = 0; i < 200; i++) {
+    length = (size_t)(i * 37) % 100;
+    for (j = 0; j < (int)length; j++) {
+      message[j] = (char)(i + j);
+    }
+
+    T_OK(uvchan_byte_queue_push(&q, message, length));
+    T_OK(uvchan_byte_queue_peek(&q, &data, &length));
+    T_CMPINT((int)length, ==, (i * 37) % 100);
+    T_TRUE(memcmp(data, message, length) == 0);
+    T_TRUE((const char*)data + length <= q._buffer + q.capacity_bytes);
+    uvchan_byte_queue_release(&q);
+  }
+
+  uvchan_byte_queue_destroy(&q);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_pop_should_not_read_from_empty);
+  T_ADD(test_push_pop_mixed_sizes);
+  T_ADD(test_messages_should_be_packed);
+  T_ADD(test_pop_should_keep_message_larger_than_buffer);
+  T_ADD(test_push_should_reject_oversized_message);
+  T_ADD(test_peek_should_not_wrap_messages);
+
+  return T_RUN(argc, argv);
+}
@@ -0,0 +1,73 @@
+#include <testing.h>
+#include <uvchan/cancel.h>
+
+typedef struct _cancelled_t {
+  uvchan_cancel_link_t link;
+  int calls;
+} cancelled_t;
+
+static void _test_cancel_cb(uvchan_cancel_link_t* link) {
+  ((cancelled_t*)link)->calls++;
+}
+
+static void _test_attach(uvchan_cancel_t* cancel, cancelled_t* cancelled) {
+  uvchan_cancel_link_init(&cancelled->link, _test_cancel_cb);
+  cancelled->link.cancel = cancel;
+  cancelled->calls = 0;
+  uvchan_cancel_attach(&cancelled->link);
+}
+
+void test_cancel_should_call_attached_links_once(void) {
+  uvchan_cancel_t cancel;
+  cancelled_t cancelled[3];
+
+  uvchan_cancel_init(&cancel);
+  _test_attach(&cancel, &cancelled[0]);
+  _test_attach(&cancel, &cancelled[1]);
+  _test_attach(&cancel, &cancelled[2]);
+
+  // attaching twice does not link twice
+  uvchan_cancel_attach(&cancelled[0].link);
+  T_CMPINT((int)cancel.count, ==, 3);
+
+  uvchan_cancel_detach(&cancelled[1].link);
+  T_CMPINT((int)cancel.count, ==, 2);
+
+  uvchan_cancel(&cancel);
+  T_CMPINT((int)cancel.count, ==, 0);
+  T_CMPINT(cancelled[0].calls, ==, 1);
+  T_CMPINT(cancelled[1].calls, ==, 0);
+  T_CMPINT(cancelled[2].calls, ==, 1);
+  T_TRUE(cancelled[0].link.cancelled);
+  T_FALSE(cancelled[1].link.cancelled);
+
+  uvchan_cancel(&cancel);
+  T_CMPINT(cancelled[0].calls, ==, 1);
+}
+
+void test_attach_after_cancel_should_be_cancelled(void) {
+  uvchan_cancel_t cancel;
+  cancelled_t cancelled;
+
+  uvchan_cancel_init(&cancel);
+  uvchan_cancel(&cancel);
+
+  _test_attach(&cancel, &cancelled);
+  T_TRUE(cancelled.link.cancelled);
+  T_CMPINT((int)cancel.count, ==, 0);
+  T_CMPINT(cancelled.calls, ==, 0);
+
+  // token is reused once reinitialized
+  uvchan_cancel_init(&cancel);
+  _test_attach(&cancel, &cancelled);
+  T_FALSE(cancelled.link.cancelled);
+  T_CMPINT((int)cancel.count, ==, 1);
+  uvchan_cancel_detach(&cancelled.link);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_cancel_should_call_attached_links_once);
+  T_ADD(test_attach_after_cancel_should_be_cancelled);
+
+  return T_RUN(argc, argv);
+}
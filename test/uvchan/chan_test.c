@@ -1,7 +1,11 @@
 #include <math.h>
+#include <string.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <testing.h>
+#include <uvchan/alloc.h>
 #include <uvchan/chan.h>
+#include <unistd.h>
 #include "./config.h"
 
 #define ACTION_TYPE_PUSH 0
@@ -59,6 +63,8 @@ typedef struct _data_t {
 } data_t;
 
 void _test_using(action_t* actions, size_t count, size_t num_elements);
+void _test_using_flags(action_t* actions, size_t count, size_t num_elements,
+                       unsigned int flags);
 void _test_coroutine_using(action_t* routine1, size_t routine1_count,
                            action_t* routine2, size_t routine2_count,
                            size_t num_elements);
@@ -340,6 +346,1455 @@ void test_pop_should_support_null_callback(void) {
   free_loop(loop);
 }
 
+typedef struct _parked_data_t {
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t push_handle;
+  uv_timer_t timer;
+  int value;
+  int buffer;
+  int close_channel;
+  int pop_called;
+} parked_data_t;
+
+static void _test_parked_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                uvchan_error_t err) {
+  parked_data_t* data;
+
+  data = (parked_data_t*)handle->data;
+  data->pop_called = 1;
+
+  if (data->close_channel) {
+    T_CMPINT(err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  } else {
+    T_OK(err);
+    T_CMPINT(*((int*)buffer), ==, data->value);
+  }
+
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+#ifdef LIBUV_0X
+static void _test_parked_timer_cb(uv_timer_t* timer, int status) {
+#elif LIBUV_1X
+static void _test_parked_timer_cb(uv_timer_t* timer) {
+#else
+#error unknown callback for unknown version of libuv
+#endif
+  parked_data_t* data;
+
+  data = (parked_data_t*)timer->data;
+
+  // a waiting pop should not keep its idle handle spinning
+  T_FALSE(uv_is_active((uv_handle_t*)&data->pop_handle));
+  T_FALSE(data->pop_called);
+
+  if (data->close_channel) {
+    uvchan_close(data->pop_handle.ch);
+  } else {
+    uvchan_start_push(&data->push_handle, &data->value, NULL);
+  }
+
+  uv_close((uv_handle_t*)timer, NULL);
+}
+
+void _test_parked_pop_using(int close_channel) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  parked_data_t data;
+
+  loop = make_loop();
+  chan = uvchan_new(1, sizeof(int));
+  data.value = 42;
+  data.close_channel = close_channel;
+  data.pop_called = 0;
+
+  uvchan_handle_init(loop, &data.pop_handle, chan);
+  uvchan_handle_init(loop, &data.push_handle, chan);
+  data.pop_handle.data = &data;
+  uv_timer_init(loop, &data.timer);
+  data.timer.data = &data;
+
+  uvchan_start_pop(&data.pop_handle, &data.buffer, _test_parked_pop_cb);
+  uv_timer_start(&data.timer, _test_parked_timer_cb, 50, 0);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_TRUE(data.pop_called);
+
+  // default push callback closes push handle by itself
+  if (close_channel) {
+    uv_close((uv_handle_t*)&data.push_handle, NULL);
+  }
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_waiting_pop_should_be_parked(void) { _test_parked_pop_using(0); }
+
+void test_close_should_wake_parked_pop(void) { _test_parked_pop_using(1); }
+
+typedef struct _handoff_data_t {
+  int pushed;
+  int popped;
+  int value;
+} handoff_data_t;
+
+static void _test_handoff_push_cb(uvchan_handle_t* handle,
+                                  uvchan_error_t err) {
+  T_OK(err);
+  ((handoff_data_t*)handle->data)->pushed = 1;
+}
+
+static void _test_handoff_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                 uvchan_error_t err) {
+  T_OK(err);
+  ((handoff_data_t*)handle->data)->popped = 1;
+  ((handoff_data_t*)handle->data)->value = *((int*)buffer);
+}
+
+void test_unbuffered_push_should_hand_off_to_waiting_pop(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handle;
+  uvchan_handle_t pop_handle;
+  handoff_data_t data;
+  int value;
+  int buffer;
+
+  loop = make_loop();
+  chan = uvchan_new(0, sizeof(int));
+  data.pushed = 0;
+  data.popped = 0;
+  data.value = 0;
+  value = 42;
+
+  uvchan_handle_init(loop, &push_handle, chan);
+  uvchan_handle_init(loop, &pop_handle, chan);
+  push_handle.data = &data;
+  pop_handle.data = &data;
+
+  // receiver parks first
+  uvchan_start_pop(&pop_handle, &buffer, _test_handoff_pop_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_FALSE(data.popped);
+
+  // both sides complete in the very same iteration
+  uvchan_start_push(&push_handle, &value, _test_handoff_push_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_TRUE(data.pushed);
+  T_TRUE(data.popped);
+  T_CMPINT(data.value, ==, 42);
+  T_CMPINT(buffer, ==, 42);
+
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+typedef struct _fifo_data_t {
+  int values[4];
+  int completed;
+} fifo_data_t;
+
+static void _test_fifo_pop_cb(uvchan_handle_t* handle, void* buffer,
+                              uvchan_error_t err) {
+  fifo_data_t* data;
+
+  T_OK(err);
+  data = (fifo_data_t*)handle->data;
+  data->completed++;
+}
+
+static void _test_fifo_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  T_OK(err);
+}
+
+void test_waiters_should_complete_in_arrival_order(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handle;
+  uvchan_handle_t pop_handles[4];
+  fifo_data_t data;
+  int value;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new(4, sizeof(int));
+  data.completed = 0;
+
+  uvchan_handle_init(loop, &push_handle, chan);
+  for (i = 0; i < 4; i++) {
+    uvchan_handle_init(loop, &pop_handles[i], chan);
+    pop_handles[i].data = &data;
+    data.values[i] = 0;
+  }
+
+  // first three receivers park one after another
+  for (i = 0; i < 3; i++) {
+    uvchan_start_pop(&pop_handles[i], &data.values[i], _test_fifo_pop_cb);
+    uv_run(loop, UV_RUN_NOWAIT);
+  }
+
+  // a late receiver arriving together with first item must not overtake
+  for (value = 1; value <= 4; value++) {
+    uvchan_start_push(&push_handle, &value, _test_fifo_push_cb);
+    if (value == 1) {
+      uvchan_start_pop(&pop_handles[3], &data.values[3], _test_fifo_pop_cb);
+    }
+
+    uv_run(loop, UV_RUN_NOWAIT);
+    uv_run(loop, UV_RUN_NOWAIT);
+    T_CMPINT(data.completed, ==, value);
+  }
+
+  for (i = 0; i < 4; i++) {
+    T_CMPINT(data.values[i], ==, i + 1);
+    uv_close((uv_handle_t*)&pop_handles[i], NULL);
+  }
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+typedef struct _zero_copy_data_t {
+  uvchan_handle_t reserve_handle;
+  uvchan_handle_t peek_handle;
+  int reserved;
+  int peeked;
+} zero_copy_data_t;
+
+static void _test_zero_copy_reserve_cb(uvchan_handle_t* handle, void* slot,
+                                       uvchan_error_t err) {
+  zero_copy_data_t* data;
+
+  data = (zero_copy_data_t*)handle->data;
+
+  T_OK(err);
+  T_NOT_NULL(slot);
+  *((int*)slot) = 33;
+  data->reserved++;
+  uvchan_commit(handle);
+
+  if (data->reserved < 2) {
+    uvchan_start_reserve(handle, _test_zero_copy_reserve_cb);
+  } else {
+    uv_close((uv_handle_t*)handle, NULL);
+  }
+}
+
+static void _test_zero_copy_peek_cb(uvchan_handle_t* handle, const void* slot,
+                                    uvchan_error_t err) {
+  zero_copy_data_t* data;
+
+  data = (zero_copy_data_t*)handle->data;
+
+  T_OK(err);
+  T_CMPINT(*((const int*)slot), ==, 33);
+  data->peeked++;
+  uvchan_release(handle);
+
+  if (data->peeked < 2) {
+    uvchan_start_peek(handle, _test_zero_copy_peek_cb);
+  } else {
+    uv_close((uv_handle_t*)handle, NULL);
+  }
+}
+
+void test_reserve_commit_peek_release(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  zero_copy_data_t data;
+
+  loop = make_loop();
+  chan = uvchan_new(1, sizeof(int));
+  data.reserved = 0;
+  data.peeked = 0;
+
+  uvchan_handle_init(loop, &data.reserve_handle, chan);
+  uvchan_handle_init(loop, &data.peek_handle, chan);
+  data.reserve_handle.data = &data;
+  data.peek_handle.data = &data;
+
+  uvchan_start_peek(&data.peek_handle, _test_zero_copy_peek_cb);
+  uvchan_start_reserve(&data.reserve_handle, _test_zero_copy_reserve_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.reserved, ==, 2);
+  T_CMPINT(data.peeked, ==, 2);
+  T_CMPINT(chan->reference_count, ==, 1);
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+static void _test_mpmc_channel_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                      uvchan_error_t err) {
+  T_OK(err);
+  T_CMPINT(*((int*)buffer), ==, 77);
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+static void _test_mpmc_channel_reserve_cb(uvchan_handle_t* handle, void* slot,
+                                          uvchan_error_t err) {
+  T_CMPINT(err, ==, UVCHAN_ERR_NOT_SUPPORTED);
+  T_NULL(slot);
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+typedef struct _batch_data_t {
+  size_t count;
+  uvchan_error_t err;
+} batch_data_t;
+
+static void _test_batch_pop_cb(uvchan_handle_t* handle, void* buffer,
+                               size_t count, uvchan_error_t err) {
+  batch_data_t* data;
+
+  data = (batch_data_t*)handle->data;
+  data->count = count;
+  data->err = err;
+}
+
+void test_pop_batch_should_drain_ready_items(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handles[5];
+  uvchan_handle_t pop_handle;
+  batch_data_t data;
+  int values[5];
+  int buffer[3];
+  int sum;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new(8, sizeof(int));
+
+  for (i = 0; i < 5; i++) {
+    values[i] = i + 1;
+    uvchan_handle_init(loop, &push_handles[i], chan);
+    uvchan_start_push(&push_handles[i], &values[i], NULL);
+  }
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_handle_init(loop, &pop_handle, chan);
+  pop_handle.data = &data;
+
+  // first batch is limited by its size, second one by ready items
+  uvchan_start_pop_batch(&pop_handle, buffer, 3, _test_batch_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_OK(data.err);
+  T_CMPINT(data.count, ==, 3);
+  sum = buffer[0] + buffer[1] + buffer[2];
+
+  uvchan_start_pop_batch(&pop_handle, buffer, 3, _test_batch_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_OK(data.err);
+  T_CMPINT(data.count, ==, 2);
+  sum += buffer[0] + buffer[1];
+  T_CMPINT(sum, ==, 15);
+
+  uvchan_close(chan);
+  uvchan_start_pop_batch(&pop_handle, buffer, 3, _test_batch_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  T_CMPINT(data.count, ==, 0);
+
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+static void _test_batch_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  T_OK(err);
+  (*(int*)handle->data)++;
+}
+
+void test_pop_batch_should_release_as_many_pushers_as_popped(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handles[3];
+  uvchan_handle_t pop_handle;
+  batch_data_t data;
+  int values[3];
+  int buffer[2];
+  int pushed;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new(2, sizeof(int));
+  pushed = 0;
+
+  for (i = 0; i < 2; i++) {
+    T_OK(_uvchan_try_push(chan, &i));
+  }
+
+  // channel is full, so every push below is parked
+  for (i = 0; i < 3; i++) {
+    values[i] = i + 2;
+    uvchan_handle_init(loop, &push_handles[i], chan);
+    push_handles[i].data = &pushed;
+    uvchan_start_push(&push_handles[i], &values[i], _test_batch_push_cb);
+  }
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT(pushed, ==, 0);
+
+  // one batch frees both slots, which lets exactly two pushers through
+  uvchan_handle_init(loop, &pop_handle, chan);
+  pop_handle.data = &data;
+  uvchan_start_pop_batch(&pop_handle, buffer, 2, _test_batch_pop_cb);
+  for (i = 0; i < 4; i++) {
+    uv_run(loop, UV_RUN_NOWAIT);
+  }
+  T_OK(data.err);
+  T_CMPINT(data.count, ==, 2);
+  T_CMPINT(buffer[0], ==, 0);
+  T_CMPINT(buffer[1], ==, 1);
+  T_CMPINT(pushed, ==, 2);
+
+  uvchan_start_pop_batch(&pop_handle, buffer, 2, _test_batch_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.count, ==, 2);
+  T_CMPINT(pushed, ==, 3);
+  T_OK(_uvchan_try_pop(chan, &i));
+  T_CMPINT(buffer[0] + buffer[1] + i, ==, 9);
+
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  for (i = 0; i < 3; i++) {
+    uv_close((uv_handle_t*)&push_handles[i], NULL);
+  }
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+typedef struct _drain_data_t {
+  int calls;
+  size_t count;
+  int in_order;
+  uvchan_error_t err;
+} drain_data_t;
+
+static void _test_drain_cb(uvchan_handle_t* handle, void* buffer,
+                           size_t count, uvchan_error_t err) {
+  drain_data_t* data;
+  size_t i;
+
+  data = (drain_data_t*)handle->data;
+  data->calls++;
+  data->count = count;
+  data->err = err;
+  data->in_order = 1;
+  for (i = 0; i < count; i++) {
+    if (((int*)buffer)[i] != (int)i) {
+      data->in_order = 0;
+    }
+  }
+}
+
+static void _test_drain_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  T_OK(err);
+}
+
+static void _test_drain_using(uvchan_t* chan, int items, int full) {
+  uv_loop_t* loop;
+  uvchan_handle_t handle;
+  uvchan_handle_t push_handle;
+  drain_data_t data;
+  int parked;
+  int i;
+
+  loop = make_loop();
+  data.calls = 0;
+
+  for (i = 0; i < items; i++) {
+    T_OK(_uvchan_try_push(chan, &i));
+  }
+
+  // a push waiting for room is released by drain
+  parked = items;
+  uvchan_handle_init(loop, &push_handle, chan);
+  if (full) {
+    uvchan_start_push(&push_handle, &parked, _test_drain_push_cb);
+    uv_run(loop, UV_RUN_NOWAIT);
+  } else {
+    T_OK(_uvchan_try_push(chan, &parked));
+    items++;
+  }
+
+  uvchan_handle_init(loop, &handle, chan);
+  handle.data = &data;
+  uvchan_start_drain(&handle, _test_drain_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.calls, ==, 1);
+  T_OK(data.err);
+  T_CMPINT((int)data.count, ==, items);
+  T_TRUE(data.in_order);
+
+  // push released above is left over on close, and comes in a single
+  // call as well
+  uvchan_close(chan);
+  if (full) {
+    uvchan_start_drain(&handle, _test_drain_cb);
+    T_OK(uv_run(loop, UV_RUN_DEFAULT));
+    T_CMPINT(data.calls, ==, 2);
+    T_OK(data.err);
+    T_CMPINT((int)data.count, ==, 1);
+  }
+
+  data.calls = 0;
+  uvchan_start_drain(&handle, _test_drain_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.calls, ==, 1);
+  T_CMPINT(data.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  T_CMPINT((int)data.count, ==, 0);
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_drain_should_hand_over_backlog_in_one_call(void) {
+  uvchan_t* chan;
+  int value;
+  int i;
+
+  // ring wraps around, so items come in two runs
+  chan = uvchan_new(1000, sizeof(int));
+  for (i = 0; i < 700; i++) {
+    T_OK(_uvchan_try_push(chan, &i));
+    T_OK(_uvchan_try_pop(chan, &value));
+  }
+  _test_drain_using(chan, 1000, 1);
+}
+
+void test_drain_unbounded_should_hand_over_backlog_in_one_call(void) {
+  _test_drain_using(uvchan_new_ex(64, sizeof(int), UVCHAN_FLAG_UNBOUNDED),
+                    5000, 0);
+}
+
+static void* _test_failing_realloc(void* ptr, size_t size) { return 0L; }
+
+void test_drain_should_report_failed_allocation(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+  drain_data_t data;
+  int value;
+
+  loop = make_loop();
+  chan = uvchan_new(4, sizeof(int));
+  value = 0;
+  T_OK(_uvchan_try_push(chan, &value));
+  data.calls = 0;
+
+  T_OK(uvchan_replace_allocator(malloc, _test_failing_realloc, calloc, free));
+  uvchan_handle_init(loop, &handle, chan);
+  handle.data = &data;
+  uvchan_start_drain(&handle, _test_drain_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_OK(uvchan_replace_allocator(malloc, realloc, calloc, free));
+
+  T_CMPINT(data.calls, ==, 1);
+  T_CMPINT(data.err, ==, UVCHAN_ERR_NO_MEMORY);
+  T_CMPINT((int)data.count, ==, 0);
+  T_CMPINT(chan->polling, ==, 0);
+
+  // item stays in channel for a later attempt
+  uvchan_start_drain(&handle, _test_drain_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_OK(data.err);
+  T_CMPINT((int)data.count, ==, 1);
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+static int _test_reallocs = 0;
+
+static void* _test_counting_realloc(void* ptr, size_t size) {
+  _test_reallocs++;
+  return realloc(ptr, size);
+}
+
+void test_drain_should_keep_buffer_while_waiting(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+  drain_data_t data;
+  int value;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new(4, sizeof(int));
+  data.calls = 0;
+  _test_reallocs = 0;
+
+  T_OK(uvchan_replace_allocator(malloc, _test_counting_realloc, calloc,
+                                free));
+  uvchan_handle_init(loop, &handle, chan);
+  handle.data = &data;
+  uvchan_start_drain(&handle, _test_drain_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+
+  // spurious wake-ups find channel empty and park again
+  for (i = 0; i < 10; i++) {
+    _uvchan_waiter_wake_all(&chan->pop_waiters);
+    uv_run(loop, UV_RUN_NOWAIT);
+  }
+  T_CMPINT(data.calls, ==, 0);
+  T_CMPINT(_test_reallocs, ==, 1);
+
+  value = 0;
+  T_OK(_uvchan_try_push(chan, &value));
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_OK(uvchan_replace_allocator(malloc, realloc, calloc, free));
+  T_CMPINT(data.calls, ==, 1);
+  T_CMPINT((int)data.count, ==, 1);
+  T_CMPINT(_test_reallocs, ==, 1);
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+typedef struct _read_data_t {
+  int received[8];
+  int count;
+  int stop_after;
+  int closed;
+} read_data_t;
+
+static void _test_read_cb(uvchan_handle_t* handle, void* buffer,
+                          uvchan_error_t err) {
+  read_data_t* data;
+
+  data = (read_data_t*)handle->data;
+
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    data->closed++;
+    return;
+  }
+
+  T_OK(err);
+  data->received[data->count++] = *((int*)buffer);
+
+  if (data->count == data->stop_after) {
+    uvchan_read_stop(handle);
+  }
+}
+
+void test_read_should_deliver_items_until_close(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handles[5];
+  uvchan_handle_t read_handle;
+  read_data_t data;
+  int values[5];
+  int buffer;
+  int sum;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new(8, sizeof(int));
+  data.count = 0;
+  data.stop_after = 2;
+  data.closed = 0;
+
+  for (i = 0; i < 5; i++) {
+    values[i] = i + 1;
+    uvchan_handle_init(loop, &push_handles[i], chan);
+    uvchan_start_push(&push_handles[i], &values[i], NULL);
+  }
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  // reading stopped from callback leaves remaining items in channel
+  uvchan_handle_init(loop, &read_handle, chan);
+  read_handle.data = &data;
+  uvchan_read_start(&read_handle, &buffer, _test_read_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.count, ==, 2);
+  T_CMPINT(data.closed, ==, 0);
+
+  // stream keeps going while channel is empty, then ends on close
+  data.stop_after = 0;
+  uvchan_read_start(&read_handle, &buffer, _test_read_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT(data.count, ==, 5);
+  T_FALSE(uv_is_active((uv_handle_t*)&read_handle));
+
+  uvchan_close(chan);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.closed, ==, 1);
+
+  sum = 0;
+  for (i = 0; i < data.count; i++) {
+    sum += data.received[i];
+  }
+  T_CMPINT(sum, ==, 15);
+
+  uv_close((uv_handle_t*)&read_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_pooled_channel_push_pop(void) {
+  uv_loop_t* loop;
+  uvchan_pool_t* pool;
+  uvchan_t* chan;
+  uvchan_t* previous;
+  uvchan_handle_t push_handle;
+  uvchan_handle_t pop_handle;
+  int value;
+  int result;
+
+  loop = make_loop();
+  pool = uvchan_pool_new();
+
+  chan = uvchan_new_pooled(pool, 4, sizeof(int));
+  value = 7;
+  result = 0;
+
+  uvchan_handle_init(loop, &push_handle, chan);
+  uvchan_handle_init(loop, &pop_handle, chan);
+  uvchan_start_push(&push_handle, &value, NULL);
+  uvchan_start_pop(&pop_handle, &result, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(result, ==, 7);
+
+  // block of a destroyed channel is handed to the next one
+  previous = chan;
+  uvchan_unref(chan);
+  T_CMPINT((int)pool->outstanding, ==, 0);
+
+  chan = uvchan_new_pooled(pool, 4, sizeof(int));
+  T_TRUE(chan == previous);
+  uvchan_unref(chan);
+
+  uvchan_pool_delete(pool);
+  free_loop(loop);
+}
+
+typedef struct _deadline_data_t {
+  uvchan_error_t err;
+  int calls;
+  uint64_t completed;
+} deadline_data_t;
+
+static void _test_deadline_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                  uvchan_error_t err) {
+  deadline_data_t* data;
+
+  data = (deadline_data_t*)handle->data;
+  data->err = err;
+  data->calls++;
+  data->completed = uv_now(handle->idle_handle.loop);
+}
+
+static void _test_deadline_push_cb(uvchan_handle_t* handle,
+                                   uvchan_error_t err) {
+  T_OK(err);
+}
+
+void test_pop_should_time_out_on_empty_channel(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+  deadline_data_t data;
+  uint64_t started;
+  int buffer;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  chan = uvchan_new(1, sizeof(int));
+  data.calls = 0;
+
+  uvchan_handle_init(loop, &handle, chan);
+  handle.data = &data;
+  uvchan_handle_set_deadline(&handle, &wheel, 20);
+
+  uv_update_time(loop);
+  started = uv_now(loop);
+  uvchan_start_pop(&handle, &buffer, _test_deadline_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  T_CMPINT(data.calls, ==, 1);
+  T_CMPINT(data.err, ==, UVCHAN_ERR_TIMEOUT);
+  T_TRUE(data.completed - started >= 20);
+  T_CMPINT(chan->polling, ==, 0);
+  T_TRUE(_uvchan_waiter_idle(&chan->pop_waiters));
+
+  // channel is still usable by later operations
+  uvchan_handle_set_deadline(&handle, NULL, 0);
+  buffer = 5;
+  T_OK(_uvchan_try_push(chan, &buffer));
+  buffer = 0;
+  uvchan_start_pop(&handle, &buffer, _test_deadline_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.calls, ==, 2);
+  T_OK(data.err);
+  T_CMPINT(buffer, ==, 5);
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_pop_should_complete_before_deadline(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  uvchan_t* chan;
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t push_handle;
+  deadline_data_t data;
+  int buffer;
+  int value;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  chan = uvchan_new(0, sizeof(int));
+  data.calls = 0;
+  value = 3;
+
+  uvchan_handle_init(loop, &pop_handle, chan);
+  uvchan_handle_init(loop, &push_handle, chan);
+  pop_handle.data = &data;
+  uvchan_handle_set_deadline(&pop_handle, &wheel, 10000);
+  uvchan_handle_set_deadline(&push_handle, &wheel, 10000);
+
+  uvchan_start_pop(&pop_handle, &buffer, _test_deadline_pop_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT(data.calls, ==, 0);
+  T_CMPINT((int)wheel.count, ==, 1);
+
+  // completed operations take their deadlines off wheel, so that loop
+  // does not wait for them
+  uvchan_start_push(&push_handle, &value, _test_deadline_push_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.calls, ==, 1);
+  T_OK(data.err);
+  T_CMPINT(buffer, ==, 3);
+  T_CMPINT((int)wheel.count, ==, 0);
+
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+typedef struct _cancel_data_t {
+  int pushes;
+  int pops;
+} cancel_data_t;
+
+static void _test_cancel_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  T_CMPINT(err, ==, UVCHAN_ERR_CANCELLED);
+  ((cancel_data_t*)handle->data)->pushes++;
+}
+
+static void _test_cancel_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                uvchan_error_t err) {
+  T_CMPINT(err, ==, UVCHAN_ERR_CANCELLED);
+  ((cancel_data_t*)handle->data)->pops++;
+}
+
+void test_cancel_should_abort_parked_operations(void) {
+  uv_loop_t* loop;
+  uvchan_cancel_t cancel;
+  uvchan_t* empty;
+  uvchan_t* full;
+  uvchan_handle_t pop_handles[3];
+  uvchan_handle_t push_handle;
+  cancel_data_t data;
+  int buffers[3];
+  int value;
+  int i;
+
+  loop = make_loop();
+  uvchan_cancel_init(&cancel);
+  empty = uvchan_new(1, sizeof(int));
+  full = uvchan_new(1, sizeof(int));
+  data.pushes = 0;
+  data.pops = 0;
+  value = 1;
+  T_OK(_uvchan_try_push(full, &value));
+
+  for (i = 0; i < 3; i++) {
+    uvchan_handle_init(loop, &pop_handles[i], empty);
+    pop_handles[i].data = &data;
+    uvchan_handle_set_cancel(&pop_handles[i], &cancel);
+    uvchan_start_pop(&pop_handles[i], &buffers[i], _test_cancel_pop_cb);
+  }
+  uvchan_handle_init(loop, &push_handle, full);
+  push_handle.data = &data;
+  uvchan_handle_set_cancel(&push_handle, &cancel);
+  uvchan_start_push(&push_handle, &value, _test_cancel_push_cb);
+
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT((int)cancel.count, ==, 4);
+
+  // everything parked ends with a single call, and leaves channels
+  uvchan_cancel(&cancel);
+  T_CMPINT((int)cancel.count, ==, 0);
+  T_TRUE(_uvchan_waiter_idle(&empty->pop_waiters));
+  T_TRUE(_uvchan_waiter_idle(&full->push_waiters));
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.pops, ==, 3);
+  T_CMPINT(data.pushes, ==, 1);
+  T_CMPINT(empty->polling, ==, 0);
+
+  // operations started afterwards are cancelled as well
+  uvchan_start_pop(&pop_handles[0], &buffers[0], _test_cancel_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.pops, ==, 4);
+
+  for (i = 0; i < 3; i++) {
+    uv_close((uv_handle_t*)&pop_handles[i], NULL);
+  }
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  T_OK(_uvchan_try_pop(full, &value));
+  uvchan_unref(empty);
+  uvchan_unref(full);
+  free_loop(loop);
+}
+
+void test_cancelled_token_should_win_over_ready_channel(void) {
+  uv_loop_t* loop;
+  uvchan_cancel_t cancel;
+  uvchan_t* chan;
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t push_handle;
+  cancel_data_t data;
+  int buffer;
+  int value;
+
+  loop = make_loop();
+  uvchan_cancel_init(&cancel);
+  uvchan_cancel(&cancel);
+  chan = uvchan_new(2, sizeof(int));
+  data.pushes = 0;
+  data.pops = 0;
+  value = 1;
+  T_OK(_uvchan_try_push(chan, &value));
+
+  // channel has both an item and room, yet neither operation runs
+  uvchan_handle_init(loop, &pop_handle, chan);
+  pop_handle.data = &data;
+  uvchan_handle_set_cancel(&pop_handle, &cancel);
+  uvchan_start_pop(&pop_handle, &buffer, _test_cancel_pop_cb);
+  uvchan_handle_init(loop, &push_handle, chan);
+  push_handle.data = &data;
+  uvchan_handle_set_cancel(&push_handle, &cancel);
+  uvchan_start_push(&push_handle, &value, _test_cancel_push_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.pops, ==, 1);
+  T_CMPINT(data.pushes, ==, 1);
+  T_CMPINT(chan->polling, ==, 0);
+  T_CMPINT(chan->reference_count, ==, 1);
+
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  T_OK(_uvchan_try_pop(chan, &value));
+  T_CMPINT(_uvchan_try_pop(chan, &value), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_mpmc_channel_push_pop(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handle;
+  uvchan_handle_t pop_handle;
+  uvchan_handle_t reserve_handle;
+  int value;
+  int buffer;
+
+  value = 77;
+  loop = make_loop();
+  chan = uvchan_new_ex(1, sizeof(int), UVCHAN_FLAG_MPMC);
+  uvchan_handle_init(loop, &push_handle, chan);
+  uvchan_handle_init(loop, &pop_handle, chan);
+  uvchan_handle_init(loop, &reserve_handle, chan);
+  uvchan_start_pop(&pop_handle, &buffer, _test_mpmc_channel_pop_cb);
+  uvchan_start_push(&push_handle, &value, NULL);
+  uvchan_start_reserve(&reserve_handle, _test_mpmc_channel_reserve_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_unbounded_push_should_not_wait(void) {
+  action_t actions[2 * 100 + 2];
+  int i;
+
+  actions[0] = MAKE_ACTION_RECORD_TIME();
+  for (i = 0; i < 100; i++) {
+    actions[1 + i] = MAKE_ACTION_PUSH(i);
+    actions[101 + i] = MAKE_ACTION_POP(i);
+  }
+  actions[201] = MAKE_ACTION_ASSERT_TIME_LT(1000);
+
+  _test_using_flags(actions, sizeof(actions) / sizeof(action_t), 4,
+                    UVCHAN_FLAG_UNBOUNDED);
+}
+
+static void _test_unbounded_reserve_cb(uvchan_handle_t* handle, void* slot,
+                                       uvchan_error_t err) {
+  T_OK(err);
+  *(int*)slot = 777;
+  *(int*)handle->data = 1;
+}
+
+static void _test_unbounded_reserve_pop_cb(uvchan_handle_t* handle,
+                                           void* buffer, uvchan_error_t err) {
+  T_OK(err);
+  *(int*)handle->data = *(int*)buffer;
+}
+
+void test_unbounded_pop_should_wait_for_reserved_slot(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t reserve_handle;
+  uvchan_handle_t pop_handle;
+  int reserved;
+  int popped;
+  int value;
+  int i;
+
+  loop = make_loop();
+  chan = uvchan_new_ex(4, sizeof(int), UVCHAN_FLAG_UNBOUNDED);
+  for (i = 0; i < 4; i++) {
+    T_OK(_uvchan_try_push(chan, &i));
+  }
+  for (i = 0; i < 4; i++) {
+    T_OK(_uvchan_try_pop(chan, &value));
+  }
+
+  // slot is reserved in a fresh segment, behind a drained one
+  reserved = 0;
+  popped = -1;
+  uvchan_handle_init(loop, &reserve_handle, chan);
+  reserve_handle.data = &reserved;
+  uvchan_start_reserve(&reserve_handle, _test_unbounded_reserve_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_TRUE(reserved);
+
+  uvchan_handle_init(loop, &pop_handle, chan);
+  pop_handle.data = &popped;
+  uvchan_start_pop(&pop_handle, &value, _test_unbounded_reserve_pop_cb);
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT(popped, ==, -1);
+
+  uvchan_commit(&reserve_handle);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(popped, ==, 777);
+  T_CMPINT(_uvchan_try_pop(chan, &value), ==, UVCHAN_ERR_QUEUE_EMPTY);
+
+  uv_close((uv_handle_t*)&reserve_handle, NULL);
+  uv_close((uv_handle_t*)&pop_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+static int _test_owned_dealloc_count = 0;
+
+static void _test_owned_dealloc_cb(void* buffer) {
+  _test_owned_dealloc_count++;
+  free(buffer);
+}
+
+static void _test_owned_pop_cb(uvchan_handle_t* handle, void* buffer,
+                               uvchan_error_t err) {
+  T_OK(err);
+  T_TRUE(**((int**)buffer) >= 0 && **((int**)buffer) < 3);
+  free(*((int**)buffer));
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+void _test_owned_using(unsigned int flags) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handles[3];
+  uvchan_handle_t pop_handle;
+  int* items[3];
+  int* buffer;
+  int i;
+
+  _test_owned_dealloc_count = 0;
+  loop = make_loop();
+  chan = uvchan_new_owned(4, flags, _test_owned_dealloc_cb);
+
+  for (i = 0; i < 3; i++) {
+    items[i] = (int*)malloc(sizeof(int));
+    *items[i] = i;
+    uvchan_handle_init(loop, &push_handles[i], chan);
+    uvchan_start_push(&push_handles[i], &items[i], NULL);
+  }
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_handle_init(loop, &pop_handle, chan);
+  uvchan_start_pop(&pop_handle, &buffer, _test_owned_pop_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  // two items left in channel are handed to dealloc callback
+  uvchan_close(chan);
+  uvchan_unref(chan);
+  T_CMPINT(_test_owned_dealloc_count, ==, 2);
+
+  free_loop(loop);
+}
+
+void test_owned_channel_should_dealloc_items_on_destroy(void) {
+  _test_owned_using(0);
+}
+
+void test_owned_mpmc_channel_should_dealloc_items_on_destroy(void) {
+  _test_owned_using(UVCHAN_FLAG_MPMC);
+}
+
+void test_owned_unbounded_channel_should_dealloc_items_on_destroy(void) {
+  _test_owned_using(UVCHAN_FLAG_UNBOUNDED);
+}
+
+static int _test_bytes_received = 0;
+
+static void _test_bytes_peek_cb(uvchan_handle_t* handle, const void* data,
+                                size_t length, uvchan_error_t err) {
+  T_OK(err);
+  T_CMPINT((int)length, ==, 5);
+  T_TRUE(memcmp(data, "hello", 5) == 0);
+  _test_bytes_received++;
+
+  uvchan_release(handle);
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+static void _test_bytes_pop_cb(uvchan_handle_t* handle, const void* data,
+                               size_t length, uvchan_error_t err) {
+  if (_test_bytes_received == 1) {
+    // first attempt uses a buffer too small for the message
+    T_CMPINT(err, ==, UVCHAN_ERR_MESSAGE_TOO_LARGE);
+    T_CMPINT((int)length, ==, 11);
+    _test_bytes_received++;
+    uvchan_start_pop_bytes(handle, handle->data, 64, _test_bytes_pop_cb);
+    return;
+  }
+
+  T_OK(err);
+  T_CMPINT((int)length, ==, 11);
+  T_TRUE(memcmp(data, "hello world", 11) == 0);
+  _test_bytes_received++;
+
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+static void _test_bytes_not_supported_cb(uvchan_handle_t* handle,
+                                         uvchan_error_t err) {
+  T_CMPINT(err, ==, UVCHAN_ERR_NOT_SUPPORTED);
+  uv_close((uv_handle_t*)handle, NULL);
+}
+
+void test_bytes_channel_push_pop_peek(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t push_handles[3];
+  uvchan_handle_t peek_handle;
+  uvchan_handle_t pop_handle;
+  char buffer[64];
+  int value;
+
+  _test_bytes_received = 0;
+  value = 1;
+  loop = make_loop();
+  chan = uvchan_new_bytes(256);
+  uvchan_handle_init(loop, &push_handles[0], chan);
+  uvchan_handle_init(loop, &push_handles[1], chan);
+  uvchan_handle_init(loop, &push_handles[2], chan);
+  uvchan_handle_init(loop, &peek_handle, chan);
+  uvchan_handle_init(loop, &pop_handle, chan);
+
+  uvchan_start_push_bytes(&push_handles[0], "hello", 5, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  uvchan_start_push_bytes(&push_handles[1], "hello world", 11, NULL);
+  uvchan_start_push(&push_handles[2], &value, _test_bytes_not_supported_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_start_peek_bytes(&peek_handle, _test_bytes_peek_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  pop_handle.data = buffer;
+  uvchan_start_pop_bytes(&pop_handle, buffer, 4, _test_bytes_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  T_CMPINT(_test_bytes_received, ==, 3);
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+#define THREADSAFE_PRODUCERS 3
+#define THREADSAFE_ITEMS 20000
+
+typedef struct _test_threadsafe_t {
+  uvchan_t* chan;
+  uv_loop_t* loop;
+  int id;
+  int value;
+  int item;
+  int last[THREADSAFE_PRODUCERS];
+  int received;
+} test_threadsafe_t;
+
+static void _test_threadsafe_push_cb(uvchan_handle_t* handle,
+                                     uvchan_error_t err) {
+  test_threadsafe_t* state;
+
+  state = (test_threadsafe_t*)handle->data;
+  T_OK(err);
+
+  if (++state->value < THREADSAFE_ITEMS) {
+    state->item = state->id * THREADSAFE_ITEMS + state->value;
+    uvchan_start_push(handle, &state->item, _test_threadsafe_push_cb);
+  } else {
+    uv_close((uv_handle_t*)handle, NULL);
+    uvchan_detach(state->chan, state->loop);
+  }
+}
+
+static void _test_threadsafe_producer(void* data) {
+  test_threadsafe_t* state;
+  uvchan_handle_t handle;
+
+  state = (test_threadsafe_t*)data;
+  state->loop = make_loop();
+  state->value = 0;
+  state->item = state->id * THREADSAFE_ITEMS;
+
+  T_OK(uvchan_attach(state->chan, state->loop));
+  uvchan_handle_init(state->loop, &handle, state->chan);
+  handle.data = state;
+  uvchan_start_push(&handle, &state->item, _test_threadsafe_push_cb);
+  uv_run(state->loop, UV_RUN_DEFAULT);
+
+  free_loop(state->loop);
+}
+
+static void _test_threadsafe_pop_cb(uvchan_handle_t* handle, void* buffer,
+                                    uvchan_error_t err) {
+  test_threadsafe_t* state;
+  int value;
+  int producer;
+
+  state = (test_threadsafe_t*)handle->data;
+  T_OK(err);
+
+  // producers tag items with their id, each one's items stay in order
+  value = *((int*)buffer);
+  producer = value / THREADSAFE_ITEMS;
+  T_CMPINT(value % THREADSAFE_ITEMS, ==, state->last[producer] + 1);
+  state->last[producer]++;
+
+  if (++state->received < THREADSAFE_PRODUCERS * THREADSAFE_ITEMS) {
+    uvchan_start_pop(handle, buffer, _test_threadsafe_pop_cb);
+  } else {
+    uv_close((uv_handle_t*)handle, NULL);
+    uvchan_detach(state->chan, state->loop);
+  }
+}
+
+void test_threadsafe_channel_across_loops(void) {
+  test_threadsafe_t producers[THREADSAFE_PRODUCERS];
+  test_threadsafe_t consumer;
+  uv_thread_t threads[THREADSAFE_PRODUCERS];
+  uvchan_handle_t handle;
+  int buffer;
+  int i;
+
+  consumer.chan = uvchan_new_ex(4, sizeof(int), UVCHAN_FLAG_THREADSAFE);
+  consumer.loop = make_loop();
+  consumer.received = 0;
+  for (i = 0; i < THREADSAFE_PRODUCERS; i++) {
+    consumer.last[i] = -1;
+  }
+
+  T_OK(uvchan_attach(consumer.chan, consumer.loop));
+  uvchan_handle_init(consumer.loop, &handle, consumer.chan);
+  handle.data = &consumer;
+  uvchan_start_pop(&handle, &buffer, _test_threadsafe_pop_cb);
+
+  for (i = 0; i < THREADSAFE_PRODUCERS; i++) {
+    producers[i].chan = consumer.chan;
+    producers[i].id = i;
+    T_OK(uv_thread_create(&threads[i], _test_threadsafe_producer,
+                          &producers[i]));
+  }
+
+  T_OK(uv_run(consumer.loop, UV_RUN_DEFAULT));
+
+  for (i = 0; i < THREADSAFE_PRODUCERS; i++) {
+    T_OK(uv_thread_join(&threads[i]));
+    T_CMPINT(consumer.last[i], ==, THREADSAFE_ITEMS - 1);
+  }
+  T_CMPINT(consumer.received, ==, THREADSAFE_PRODUCERS * THREADSAFE_ITEMS);
+
+  uvchan_unref(consumer.chan);
+  free_loop(consumer.loop);
+}
+
+void test_mpmc_channels_should_hold_requested_bound(void) {
+  uvchan_t* chan;
+  int value;
+  int i;
+
+  chan = uvchan_new_ex(3, sizeof(int), UVCHAN_FLAG_MPMC);
+  for (i = 0; i < 3; i++) {
+    T_OK(_uvchan_try_push(chan, &i));
+  }
+  T_CMPINT(_uvchan_try_push(chan, &i), ==, UVCHAN_ERR_QUEUE_FULL);
+  for (i = 0; i < 3; i++) {
+    T_OK(_uvchan_try_pop(chan, &value));
+    T_CMPINT(value, ==, i);
+  }
+  uvchan_unref(chan);
+
+  // unbuffered channel takes a single item, and only while a receiver
+  // is polling
+  chan = uvchan_new_ex(0, sizeof(int), UVCHAN_FLAG_THREADSAFE);
+  value = 1;
+  T_CMPINT(_uvchan_try_push(chan, &value), ==, UVCHAN_ERR_QUEUE_FULL);
+  chan->polling = 1;
+  T_OK(_uvchan_try_push(chan, &value));
+  T_CMPINT(_uvchan_try_push(chan, &value), ==, UVCHAN_ERR_QUEUE_FULL);
+  T_OK(_uvchan_try_pop(chan, &value));
+  chan->polling = 0;
+  uvchan_unref(chan);
+}
+
+#define SHM_CHANNEL_ITEMS 10000
+
+static int _test_shm_value;
+
+static void _test_shm_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  if (err != UVCHAN_ERR_SUCCESS) {
+    _exit(1);
+  }
+
+  if (++_test_shm_value < SHM_CHANNEL_ITEMS) {
+    uvchan_start_push(handle, &_test_shm_value, _test_shm_push_cb);
+  } else {
+    uvchan_close(handle->ch);
+    uv_close((uv_handle_t*)handle, NULL);
+  }
+}
+
+static void _test_shm_producer(int mem_fd, int data_fd, int space_fd) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+
+  loop = make_loop();
+  chan = uvchan_open_shm(mem_fd, data_fd, space_fd, sizeof(int));
+  if (chan == NULL) {
+    _exit(1);
+  }
+
+  _test_shm_value = 0;
+  uvchan_handle_init(loop, &handle, chan);
+  uvchan_start_push(&handle, &_test_shm_value, _test_shm_push_cb);
+  uv_run(loop, UV_RUN_DEFAULT);
+
+  uvchan_unref(chan);
+  uv_run(loop, UV_RUN_DEFAULT);
+  free_loop(loop);
+  _exit(0);
+}
+
+static void _test_shm_pop_cb(uvchan_handle_t* handle, void* buffer,
+                             uvchan_error_t err) {
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    uv_close((uv_handle_t*)handle, NULL);
+    return;
+  }
+
+  T_OK(err);
+  T_CMPINT(*((int*)buffer), ==, _test_shm_value);
+  _test_shm_value++;
+  uvchan_start_pop(handle, buffer, _test_shm_pop_cb);
+}
+
+void test_shm_channel_across_processes(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_handle_t handle;
+  pid_t pid;
+  int status;
+  int buffer;
+
+  // small ring, so that both processes park and wake each other
+  chan = uvchan_new_ex(8, sizeof(int), UVCHAN_FLAG_SHM);
+  T_NOT_NULL(chan);
+
+  pid = fork();
+  T_TRUE(pid >= 0);
+  if (pid == 0) {
+    _test_shm_producer(dup(chan->shm_queue.mem_fd),
+                       dup(chan->shm_queue.data_fd),
+                       dup(chan->shm_queue.space_fd));
+  }
+
+  _test_shm_value = 0;
+  loop = make_loop();
+  uvchan_handle_init(loop, &handle, chan);
+  uvchan_start_pop(&handle, &buffer, _test_shm_pop_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  T_CMPINT(_test_shm_value, ==, SHM_CHANNEL_ITEMS);
+  T_CMPINT(waitpid(pid, &status, 0), ==, pid);
+  T_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  uvchan_unref(chan);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  free_loop(loop);
+}
+
 static void _push_callback(uvchan_handle_t* handle, uvchan_error_t ok);
 static void _pop_callback(uvchan_handle_t* handle, void* element,
                           uvchan_error_t ok);
@@ -469,10 +1924,15 @@ static void _timer_callback(uv_timer_t* handle) {
 static void _dealloc_callback(uv_handle_t* handle) { free(handle); }
 
 void _test_using(action_t* actions, size_t count, size_t num_elements) {
+  _test_using_flags(actions, count, num_elements, 0);
+}
+
+void _test_using_flags(action_t* actions, size_t count, size_t num_elements,
+                       unsigned int flags) {
   data_t data;
   uv_loop_t* loop;
 
-  data.ch = uvchan_new(num_elements, sizeof(int));
+  data.ch = uvchan_new_ex(num_elements, sizeof(int), flags);
   data.actions = actions;
   data.count = count;
   data.i = 0;
@@ -559,6 +2019,33 @@ int main(int argc, char* argv[]) {
   T_ADD(test_push_should_support_null_callback);
   T_ADD(test_push_should_support_null_callback_polling);
   T_ADD(test_pop_should_support_null_callback);
+  T_ADD(test_waiting_pop_should_be_parked);
+  T_ADD(test_close_should_wake_parked_pop);
+  T_ADD(test_unbuffered_push_should_hand_off_to_waiting_pop);
+  T_ADD(test_waiters_should_complete_in_arrival_order);
+  T_ADD(test_reserve_commit_peek_release);
+  T_ADD(test_pop_batch_should_drain_ready_items);
+  T_ADD(test_pop_batch_should_release_as_many_pushers_as_popped);
+  T_ADD(test_drain_should_hand_over_backlog_in_one_call);
+  T_ADD(test_drain_unbounded_should_hand_over_backlog_in_one_call);
+  T_ADD(test_drain_should_report_failed_allocation);
+  T_ADD(test_drain_should_keep_buffer_while_waiting);
+  T_ADD(test_read_should_deliver_items_until_close);
+  T_ADD(test_pooled_channel_push_pop);
+  T_ADD(test_pop_should_time_out_on_empty_channel);
+  T_ADD(test_pop_should_complete_before_deadline);
+  T_ADD(test_cancel_should_abort_parked_operations);
+  T_ADD(test_cancelled_token_should_win_over_ready_channel);
+  T_ADD(test_mpmc_channel_push_pop);
+  T_ADD(test_unbounded_push_should_not_wait);
+  T_ADD(test_unbounded_pop_should_wait_for_reserved_slot);
+  T_ADD(test_owned_channel_should_dealloc_items_on_destroy);
+  T_ADD(test_owned_mpmc_channel_should_dealloc_items_on_destroy);
+  T_ADD(test_owned_unbounded_channel_should_dealloc_items_on_destroy);
+  T_ADD(test_shm_channel_across_processes);
+  T_ADD(test_bytes_channel_push_pop_peek);
+  T_ADD(test_threadsafe_channel_across_loops);
+  T_ADD(test_mpmc_channels_should_hold_requested_bound);
 
   return T_RUN(argc, argv);
 }
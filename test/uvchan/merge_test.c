@@ -0,0 +1,304 @@
+#include <testing.h>
+#include <uvchan/merge.h>
+
+#include <stdlib.h>
+#include "./config.h"
+
+#define INPUTS 200
+#define ITEMS 5
+
+typedef struct _merge_data_t {
+  int done;
+  uvchan_error_t err;
+  int received;
+  long sum;
+  int closed;
+} merge_data_t;
+
+uv_loop_t* make_loop(void);
+void free_loop(uv_loop_t* loop);
+
+static void _test_done_cb(uvchan_merge_t* merge, uvchan_error_t err) {
+  merge_data_t* data;
+
+  data = (merge_data_t*)merge->data;
+  data->done++;
+  data->err = err;
+}
+
+static void _test_read_cb(uvchan_handle_t* handle, void* buffer,
+                          uvchan_error_t err) {
+  merge_data_t* data;
+
+  data = (merge_data_t*)handle->data;
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    data->closed++;
+    return;
+  }
+
+  T_OK(err);
+  data->received++;
+  data->sum += *(int*)buffer;
+}
+
+static void _test_push_cb(uvchan_handle_t* handle, uvchan_error_t err) {
+  T_OK(err);
+}
+
+static void _test_init_data(merge_data_t* data) {
+  data->done = 0;
+  data->err = UVCHAN_ERR_SUCCESS;
+  data->received = 0;
+  data->sum = 0;
+  data->closed = 0;
+}
+
+void test_merge_should_forward_items_of_every_input(void) {
+  uv_loop_t* loop;
+  uvchan_t* inputs[INPUTS];
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  uvchan_handle_t read_handle;
+  merge_data_t data;
+  int buffer;
+  int value;
+  int i;
+  int j;
+
+  loop = make_loop();
+  // small output, so that inputs are held back by consumer
+  output = uvchan_new(16, sizeof(int));
+  _test_init_data(&data);
+
+  uvchan_merge_init(loop, &merge, output);
+  merge.data = &data;
+  T_OK(uvchan_merge_start(&merge, _test_done_cb));
+
+  for (i = 0; i < INPUTS; i++) {
+    inputs[i] = uvchan_new(ITEMS, sizeof(int));
+    for (j = 0; j < ITEMS; j++) {
+      value = i * ITEMS + j;
+      T_OK(_uvchan_try_push(inputs[i], &value));
+    }
+    uvchan_close(inputs[i]);
+    T_OK(uvchan_merge_add(&merge, inputs[i]));
+  }
+  uvchan_merge_close(&merge);
+
+  uvchan_handle_init(loop, &read_handle, output);
+  read_handle.data = &data;
+  uvchan_read_start(&read_handle, &buffer, _test_read_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+  T_CMPINT(data.received, ==, INPUTS * ITEMS);
+  T_CMPINT(data.sum, ==, (INPUTS * ITEMS - 1) * INPUTS * ITEMS / 2);
+  T_CMPINT(data.closed, ==, 1);
+  T_CMPINT(output->reference_count, ==, 1);
+
+  uv_close((uv_handle_t*)&read_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  for (i = 0; i < INPUTS; i++) {
+    T_CMPINT(inputs[i]->reference_count, ==, 1);
+    uvchan_unref(inputs[i]);
+  }
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_merge_should_keep_idle_inputs_parked(void) {
+  uv_loop_t* loop;
+  uvchan_t* inputs[INPUTS];
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  uvchan_handle_t read_handle;
+  uvchan_handle_t push_handle;
+  merge_data_t data;
+  int buffer;
+  int value;
+  int i;
+
+  loop = make_loop();
+  output = uvchan_new(16, sizeof(int));
+  _test_init_data(&data);
+
+  uvchan_merge_init(loop, &merge, output);
+  merge.data = &data;
+  T_OK(uvchan_merge_start(&merge, _test_done_cb));
+  for (i = 0; i < INPUTS; i++) {
+    inputs[i] = uvchan_new(ITEMS, sizeof(int));
+    T_OK(uvchan_merge_add(&merge, inputs[i]));
+  }
+
+  uvchan_handle_init(loop, &read_handle, output);
+  read_handle.data = &data;
+  uvchan_read_start(&read_handle, &buffer, _test_read_cb);
+
+  // every input waits on its channel, so loop has nothing to run
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.received, ==, 0);
+
+  value = 42;
+  uvchan_handle_init(loop, &push_handle, inputs[INPUTS / 2]);
+  uvchan_start_push(&push_handle, &value, _test_push_cb);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.received, ==, 1);
+  T_CMPINT(data.sum, ==, 42);
+  T_CMPINT(data.done, ==, 0);
+
+  for (i = 0; i < INPUTS; i++) {
+    uvchan_close(inputs[i]);
+  }
+  uvchan_merge_close(&merge);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+  T_CMPINT(data.closed, ==, 1);
+
+  uv_close((uv_handle_t*)&read_handle, NULL);
+  uv_close((uv_handle_t*)&push_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  for (i = 0; i < INPUTS; i++) {
+    uvchan_unref(inputs[i]);
+  }
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_merge_should_stop_once_output_is_closed(void) {
+  uv_loop_t* loop;
+  uvchan_t* busy;
+  uvchan_t* idle;
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  merge_data_t data;
+  int value;
+
+  loop = make_loop();
+  output = uvchan_new(4, sizeof(int));
+  uvchan_close(output);
+  busy = uvchan_new(4, sizeof(int));
+  value = 1;
+  T_OK(_uvchan_try_push(busy, &value));
+  idle = uvchan_new(4, sizeof(int));
+  _test_init_data(&data);
+
+  uvchan_merge_init(loop, &merge, output);
+  merge.data = &data;
+  T_OK(uvchan_merge_start(&merge, _test_done_cb));
+  T_OK(uvchan_merge_add(&merge, busy));
+  T_OK(uvchan_merge_add(&merge, idle));
+
+  // idle input is cancelled, though its channel stays open
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_CMPINT(data.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  T_CMPINT(uvchan_merge_add(&merge, idle), ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  T_CMPINT(busy->reference_count, ==, 1);
+  T_CMPINT(idle->reference_count, ==, 1);
+  T_CMPINT(output->reference_count, ==, 1);
+
+  uvchan_unref(busy);
+  uvchan_unref(idle);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_merge_should_reject_mismatched_input(void) {
+  uv_loop_t* loop;
+  uvchan_t* input;
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  merge_data_t data;
+
+  loop = make_loop();
+  output = uvchan_new(4, sizeof(int));
+  input = uvchan_new(4, 2 * sizeof(int));
+  _test_init_data(&data);
+
+  uvchan_merge_init(loop, &merge, output);
+  merge.data = &data;
+  T_CMPINT(uvchan_merge_add(&merge, input), ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  T_OK(uvchan_merge_start(&merge, _test_done_cb));
+  T_CMPINT(uvchan_merge_add(&merge, input), ==, UVCHAN_ERR_INVALID_ARGUMENT);
+  T_CMPINT(input->reference_count, ==, 1);
+
+  uvchan_merge_close(&merge);
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+  T_TRUE(output->closed);
+
+  uvchan_unref(input);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_merge_should_reject_bytes_channels(void) {
+  uv_loop_t* loop;
+  uvchan_t* bytes;
+  uvchan_t* output;
+  uvchan_merge_t merge;
+  merge_data_t data;
+
+  loop = make_loop();
+  bytes = uvchan_new_bytes(64);
+  output = uvchan_new(4, sizeof(int));
+  _test_init_data(&data);
+
+  uvchan_merge_init(loop, &merge, bytes);
+  T_CMPINT(uvchan_merge_start(&merge, _test_done_cb), ==,
+           UVCHAN_ERR_NOT_SUPPORTED);
+  T_CMPINT(bytes->reference_count, ==, 1);
+
+  uvchan_merge_init(loop, &merge, output);
+  merge.data = &data;
+  T_OK(uvchan_merge_start(&merge, _test_done_cb));
+  T_CMPINT(uvchan_merge_add(&merge, bytes), ==, UVCHAN_ERR_NOT_SUPPORTED);
+  T_CMPINT(bytes->reference_count, ==, 1);
+
+  uvchan_merge_close(&merge);
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+
+  uvchan_unref(bytes);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+uv_loop_t* make_loop(void) {
+  uv_loop_t* loop;
+
+#ifdef LIBUV_0X
+  loop = uv_default_loop();
+#elif LIBUV_1X
+  loop = (uv_loop_t*)malloc(sizeof(uv_loop_t));
+  uv_loop_init(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+
+  return loop;
+}
+
+void free_loop(uv_loop_t* loop) {
+#ifdef LIBUV_0X
+#elif LIBUV_1X
+  uv_loop_close(loop);
+  free(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_merge_should_forward_items_of_every_input);
+  T_ADD(test_merge_should_keep_idle_inputs_parked);
+  T_ADD(test_merge_should_stop_once_output_is_closed);
+  T_ADD(test_merge_should_reject_mismatched_input);
+  T_ADD(test_merge_should_reject_bytes_channels);
+
+  return T_RUN(argc, argv);
+}
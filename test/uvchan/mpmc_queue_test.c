@@ -0,0 +1,174 @@
+#include <pthread.h>
+#include <testing.h>
+#include <uvchan/mpmc_queue.h>
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS_PER_PRODUCER 100000
+
+void test_pop_should_not_read_from_empty(void) {
+  uvchan_mpmc_queue q;
+  int result;
+
+  uvchan_mpmc_queue_init(&q, 4, sizeof(int));
+  T_CMPINT(uvchan_mpmc_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_mpmc_queue_destroy(&q);
+}
+
+void test_capacity_should_be_requested_bound(void) {
+  uvchan_mpmc_queue q;
+
+  uvchan_mpmc_queue_init(&q, 0, sizeof(int));
+  T_CMPINT((int)q.capacity_elements, ==, 1);
+  uvchan_mpmc_queue_destroy(&q);
+
+  uvchan_mpmc_queue_init(&q, 5, sizeof(int));
+  T_CMPINT((int)q.capacity_elements, ==, 5);
+  uvchan_mpmc_queue_destroy(&q);
+}
+
+void test_push_should_stop_at_bound(void) {
+  uvchan_mpmc_queue q;
+  int i;
+  int j;
+  int result;
+
+  // ring of 4 slots, holding 3 items
+  uvchan_mpmc_queue_init(&q, 3, sizeof(int));
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 3; i++) {
+      T_TRUE(_uvchan_mpmc_queue_can_push(&q));
+      T_OK(uvchan_mpmc_queue_push(&q, &i));
+    }
+    T_FALSE(_uvchan_mpmc_queue_can_push(&q));
+    T_CMPINT(uvchan_mpmc_queue_push(&q, &i), ==, UVCHAN_ERR_QUEUE_FULL);
+
+    for (i = 0; i < 3; i++) {
+      T_OK(uvchan_mpmc_queue_pop(&q, &result));
+      T_CMPINT(result, ==, i);
+    }
+  }
+  uvchan_mpmc_queue_destroy(&q);
+}
+
+void test_push_pop_full(void) {
+  uvchan_mpmc_queue q;
+  int i;
+  int j;
+  int result;
+
+  uvchan_mpmc_queue_init(&q, 8, sizeof(int));
+  for (j = 0; j < 3; j++) {
+    for (i = 0; i < 8; i++) {
+      T_OK(uvchan_mpmc_queue_push(&q, &i));
+    }
+    T_CMPINT(uvchan_mpmc_queue_push(&q, &i), ==, UVCHAN_ERR_QUEUE_FULL);
+    for (i = 0; i < 8; i++) {
+      T_OK(uvchan_mpmc_queue_pop(&q, &result));
+      T_CMPINT(result, ==, i);
+    }
+    T_CMPINT(uvchan_mpmc_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  }
+  uvchan_mpmc_queue_destroy(&q);
+}
+
+typedef struct _consumer_data_t {
+  uvchan_mpmc_queue* q;
+  volatile int* remaining;
+  long sum;
+} consumer_data_t;
+
+void* _test_concurrent_producer(void* data) {
+  uvchan_mpmc_queue* q;
+  int i;
+
+  q = (uvchan_mpmc_queue*)data;
+  i = 1;
+
+  while (i <= ITEMS_PER_PRODUCER) {
+    if (uvchan_mpmc_queue_push(q, &i)) {
+      sched_yield();
+    } else {
+      i++;
+    }
+  }
+
+  return 0L;
+}
+
+void* _test_concurrent_consumer(void* data) {
+  consumer_data_t* consumer;
+  int value;
+
+  consumer = (consumer_data_t*)data;
+  consumer->sum = 0;
+
+  while (__atomic_load_n(consumer->remaining, __ATOMIC_RELAXED) > 0) {
+    if (uvchan_mpmc_queue_pop(consumer->q, &value)) {
+      sched_yield();
+    } else {
+      consumer->sum += value;
+      __atomic_fetch_sub(consumer->remaining, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  return 0L;
+}
+
+void test_concurrent_producers_and_consumers(void) {
+  pthread_t producers[PRODUCERS];
+  pthread_t consumers[CONSUMERS];
+  consumer_data_t consumer_data[CONSUMERS];
+  uvchan_mpmc_queue q;
+  volatile int remaining;
+  long sum;
+  int i;
+
+  uvchan_mpmc_queue_init(&q, 64, sizeof(int));
+  remaining = PRODUCERS * ITEMS_PER_PRODUCER;
+
+  for (i = 0; i < CONSUMERS; i++) {
+    consumer_data[i].q = &q;
+    consumer_data[i].remaining = &remaining;
+    T_OK(pthread_create(&consumers[i], NULL, _test_concurrent_consumer,
+                        &consumer_data[i]));
+  }
+  for (i = 0; i < PRODUCERS; i++) {
+    T_OK(pthread_create(&producers[i], NULL, _test_concurrent_producer, &q));
+  }
+
+  sum = 0;
+  for (i = 0; i < PRODUCERS; i++) {
+    T_OK(pthread_join(producers[i], NULL));
+  }
+  for (i = 0; i < CONSUMERS; i++) {
+    T_OK(pthread_join(consumers[i], NULL));
+    sum += consumer_data[i].sum;
+  }
+
+  // every item is received exactly once
+  T_TRUE(sum == (long)PRODUCERS * ITEMS_PER_PRODUCER *
+                    (ITEMS_PER_PRODUCER + 1) / 2);
+
+  uvchan_mpmc_queue_destroy(&q);
+}
+
+void test_destroy_should_set_buffer_to_null(void) {
+  uvchan_mpmc_queue q;
+
+  uvchan_mpmc_queue_init(&q, 1, sizeof(int));
+  T_NOT_NULL(q._buffer);
+  uvchan_mpmc_queue_destroy(&q);
+  T_NULL(q._buffer);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_pop_should_not_read_from_empty);
+  T_ADD(test_capacity_should_be_requested_bound);
+  T_ADD(test_push_should_stop_at_bound);
+  T_ADD(test_push_pop_full);
+  T_ADD(test_concurrent_producers_and_consumers);
+  T_ADD(test_destroy_should_set_buffer_to_null);
+
+  return T_RUN(argc, argv);
+}
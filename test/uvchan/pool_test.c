@@ -0,0 +1,80 @@
+#include <testing.h>
+#include <uvchan/pool.h>
+
+void test_freed_block_should_be_reused(void) {
+  uvchan_pool_t* pool;
+  void* first;
+  void* second;
+
+  pool = uvchan_pool_new();
+
+  first = uvchan_pool_alloc(pool, 100);
+  T_CMPINT((int)pool->outstanding, ==, 1);
+  uvchan_pool_free(pool, first, 100);
+  T_CMPINT((int)pool->outstanding, ==, 0);
+
+  // same size class hands out the most recently freed block
+  second = uvchan_pool_alloc(pool, kUvChanPoolMinBlockSize);
+  T_TRUE(first == second);
+  uvchan_pool_free(pool, second, kUvChanPoolMinBlockSize);
+
+  uvchan_pool_delete(pool);
+}
+
+void test_size_classes_should_not_overlap(void) {
+  uvchan_pool_t* pool;
+  char* blocks[64];
+  size_t size;
+  int i;
+  int j;
+
+  pool = uvchan_pool_new();
+
+  // spans every class and a large size served by malloc
+  size = 16;
+  for (i = 0; i < 64; i++) {
+    blocks[i] = (char*)uvchan_pool_alloc(pool, size);
+    for (j = 0; j < (int)size; j++) {
+      blocks[i][j] = (char)i;
+    }
+    size = (size * 3) / 2 + 1;
+    if (size > 32 * 1024) {
+      size = 16;
+    }
+  }
+
+  size = 16;
+  for (i = 0; i < 64; i++) {
+    for (j = 0; j < (int)size; j++) {
+      T_CMPINT(blocks[i][j], ==, (char)i);
+    }
+    uvchan_pool_free(pool, blocks[i], size);
+    size = (size * 3) / 2 + 1;
+    if (size > 32 * 1024) {
+      size = 16;
+    }
+  }
+  T_CMPINT((int)pool->outstanding, ==, 0);
+
+  uvchan_pool_delete(pool);
+}
+
+void test_delete_should_wait_for_outstanding_blocks(void) {
+  uvchan_pool_t* pool;
+  void* block;
+
+  pool = uvchan_pool_new();
+  block = uvchan_pool_alloc(pool, 64);
+
+  // pool is released by last free
+  uvchan_pool_delete(pool);
+  uvchan_pool_free(pool, block, 64);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_freed_block_should_be_reused);
+  T_ADD(test_size_classes_should_not_overlap);
+  T_ADD(test_delete_should_wait_for_outstanding_blocks);
+
+  return T_RUN(argc, argv);
+}
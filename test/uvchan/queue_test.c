@@ -1,6 +1,16 @@
+#define _GNU_SOURCE
+
 #include <pthread.h>
+#include <stdio.h>
+#include <string.h>
 #include <testing.h>
 #include <uvchan/queue.h>
+#include "./config.h"
+
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 void test_pop_should_not_read_from_empty(void) {
   uvchan_queue q;
@@ -55,6 +65,285 @@ void test_push_pop_full(void) {
   uvchan_queue_destroy(&q);
 }
 
+void test_push_pop_wraparound(void) {
+  uvchan_queue q;
+  int i;
+  int j;
+  int value;
+  int result;
+
+  uvchan_queue_init(&q, 3, sizeof(int));
+  T_CMPINT(q.capacity_elements, ==, 3);
+
+  value = 0;
+  for (i = 0; i < 100; i++) {
+    for (j = 0; j < 3; j++) {
+      T_OK(uvchan_queue_push(&q, &value));
+      value++;
+    }
+    T_CMPINT(uvchan_queue_push(&q, &value), ==, UVCHAN_ERR_QUEUE_FULL);
+    for (j = 0; j < 3; j++) {
+      T_OK(uvchan_queue_pop(&q, &result));
+      T_CMPINT(result, ==, value - 3 + j);
+    }
+    T_CMPINT(uvchan_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  }
+
+  uvchan_queue_destroy(&q);
+}
+
+void test_push_n_pop_n_should_move_partial_batches(void) {
+  uvchan_queue q;
+  int values[8];
+  int results[8];
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    values[i] = i;
+  }
+
+  uvchan_queue_init(&q, 5, sizeof(int));
+  T_CMPINT((int)uvchan_queue_push_n(&q, values, 8), ==, 5);
+  T_CMPINT((int)uvchan_queue_push_n(&q, values, 8), ==, 0);
+  T_CMPINT((int)uvchan_queue_pop_n(&q, results, 3), ==, 3);
+  for (i = 0; i < 3; i++) {
+    T_CMPINT(results[i], ==, i);
+  }
+  T_CMPINT((int)uvchan_queue_pop_n(&q, results, 8), ==, 2);
+  T_CMPINT(results[0], ==, 3);
+  T_CMPINT(results[1], ==, 4);
+  T_CMPINT((int)uvchan_queue_pop_n(&q, results, 8), ==, 0);
+  uvchan_queue_destroy(&q);
+}
+
+void test_push_n_pop_n_wraparound(void) {
+  uvchan_queue q;
+  int values[6];
+  int results[6];
+  int value;
+  int i;
+  int j;
+
+  uvchan_queue_init(&q, 8, sizeof(int));
+
+  // misalign ring so that every batch crosses the wraparound point
+  value = 0;
+  T_OK(uvchan_queue_push(&q, &value));
+  T_OK(uvchan_queue_pop(&q, &value));
+
+  value = 0;
+  for (i = 0; i < 100; i++) {
+    for (j = 0; j < 6; j++) {
+      values[j] = value + j;
+    }
+    T_CMPINT((int)uvchan_queue_push_n(&q, values, 6), ==, 6);
+    T_CMPINT((int)uvchan_queue_pop_n(&q, results, 6), ==, 6);
+    for (j = 0; j < 6; j++) {
+      T_CMPINT(results[j], ==, value + j);
+    }
+    value += 6;
+  }
+
+  uvchan_queue_destroy(&q);
+}
+
+void test_push_pop_should_copy_every_element_size(void) {
+  uvchan_queue q;
+  unsigned char value[48];
+  unsigned char result[48];
+  size_t element_size;
+  int i;
+  int j;
+
+  // covers size specialized copy paths along with generic ones
+  for (element_size = 1; element_size <= 40; element_size++) {
+    uvchan_queue_init(&q, 3, element_size);
+
+    for (i = 0; i < 10; i++) {
+      for (j = 0; j < (int)element_size; j++) {
+        value[j] = (unsigned char)(i * 7 + j);
+      }
+      memset(result, 0xff, sizeof(result));
+
+      T_CMPINT(uvchan_queue_push(&q, value), ==, UVCHAN_ERR_SUCCESS);
+      T_CMPINT(uvchan_queue_pop(&q, result), ==, UVCHAN_ERR_SUCCESS);
+      T_TRUE(memcmp(value, result, element_size) == 0);
+      T_CMPINT(result[element_size], ==, 0xff);
+    }
+
+    uvchan_queue_destroy(&q);
+  }
+}
+
+void test_reserve_commit_peek_release(void) {
+  uvchan_queue q;
+  void* slot;
+  const void* peeked;
+  int result;
+
+  uvchan_queue_init(&q, 1, sizeof(int));
+  T_CMPINT(uvchan_queue_peek(&q, &peeked), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  T_OK(uvchan_queue_reserve(&q, &slot));
+  *((int*)slot) = 17;
+
+  // reserved slot is not visible before commit
+  T_CMPINT(uvchan_queue_peek(&q, &peeked), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_queue_commit(&q);
+  T_CMPINT(uvchan_queue_reserve(&q, &slot), ==, UVCHAN_ERR_QUEUE_FULL);
+
+  T_OK(uvchan_queue_peek(&q, &peeked));
+  T_CMPINT(*((const int*)peeked), ==, 17);
+
+  // peeked item is kept in queue until release
+  T_CMPINT(uvchan_queue_reserve(&q, &slot), ==, UVCHAN_ERR_QUEUE_FULL);
+  uvchan_queue_release(&q);
+  T_CMPINT(uvchan_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_queue_destroy(&q);
+}
+
+void test_spans_should_stop_at_wraparound(void) {
+  uvchan_queue q;
+  void* slot;
+  const void* peeked;
+  int value;
+
+  uvchan_queue_init(&q, 4, sizeof(int));
+  value = 0;
+  T_OK(uvchan_queue_push(&q, &value));
+  T_OK(uvchan_queue_pop(&q, &value));
+
+  T_CMPINT((int)uvchan_queue_reserve_n(&q, &slot, 4), ==, 3);
+  uvchan_queue_commit_n(&q, 3);
+  T_CMPINT((int)uvchan_queue_peek_n(&q, &peeked, 4), ==, 3);
+  uvchan_queue_release_n(&q, 3);
+  uvchan_queue_destroy(&q);
+}
+
+void test_mirrored_spans_should_cross_wraparound(void) {
+  uvchan_queue q;
+  void* slot;
+  const void* peeked;
+  size_t slots;
+  size_t i;
+  int value;
+
+  if (uvchan_queue_init_ex(&q, 4, sizeof(int), UVCHAN_QUEUE_MIRRORED) ==
+      UVCHAN_ERR_NOT_SUPPORTED) {
+    return;
+  }
+
+  // ring is rounded up to a whole page
+  slots = q._mask + 1;
+  T_TRUE(slots * sizeof(int) >= 4096 || slots * sizeof(int) == q._mapped_size);
+  T_CMPINT((int)q.capacity_elements, ==, 4);
+
+  // move positions right before end of ring
+  for (i = 0; i < slots - 2; i++) {
+    value = (int)i;
+    T_OK(uvchan_queue_push(&q, &value));
+    T_OK(uvchan_queue_pop(&q, &value));
+  }
+
+  T_CMPINT((int)uvchan_queue_reserve_n(&q, &slot, 4), ==, 4);
+  for (i = 0; i < 4; i++) {
+    ((int*)slot)[i] = 100 + (int)i;
+  }
+  uvchan_queue_commit_n(&q, 4);
+
+  // items written past end of ring land at its start
+  T_CMPINT(((int*)q._buffer)[0], ==, 102);
+  T_CMPINT(((int*)q._buffer)[1], ==, 103);
+
+  T_CMPINT((int)uvchan_queue_peek_n(&q, &peeked, 4), ==, 4);
+  for (i = 0; i < 4; i++) {
+    T_CMPINT(((const int*)peeked)[i], ==, 100 + (int)i);
+  }
+  uvchan_queue_release_n(&q, 4);
+  uvchan_queue_destroy(&q);
+  T_NULL(q._buffer);
+}
+
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H) && \
+    defined(MFD_HUGETLB)
+static int _test_huge_pages_available(void) {
+  void* mapping;
+  int available;
+  int fd;
+
+  fd = memfd_create("uvchan_queue_test", MFD_CLOEXEC | MFD_HUGETLB);
+  if (fd < 0) {
+    return 0;
+  }
+
+  // hugetlb pages are reserved when mapped, so this fails without any
+  available = 0;
+  if (ftruncate(fd, kUvChanHugePageSize) == 0) {
+    mapping = mmap(NULL, kUvChanHugePageSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED) {
+      available = 1;
+      munmap(mapping, kUvChanHugePageSize);
+    }
+  }
+  close(fd);
+
+  return available;
+}
+
+// page size in kB kernel backs mapping holding address with
+static int _test_kernel_page_size(const void* address) {
+  FILE* smaps;
+  char line[256];
+  unsigned long start;
+  unsigned long end;
+  int inside;
+  int size;
+
+  smaps = fopen("/proc/self/smaps", "r");
+  if (smaps == NULL) {
+    return -1;
+  }
+
+  inside = 0;
+  size = -1;
+  while (fgets(line, sizeof(line), smaps) != NULL) {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+      inside = start <= (unsigned long)address && (unsigned long)address < end;
+    } else if (inside && sscanf(line, "KernelPageSize: %d kB", &size) == 1) {
+      break;
+    }
+  }
+  fclose(smaps);
+
+  return size;
+}
+
+void test_huge_page_mirror_should_be_huge_page_backed(void) {
+  uvchan_queue q;
+  int value;
+
+  if (!_test_huge_pages_available()) {
+    return;
+  }
+
+  T_OK(uvchan_queue_init_ex(&q, 4, sizeof(int),
+                            UVCHAN_QUEUE_MIRRORED | UVCHAN_QUEUE_HUGE_PAGES));
+  T_CMPINT((int)(q._mapped_size % kUvChanHugePageSize), ==, 0);
+  T_CMPINT((int)((size_t)q._buffer % kUvChanHugePageSize), ==, 0);
+  T_CMPINT(_test_kernel_page_size(q._buffer), ==, kUvChanHugePageSize / 1024);
+  T_CMPINT(_test_kernel_page_size((char*)q._buffer + q._mapped_size), ==,
+           kUvChanHugePageSize / 1024);
+
+  // second view shows same pages
+  value = 42;
+  T_OK(uvchan_queue_push(&q, &value));
+  T_CMPINT(*(int*)((char*)q._buffer + q._mapped_size), ==, 42);
+  T_OK(uvchan_queue_pop(&q, &value));
+
+  uvchan_queue_destroy(&q);
+}
+#endif
+
 // The following test checks whether q queue
 // object can be used as an IPC tool iff only
 // one consumer and one producer use the queue.
@@ -133,6 +422,17 @@ int main(int argc, char* argv[]) {
   T_ADD(test_push_pop_single_element);
   T_ADD(test_push_pop_full);
   T_ADD(test_destroy_should_set_buffer_to_null);
+  T_ADD(test_push_pop_wraparound);
+  T_ADD(test_push_n_pop_n_should_move_partial_batches);
+  T_ADD(test_push_n_pop_n_wraparound);
+  T_ADD(test_push_pop_should_copy_every_element_size);
+  T_ADD(test_reserve_commit_peek_release);
+  T_ADD(test_spans_should_stop_at_wraparound);
+  T_ADD(test_mirrored_spans_should_cross_wraparound);
+#if defined(HAVE_MEMFD_CREATE) && defined(HAVE_SYS_MMAN_H) && \
+    defined(MFD_HUGETLB)
+  T_ADD(test_huge_page_mirror_should_be_huge_page_backed);
+#endif
 
   // The following test checks whether q queue
   // object can be used as an IPC tool iff only
@@ -0,0 +1,128 @@
+#include <testing.h>
+#include <uvchan/segment_queue.h>
+
+void test_pop_should_not_read_from_empty(void) {
+  uvchan_segment_queue q;
+  int result;
+
+  uvchan_segment_queue_init(&q, 4, sizeof(int));
+  T_CMPINT(uvchan_segment_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_segment_queue_destroy(&q);
+}
+
+void test_default_segment_size(void) {
+  uvchan_segment_queue q;
+
+  uvchan_segment_queue_init(&q, 0, sizeof(int));
+  T_CMPINT((int)q.segment_elements, ==, kUvChanDefaultSegmentElements);
+  uvchan_segment_queue_destroy(&q);
+}
+
+void test_push_pop_should_grow_across_segments(void) {
+  uvchan_segment_queue q;
+  int i;
+  int result;
+
+  uvchan_segment_queue_init(&q, 4, sizeof(int));
+  for (i = 0; i < 1000; i++) {
+    T_OK(uvchan_segment_queue_push(&q, &i));
+  }
+  for (i = 0; i < 1000; i++) {
+    T_OK(uvchan_segment_queue_pop(&q, &result));
+    T_CMPINT(result, ==, i);
+  }
+  T_CMPINT(uvchan_segment_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+
+  // drained segments beyond free list are released
+  T_CMPINT((int)q._free_count, ==, kUvChanSegmentFreeListSize);
+  uvchan_segment_queue_destroy(&q);
+}
+
+void test_steady_state_should_reuse_segments(void) {
+  uvchan_segment_queue q;
+  uvchan_segment* first;
+  int i;
+  int j;
+  int result;
+  int reused;
+
+  uvchan_segment_queue_init(&q, 4, sizeof(int));
+  first = q._read_segment;
+  reused = 0;
+
+  for (i = 0; i < 100; i++) {
+    for (j = 0; j < 3; j++) {
+      T_OK(uvchan_segment_queue_push(&q, &j));
+    }
+    for (j = 0; j < 3; j++) {
+      T_OK(uvchan_segment_queue_pop(&q, &result));
+      T_CMPINT(result, ==, j);
+    }
+    if (q._write_segment == first) {
+      reused = 1;
+    }
+  }
+
+  T_TRUE(reused);
+  T_TRUE(q._free_count <= kUvChanSegmentFreeListSize);
+  uvchan_segment_queue_destroy(&q);
+}
+
+void test_reserve_commit_peek_release(void) {
+  uvchan_segment_queue q;
+  void* slot;
+  const void* peeked;
+  int i;
+
+  uvchan_segment_queue_init(&q, 2, sizeof(int));
+  for (i = 0; i < 5; i++) {
+    T_OK(uvchan_segment_queue_reserve(&q, &slot));
+    *((int*)slot) = i;
+    uvchan_segment_queue_commit(&q);
+  }
+  for (i = 0; i < 5; i++) {
+    T_OK(uvchan_segment_queue_peek(&q, &peeked));
+    T_CMPINT(*((const int*)peeked), ==, i);
+    uvchan_segment_queue_release(&q);
+  }
+  T_CMPINT(uvchan_segment_queue_peek(&q, &peeked), ==,
+           UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_segment_queue_destroy(&q);
+}
+
+void test_reserved_slot_should_not_be_popped(void) {
+  uvchan_segment_queue q;
+  void* slot;
+  int i;
+  int result;
+
+  uvchan_segment_queue_init(&q, 4, sizeof(int));
+  for (i = 0; i < 4; i++) {
+    T_OK(uvchan_segment_queue_push(&q, &i));
+  }
+  for (i = 0; i < 4; i++) {
+    T_OK(uvchan_segment_queue_pop(&q, &result));
+  }
+
+  // reserving links a fresh segment before anything is committed
+  T_OK(uvchan_segment_queue_reserve(&q, &slot));
+  *(int*)slot = 777;
+  T_CMPINT(uvchan_segment_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+
+  uvchan_segment_queue_commit(&q);
+  T_OK(uvchan_segment_queue_pop(&q, &result));
+  T_CMPINT(result, ==, 777);
+  T_CMPINT(uvchan_segment_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  uvchan_segment_queue_destroy(&q);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_pop_should_not_read_from_empty);
+  T_ADD(test_default_segment_size);
+  T_ADD(test_push_pop_should_grow_across_segments);
+  T_ADD(test_steady_state_should_reuse_segments);
+  T_ADD(test_reserve_commit_peek_release);
+  T_ADD(test_reserved_slot_should_not_be_popped);
+
+  return T_RUN(argc, argv);
+}
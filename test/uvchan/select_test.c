@@ -6,6 +6,8 @@
 #define TAG_PUSH 10
 #define TAG_POP 20
 #define TAG_DEFAULT 30
+#define TAG_TIMEOUT 40
+#define TAG_CANCEL 50
 
 uv_loop_t* make_loop(void);
 void free_loop(uv_loop_t* loop);
@@ -205,6 +207,119 @@ void test_pop_from_empty_queue_should_call_default(void) {
   free_loop(loop);
 }
 
+void _test_timeout_should_be_called(uvchan_select_handle_t* handle, int tag,
+                                    uvchan_error_t err) {
+  T_CMPINT(tag, ==, TAG_TIMEOUT);
+  T_CMPINT(err, ==, UVCHAN_ERR_TIMEOUT);
+  (*(int*)handle->data)++;
+}
+
+void test_select_should_time_out(void) {
+  uvchan_t* ch;
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  uvchan_select_handle_t handle;
+  int calls;
+  int value;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  ch = uvchan_new(1, sizeof(int));
+  uvchan_select_handle_init(loop, &handle, _test_timeout_should_be_called);
+  calls = 0;
+  handle.data = &calls;
+
+  T_OK(uvchan_select_handle_add_pop(&handle, TAG_POP, ch, &value));
+  T_OK(uvchan_select_handle_add_timeout(&handle, TAG_TIMEOUT, &wheel, 10));
+  T_OK(uvchan_select_handle_start(&handle));
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(calls, ==, 1);
+  T_TRUE(_uvchan_waiter_idle(&ch->pop_waiters));
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(ch);
+  free_loop(loop);
+}
+
+void _test_cancel_should_be_called(uvchan_select_handle_t* handle, int tag,
+                                   uvchan_error_t err) {
+  T_CMPINT(tag, ==, TAG_CANCEL);
+  T_CMPINT(err, ==, UVCHAN_ERR_CANCELLED);
+  (*(int*)handle->data)++;
+}
+
+void test_select_should_be_cancelled(void) {
+  uvchan_t* ch;
+  uv_loop_t* loop;
+  uvchan_cancel_t cancel;
+  uvchan_select_handle_t handle;
+  int calls;
+  int value;
+
+  loop = make_loop();
+  uvchan_cancel_init(&cancel);
+  ch = uvchan_new(1, sizeof(int));
+  uvchan_select_handle_init(loop, &handle, _test_cancel_should_be_called);
+  calls = 0;
+  handle.data = &calls;
+
+  T_OK(uvchan_select_handle_add_pop(&handle, TAG_POP, ch, &value));
+  T_OK(uvchan_select_handle_add_cancel(&handle, TAG_CANCEL, &cancel));
+  T_OK(uvchan_select_handle_start(&handle));
+
+  uv_run(loop, UV_RUN_NOWAIT);
+  T_CMPINT(calls, ==, 0);
+  T_CMPINT((int)cancel.count, ==, 1);
+
+  uvchan_cancel(&cancel);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(calls, ==, 1);
+  T_TRUE(_uvchan_waiter_idle(&ch->pop_waiters));
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(ch);
+  free_loop(loop);
+}
+
+void test_cancelled_select_should_skip_ready_cases(void) {
+  uvchan_t* ch;
+  uv_loop_t* loop;
+  uvchan_cancel_t cancel;
+  uvchan_select_handle_t handle;
+  int calls;
+  int value;
+
+  loop = make_loop();
+  uvchan_cancel_init(&cancel);
+  uvchan_cancel(&cancel);
+  ch = uvchan_new(1, sizeof(int));
+  value = 1;
+  T_OK(_uvchan_try_push(ch, &value));
+  uvchan_select_handle_init(loop, &handle, _test_cancel_should_be_called);
+  calls = 0;
+  handle.data = &calls;
+
+  T_OK(uvchan_select_handle_add_pop(&handle, TAG_POP, ch, &value));
+  T_OK(uvchan_select_handle_add_cancel(&handle, TAG_CANCEL, &cancel));
+  T_OK(uvchan_select_handle_start(&handle));
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(calls, ==, 1);
+  T_OK(_uvchan_try_pop(ch, &value));
+
+  uv_close((uv_handle_t*)&handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(ch);
+  free_loop(loop);
+}
+
 void test_single_default_should_be_called(void) {
   uvchan_t* ch;
   uv_loop_t* loop;
@@ -375,6 +490,9 @@ int main(int argc, char* argv[]) {
   T_ADD(test_push_to_empty_channel_should_not_call_default);
   T_ADD(test_pop_from_empty_queue_should_call_default);
   T_ADD(test_single_default_should_be_called);
+  T_ADD(test_select_should_time_out);
+  T_ADD(test_select_should_be_cancelled);
+  T_ADD(test_cancelled_select_should_skip_ready_cases);
   // T_RUN(test_single_pop);
 
   return T_RUN(argc, argv);
@@ -0,0 +1,212 @@
+#include <poll.h>
+#include <sys/wait.h>
+#include <testing.h>
+#include <unistd.h>
+#include <uvchan/shm_queue.h>
+
+#define CROSS_PROCESS_ITEMS 200000
+
+static void _wait_readable(int fd) {
+  struct pollfd pfd;
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  poll(&pfd, 1, -1);
+  uvchan_shm_queue_ack(fd);
+}
+
+void test_push_pop_full_empty(void) {
+  uvchan_shm_queue q;
+  int i;
+  int result;
+
+  T_OK(uvchan_shm_queue_init(&q, 3, sizeof(int)));
+  T_CMPINT(uvchan_shm_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+
+  for (i = 0; i < 3; i++) {
+    T_OK(uvchan_shm_queue_push(&q, &i));
+  }
+  T_CMPINT(uvchan_shm_queue_push(&q, &i), ==, UVCHAN_ERR_QUEUE_FULL);
+
+  for (i = 0; i < 3; i++) {
+    T_OK(uvchan_shm_queue_pop(&q, &result));
+    T_CMPINT(result, ==, i);
+  }
+  T_CMPINT(uvchan_shm_queue_pop(&q, &result), ==, UVCHAN_ERR_QUEUE_EMPTY);
+
+  uvchan_shm_queue_destroy(&q);
+}
+
+void test_second_mapping_should_share_items(void) {
+  uvchan_shm_queue producer;
+  uvchan_shm_queue consumer;
+  int i;
+  int result;
+
+  T_OK(uvchan_shm_queue_init(&producer, 8, sizeof(int)));
+  T_OK(uvchan_shm_queue_open(&consumer, dup(producer.mem_fd),
+                             dup(producer.data_fd), dup(producer.space_fd),
+                             sizeof(int)));
+
+  // ring is mapped at two addresses, only offsets are shared
+  T_TRUE(producer._ring != consumer._ring);
+
+  for (i = 0; i < 100; i++) {
+    T_OK(uvchan_shm_queue_push(&producer, &i));
+    T_OK(uvchan_shm_queue_pop(&consumer, &result));
+    T_CMPINT(result, ==, i);
+  }
+
+  uvchan_shm_queue_destroy(&consumer);
+  uvchan_shm_queue_destroy(&producer);
+}
+
+static uvchan_error_t _test_open_dup(uvchan_shm_queue* producer,
+                                     size_t element_size) {
+  uvchan_shm_queue consumer;
+  uvchan_error_t err;
+
+  err = uvchan_shm_queue_open(&consumer, dup(producer->mem_fd),
+                              dup(producer->data_fd), dup(producer->space_fd),
+                              element_size);
+  if (err == UVCHAN_ERR_SUCCESS) {
+    uvchan_shm_queue_destroy(&consumer);
+  } else {
+    close(consumer.mem_fd);
+    close(consumer.data_fd);
+    close(consumer.space_fd);
+  }
+
+  return err;
+}
+
+void test_open_should_reject_bad_header(void) {
+  uvchan_shm_queue producer;
+  size_t mask;
+
+  T_OK(uvchan_shm_queue_init(&producer, 8, sizeof(int)));
+  mask = producer._ring->_mask;
+  T_OK(_test_open_dup(&producer, sizeof(int)));
+
+  T_CMPINT(_test_open_dup(&producer, 2 * sizeof(int)), ==,
+           UVCHAN_ERR_INVALID_ARGUMENT);
+
+  // not a power of two
+  producer._ring->_mask = mask + 2;
+  T_CMPINT(_test_open_dup(&producer, sizeof(int)), ==,
+           UVCHAN_ERR_INVALID_ARGUMENT);
+
+  // ring larger than mapping
+  producer._ring->_mask = 1023;
+  T_CMPINT(_test_open_dup(&producer, sizeof(int)), ==,
+           UVCHAN_ERR_INVALID_ARGUMENT);
+
+  producer._ring->_mask = mask;
+  producer._ring->_buffer_offset = producer._mapped_size;
+  T_CMPINT(_test_open_dup(&producer, sizeof(int)), ==,
+           UVCHAN_ERR_INVALID_ARGUMENT);
+
+  uvchan_shm_queue_destroy(&producer);
+}
+
+void test_arm_should_only_wait_when_needed(void) {
+  uvchan_shm_queue q;
+  int value;
+
+  value = 3;
+
+  T_OK(uvchan_shm_queue_init(&q, 1, sizeof(int)));
+  T_CMPINT(uvchan_shm_queue_arm_pop(&q), ==, UVCHAN_ERR_QUEUE_EMPTY);
+  T_CMPINT(uvchan_shm_queue_arm_push(&q), ==, UVCHAN_ERR_SUCCESS);
+
+  // armed consumer is signalled by push
+  T_OK(uvchan_shm_queue_push(&q, &value));
+  _wait_readable(q.data_fd);
+  T_CMPINT(uvchan_shm_queue_arm_pop(&q), ==, UVCHAN_ERR_SUCCESS);
+  T_CMPINT(uvchan_shm_queue_arm_push(&q), ==, UVCHAN_ERR_QUEUE_FULL);
+
+  uvchan_shm_queue_close(&q);
+  T_CMPINT(uvchan_shm_queue_arm_push(&q), ==, UVCHAN_ERR_CHANNEL_CLOSED);
+  // items are still delivered after close
+  T_CMPINT(uvchan_shm_queue_arm_pop(&q), ==, UVCHAN_ERR_SUCCESS);
+  T_OK(uvchan_shm_queue_pop(&q, &value));
+  T_CMPINT(uvchan_shm_queue_arm_pop(&q), ==, UVCHAN_ERR_CHANNEL_CLOSED);
+
+  uvchan_shm_queue_destroy(&q);
+}
+
+static void _test_cross_process_producer(int mem_fd, int data_fd,
+                                         int space_fd) {
+  uvchan_shm_queue q;
+  int i;
+
+  if (uvchan_shm_queue_open(&q, mem_fd, data_fd, space_fd, sizeof(int)) !=
+      UVCHAN_ERR_SUCCESS) {
+    _exit(1);
+  }
+
+  i = 0;
+  while (i < CROSS_PROCESS_ITEMS) {
+    if (uvchan_shm_queue_push(&q, &i) == UVCHAN_ERR_SUCCESS) {
+      i++;
+    } else if (uvchan_shm_queue_arm_push(&q) == UVCHAN_ERR_QUEUE_FULL) {
+      _wait_readable(q.space_fd);
+    }
+  }
+
+  uvchan_shm_queue_close(&q);
+  uvchan_shm_queue_destroy(&q);
+  _exit(0);
+}
+
+void test_cross_process(void) {
+  uvchan_shm_queue q;
+  uvchan_error_t err;
+  pid_t pid;
+  int status;
+  int expected;
+  int result;
+
+  T_OK(uvchan_shm_queue_init(&q, 64, sizeof(int)));
+
+  pid = fork();
+  T_TRUE(pid >= 0);
+  if (pid == 0) {
+    _test_cross_process_producer(dup(q.mem_fd), dup(q.data_fd),
+                                 dup(q.space_fd));
+  }
+
+  expected = 0;
+  for (;;) {
+    if (uvchan_shm_queue_pop(&q, &result) == UVCHAN_ERR_SUCCESS) {
+      T_CMPINT(result, ==, expected);
+      expected++;
+      continue;
+    }
+
+    err = uvchan_shm_queue_arm_pop(&q);
+    if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+      break;
+    } else if (err == UVCHAN_ERR_QUEUE_EMPTY) {
+      _wait_readable(q.data_fd);
+    }
+  }
+
+  T_CMPINT(expected, ==, CROSS_PROCESS_ITEMS);
+  T_CMPINT(waitpid(pid, &status, 0), ==, pid);
+  T_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  uvchan_shm_queue_destroy(&q);
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_push_pop_full_empty);
+  T_ADD(test_second_mapping_should_share_items);
+  T_ADD(test_open_should_reject_bad_header);
+  T_ADD(test_arm_should_only_wait_when_needed);
+  T_ADD(test_cross_process);
+
+  return T_RUN(argc, argv);
+}
@@ -0,0 +1,299 @@
+#include <testing.h>
+#include <uvchan/stage.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "./config.h"
+
+typedef struct _stage_data_t {
+  int done;
+  uvchan_error_t err;
+  int received;
+  long sum;
+  int closed;
+  int last;
+  int in_order;
+} stage_data_t;
+
+uv_loop_t* make_loop(void);
+void free_loop(uv_loop_t* loop);
+
+static int _test_square_odd(const void* input, void* output, void* data) {
+  int value;
+
+  value = *(const int*)input;
+  if (value % 2 == 0) {
+    return 0;
+  }
+
+  *(int*)output = value * value;
+  return 1;
+}
+
+static void _test_done_cb(uvchan_stage_t* stage, uvchan_error_t err) {
+  stage_data_t* data;
+
+  data = (stage_data_t*)stage->data;
+  data->done++;
+  data->err = err;
+}
+
+static void _test_read_cb(uvchan_handle_t* handle, void* buffer,
+                          uvchan_error_t err) {
+  stage_data_t* data;
+
+  data = (stage_data_t*)handle->data;
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    data->closed++;
+    return;
+  }
+
+  T_OK(err);
+  data->received++;
+  data->sum += *(int*)buffer;
+}
+
+static uvchan_t* _test_input(int items) {
+  uvchan_t* input;
+  int i;
+
+  input = uvchan_new_ex(0, sizeof(int), UVCHAN_FLAG_UNBOUNDED);
+  for (i = 0; i < items; i++) {
+    T_OK(_uvchan_try_push(input, &i));
+  }
+
+  return input;
+}
+
+void test_stage_should_map_and_filter_items(void) {
+  uv_loop_t* loop;
+  uvchan_t* input;
+  uvchan_t* output;
+  uvchan_stage_t stage;
+  uvchan_handle_t read_handle;
+  stage_data_t data;
+  int buffer;
+
+  loop = make_loop();
+  input = _test_input(1000);
+  uvchan_close(input);
+  // small output, so that stage is held back by consumer
+  output = uvchan_new(4, sizeof(int));
+  data.done = 0;
+  data.received = 0;
+  data.sum = 0;
+  data.closed = 0;
+
+  uvchan_stage_init(loop, &stage, input, output, _test_square_odd);
+  stage.data = &data;
+  stage.parallelism = 3;
+  stage.batch_size = 7;
+  T_OK(uvchan_stage_start(&stage, _test_done_cb));
+
+  uvchan_handle_init(loop, &read_handle, output);
+  read_handle.data = &data;
+  uvchan_read_start(&read_handle, &buffer, _test_read_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+  T_CMPINT(data.received, ==, 500);
+  T_TRUE(data.sum == 166666500L);
+  T_CMPINT(data.closed, ==, 1);
+
+  uv_close((uv_handle_t*)&read_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(input);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+// every few items take much longer, so that later batches finish first
+static int _test_slow_double(const void* input, void* output, void* data) {
+  int value;
+
+  value = *(const int*)input;
+  if (value % 5 == 0) {
+    return 0;
+  } else if (value % 11 == 0) {
+    usleep(2000);
+  }
+
+  *(int*)output = value * 2;
+  return 1;
+}
+
+static void _test_ordered_read_cb(uvchan_handle_t* handle, void* buffer,
+                                  uvchan_error_t err) {
+  stage_data_t* data;
+
+  data = (stage_data_t*)handle->data;
+  if (err == UVCHAN_ERR_CHANNEL_CLOSED) {
+    data->closed++;
+    return;
+  }
+
+  T_OK(err);
+  if (*(int*)buffer <= data->last) {
+    data->in_order = 0;
+  }
+  data->last = *(int*)buffer;
+  data->received++;
+}
+
+void test_ordered_stage_should_keep_input_order(void) {
+  uv_loop_t* loop;
+  uvchan_t* input;
+  uvchan_t* output;
+  uvchan_stage_t stage;
+  uvchan_handle_t read_handle;
+  stage_data_t data;
+  int buffer;
+
+  loop = make_loop();
+  input = _test_input(300);
+  uvchan_close(input);
+  output = uvchan_new(2, sizeof(int));
+  data.done = 0;
+  data.received = 0;
+  data.closed = 0;
+  data.last = -1;
+  data.in_order = 1;
+
+  uvchan_stage_init(loop, &stage, input, output, _test_slow_double);
+  stage.data = &data;
+  stage.parallelism = 4;
+  stage.batch_size = 3;
+  stage.ordered = 1;
+  T_OK(uvchan_stage_start(&stage, _test_done_cb));
+
+  uvchan_handle_init(loop, &read_handle, output);
+  read_handle.data = &data;
+  uvchan_read_start(&read_handle, &buffer, _test_ordered_read_cb);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_OK(data.err);
+  T_CMPINT(data.received, ==, 240);
+  T_TRUE(data.in_order);
+  T_CMPINT(data.last, ==, 598);
+  T_CMPINT(data.closed, ==, 1);
+
+  uv_close((uv_handle_t*)&read_handle, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+
+  uvchan_unref(input);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_stage_should_stop_once_output_is_closed(void) {
+  uv_loop_t* loop;
+  uvchan_t* input;
+  uvchan_t* output;
+  uvchan_stage_t stage;
+  stage_data_t data;
+  int value;
+
+  loop = make_loop();
+  input = _test_input(100);
+  output = uvchan_new(4, sizeof(int));
+  uvchan_close(output);
+  data.done = 0;
+
+  uvchan_stage_init(loop, &stage, input, output, _test_square_odd);
+  stage.data = &data;
+  stage.batch_size = 8;
+  T_OK(uvchan_stage_start(&stage, _test_done_cb));
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(data.done, ==, 1);
+  T_CMPINT(data.err, ==, UVCHAN_ERR_CHANNEL_CLOSED);
+
+  // stage stopped popping, what is left stays in input
+  T_OK(_uvchan_try_pop(input, &value));
+  while (_uvchan_try_pop(input, &value) == UVCHAN_ERR_SUCCESS) {
+  }
+
+  uvchan_unref(input);
+  uvchan_unref(output);
+  free_loop(loop);
+}
+
+void test_stage_should_reject_zero_parallelism(void) {
+  uv_loop_t* loop;
+  uvchan_t* chan;
+  uvchan_stage_t stage;
+
+  loop = make_loop();
+  chan = uvchan_new(4, sizeof(int));
+
+  uvchan_stage_init(loop, &stage, chan, chan, _test_square_odd);
+  stage.parallelism = 0;
+  T_CMPINT(uvchan_stage_start(&stage, _test_done_cb), ==,
+           UVCHAN_ERR_INVALID_ARGUMENT);
+  T_CMPINT(chan->reference_count, ==, 1);
+
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+void test_stage_should_reject_bytes_channels(void) {
+  uv_loop_t* loop;
+  uvchan_t* bytes;
+  uvchan_t* chan;
+  uvchan_stage_t stage;
+
+  loop = make_loop();
+  bytes = uvchan_new_bytes(64);
+  chan = uvchan_new(4, sizeof(int));
+
+  uvchan_stage_init(loop, &stage, bytes, chan, _test_square_odd);
+  T_CMPINT(uvchan_stage_start(&stage, _test_done_cb), ==,
+           UVCHAN_ERR_NOT_SUPPORTED);
+  uvchan_stage_init(loop, &stage, chan, bytes, _test_square_odd);
+  T_CMPINT(uvchan_stage_start(&stage, _test_done_cb), ==,
+           UVCHAN_ERR_NOT_SUPPORTED);
+  T_CMPINT(bytes->reference_count, ==, 1);
+  T_CMPINT(chan->reference_count, ==, 1);
+
+  uvchan_unref(bytes);
+  uvchan_unref(chan);
+  free_loop(loop);
+}
+
+uv_loop_t* make_loop(void) {
+  uv_loop_t* loop;
+
+#ifdef LIBUV_0X
+  loop = uv_default_loop();
+#elif LIBUV_1X
+  loop = (uv_loop_t*)malloc(sizeof(uv_loop_t));
+  uv_loop_init(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+
+  return loop;
+}
+
+void free_loop(uv_loop_t* loop) {
+#ifdef LIBUV_0X
+#elif LIBUV_1X
+  uv_loop_close(loop);
+  free(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_stage_should_map_and_filter_items);
+  T_ADD(test_ordered_stage_should_keep_input_order);
+  T_ADD(test_stage_should_stop_once_output_is_closed);
+  T_ADD(test_stage_should_reject_zero_parallelism);
+  T_ADD(test_stage_should_reject_bytes_channels);
+
+  return T_RUN(argc, argv);
+}
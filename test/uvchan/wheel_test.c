@@ -0,0 +1,197 @@
+#include <testing.h>
+#include <uvchan/wheel.h>
+
+#include <stdlib.h>
+#include "./config.h"
+
+#define SLOT_DEADLINES 1000
+
+typedef struct _timed_t {
+  uvchan_deadline_t deadline;
+  uint64_t started;
+  uint64_t timeout;
+  int id;
+  int* order;
+  int* fired;
+} timed_t;
+
+uv_loop_t* make_loop(void);
+void free_loop(uv_loop_t* loop);
+
+static void _test_expire_cb(uvchan_deadline_t* deadline) {
+  timed_t* timed;
+
+  timed = (timed_t*)deadline;
+
+  // never early, at most a few ticks late
+  T_TRUE(uv_now(deadline->wheel->timer.loop) - timed->started >=
+         timed->timeout);
+  T_TRUE(deadline->expired);
+  timed->order[(*timed->fired)++] = timed->id;
+}
+
+static void _test_arm(uvchan_wheel_t* wheel, timed_t* timed, int id,
+                      uint64_t timeout, int* order, int* fired) {
+  uvchan_deadline_init(&timed->deadline, _test_expire_cb);
+  timed->started = uv_now(wheel->timer.loop);
+  timed->timeout = timeout;
+  timed->id = id;
+  timed->order = order;
+  timed->fired = fired;
+  uvchan_deadline_arm(&timed->deadline, wheel, timeout);
+}
+
+void test_deadlines_should_expire_in_order(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  timed_t timed[3];
+  int order[3];
+  int fired;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  fired = 0;
+
+  _test_arm(&wheel, &timed[0], 0, 30, order, &fired);
+  _test_arm(&wheel, &timed[1], 1, 10, order, &fired);
+  _test_arm(&wheel, &timed[2], 2, 20, order, &fired);
+  T_CMPINT((int)wheel.count, ==, 3);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(fired, ==, 3);
+  T_CMPINT(order[0], ==, 1);
+  T_CMPINT(order[1], ==, 2);
+  T_CMPINT(order[2], ==, 0);
+  T_CMPINT((int)wheel.count, ==, 0);
+
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  free_loop(loop);
+}
+
+void test_disarmed_deadline_should_not_expire(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  timed_t timed[2];
+  int order[2];
+  int fired;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  fired = 0;
+
+  _test_arm(&wheel, &timed[0], 0, 10, order, &fired);
+  _test_arm(&wheel, &timed[1], 1, 5, order, &fired);
+  uvchan_deadline_disarm(&timed[1].deadline);
+  T_CMPINT((int)wheel.count, ==, 1);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(fired, ==, 1);
+  T_CMPINT(order[0], ==, 0);
+  T_FALSE(timed[1].deadline.expired);
+
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  free_loop(loop);
+}
+
+void test_deadline_beyond_one_turn_should_wait_full_timeout(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  timed_t timed[2];
+  int order[2];
+  int fired;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  fired = 0;
+
+  // both hash into same slot, the later one stays there for a turn
+  _test_arm(&wheel, &timed[0], 0, kUvChanWheelSlots + 20, order, &fired);
+  _test_arm(&wheel, &timed[1], 1, 20, order, &fired);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(fired, ==, 2);
+  T_CMPINT(order[0], ==, 1);
+  T_CMPINT(order[1], ==, 0);
+
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  free_loop(loop);
+}
+
+static void _test_disarm_next_cb(uvchan_deadline_t* deadline) {
+  timed_t* timed;
+
+  timed = (timed_t*)deadline;
+  timed->order[(*timed->fired)++] = timed->id;
+  uvchan_deadline_disarm(&(timed + 1)->deadline);
+}
+
+void test_slot_should_survive_disarm_from_callback(void) {
+  uv_loop_t* loop;
+  uvchan_wheel_t wheel;
+  timed_t timed[SLOT_DEADLINES + 1];
+  int order[SLOT_DEADLINES];
+  int fired;
+  int i;
+
+  loop = make_loop();
+  uvchan_wheel_init(loop, &wheel, 1);
+  fired = 0;
+
+  // every deadline expires in one slot, each one disarms its successor
+  for (i = 0; i < SLOT_DEADLINES; i++) {
+    _test_arm(&wheel, &timed[i], i, 5, order, &fired);
+    timed[i].deadline.expire_cb = _test_disarm_next_cb;
+  }
+  _test_arm(&wheel, &timed[SLOT_DEADLINES], SLOT_DEADLINES,
+            kUvChanWheelSlots + 5, order, &fired);
+  T_CMPINT((int)wheel.count, ==, SLOT_DEADLINES + 1);
+
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  T_CMPINT(fired, ==, SLOT_DEADLINES / 2 + 1);
+  for (i = 0; i < SLOT_DEADLINES / 2; i++) {
+    T_CMPINT(order[i], ==, 2 * i);
+  }
+  T_CMPINT(order[SLOT_DEADLINES / 2], ==, SLOT_DEADLINES);
+  T_CMPINT((int)wheel.count, ==, 0);
+
+  uvchan_wheel_close(&wheel, NULL);
+  T_OK(uv_run(loop, UV_RUN_DEFAULT));
+  free_loop(loop);
+}
+
+uv_loop_t* make_loop(void) {
+  uv_loop_t* loop;
+
+#ifdef LIBUV_0X
+  loop = uv_default_loop();
+#elif LIBUV_1X
+  loop = (uv_loop_t*)malloc(sizeof(uv_loop_t));
+  uv_loop_init(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+
+  return loop;
+}
+
+void free_loop(uv_loop_t* loop) {
+#ifdef LIBUV_0X
+#elif LIBUV_1X
+  uv_loop_close(loop);
+  free(loop);
+#else
+#error unknown operation for unknown version of libuv
+#endif
+}
+
+int main(int argc, char* argv[]) {
+  T_ADD(test_deadlines_should_expire_in_order);
+  T_ADD(test_disarmed_deadline_should_not_expire);
+  T_ADD(test_deadline_beyond_one_turn_should_wait_full_timeout);
+  T_ADD(test_slot_should_survive_disarm_from_callback);
+
+  return T_RUN(argc, argv);
+}